@@ -109,6 +109,8 @@ using namespace libconfig;
 #include "log.h"
 #include "cfg.h"
 #include "resize_crop.h"
+#include "resize_fast.h"
+#include "worker_pool.h"
 #include "resize_fine.h"
 #include "filter_motion_only.h"
 #include "selection_mask.h"
@@ -843,7 +845,7 @@ std::vector<filter *> *load_filters(configuration_t *const cfg, const Setting &
 			int thick = cfg_int(ae, "thick", "thickness of the marker", true, 2);
 
 			std::string selection_bitmap = cfg_str(ae, "selection-bitmap", "bitmaps indicating which pixels to look at. must be same size as webcam image and must be a .pbm-file. leave empty to disable.", true, "");
-			selection_mask *psm = selection_bitmap.empty() ? nullptr : new selection_mask(cfg->r, selection_bitmap);
+			selection_mask *psm = selection_bitmap.empty() ? nullptr : new selection_mask(selection_bitmap);
 			int noise_level = cfg_int(ae, "noise-factor", "at what difference levell is the pixel considered to be changed", true, 32);
 
 			double pixels_changed_perctange = i ? -1.0 : cfg_float(ae, "pixels-changed-percentage", "what %% of pixels need to be changed before the marker is drawn", false, 1.0);
@@ -855,13 +857,13 @@ std::vector<filter *> *load_filters(configuration_t *const cfg, const Setting &
 			std::string selection_bitmap = cfg_str(ae, "selection-bitmap", "bitmaps indicating which pixels to mask. must be same size as webcam image and must be a .png or .pbm-file.", false, "");
 			bool soft_mask = cfg_bool(ae, "soft-mask", "soft mask", true, false);
 
-			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(cfg->r, selection_bitmap);
+			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(selection_bitmap);
 
 			filters -> push_back(new filter_apply_mask(sm, soft_mask));
 		}
 		else if (s_type == "motion-only") {
 			std::string selection_bitmap = cfg_str(ae, "selection-bitmap", "bitmaps indicating which pixels to look at. must be same size as webcam image and must be a .pbm-file. leave empty to disable.", true, "");
-			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(cfg->r, selection_bitmap);
+			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(selection_bitmap);
 			int noise_level = cfg_int(ae, "noise-factor", "at what difference levell is the pixel considered to be changed", true, 32);
 			bool diff_only = cfg_bool(ae, "diff-only", "show difference in pixel value, not original picture", true, false);
 
@@ -1087,8 +1089,15 @@ source * load_source(configuration_t *const cfg, const Setting & o_source, const
 			int h = cfg_int(o_source, "height", "height of picture", false);
 			std::string dev = cfg_str(o_source, "device", "linux v4l2 device", false, "/dev/video0");
 			bool prefer_jpeg = cfg_bool(o_source, "prefer-jpeg", "try to get directly JPEG from camera", true, false);
-
-			s = new source_v4l(id, descr, exec_failure, dev, jpeg_quality, max_fps, w, h, cfg->r, resize_w, resize_h, loglevel, timeout, source_filters, failure, prefer_jpeg, use_controls, cfg->text_feeds, keep_aspectratio);
+			std::string pixel_format = cfg_str(o_source, "pixel-format", "format to capture in when not JPEG: RGB24, YUYV or NV12", true, "RGB24");
+			if (pixel_format != "RGB24" && pixel_format != "YUYV" && pixel_format != "NV12")
+				error_exit(false, "pixel-format \"%s\" not supported for v4l sources", pixel_format.c_str());
+			int n_buffers = cfg_int(o_source, "buffer-count", "number of capture buffers to request from the driver", true, 2);
+			if (n_buffers < 2)
+				error_exit(false, "buffer-count must be at least 2");
+			bool zero_copy = cfg_bool(o_source, "zero-copy", "hand the capture buffers to the consumers instead of copying them", true, false);
+
+			s = new source_v4l(id, descr, exec_failure, dev, jpeg_quality, max_fps, w, h, cfg->r, resize_w, resize_h, loglevel, timeout, source_filters, failure, prefer_jpeg, pixel_format, n_buffers, zero_copy, use_controls, cfg->text_feeds, keep_aspectratio);
 #else
 			error_exit(false, "'libv4l2' was not linked in");
 #endif
@@ -1267,6 +1276,9 @@ source * load_source(configuration_t *const cfg, const Setting & o_source, const
 		if (on_demand)
 			s->set_on_demand(on_demand);
 
+		bool filter_on_capture = cfg_bool(o_source, "filter-on-capture", "apply the filters (and controls) once for each captured frame instead of for each consumer", true, false);
+		s->set_filter_on_capture(filter_on_capture);
+
 #if ALSA_FOUND == 1
 		s->set_audio(a);
 #endif
@@ -1448,7 +1460,11 @@ target * load_target(const Setting & in, source *const s, meta *const m, configu
 #if HAVE_GSTREAMER == 1
 		std::string pipeline = cfg_str(in, "pipeline", "gstreamer pipeline. Note: it should start with \"appsrc name=constatus ! \"", false, "");
 
-		t = new target_gstreamer(id, descr, s, pipeline, interval, filters, cfg, sched);
+		std::string pixel_format = cfg_str(in, "pixel-format", "format of the frames pushed into the pipeline: RGB or I420", true, "RGB");
+		if (pixel_format != "RGB" && pixel_format != "I420")
+			error_exit(false, "pixel-format \"%s\" not supported for gstreamer targets", pixel_format.c_str());
+
+		t = new target_gstreamer(id, descr, s, pipeline, pixel_format == "I420" ? E_I420 : E_RGB, interval, filters, cfg, sched);
 #else
 		error_exit(false, "gstreamer support is not compiled in");
 #endif
@@ -1531,6 +1547,7 @@ std::vector<interface *> load_motion_triggers(configuration_t *const cfg, const
 			log(LL_INFO, "this trigger will listen to events caught by \"%s\"", lr_motion_trigger->name.c_str());
 
 			cfg_int(trigger, "pre-motion-record-duration", "how many frames to record that happened before the motion started", true, 0, &dp);
+			cfg_int(trigger, "pre-motion-record-bytes", "maximum size (in bytes, as JPEG) of the frames recorded before the motion started, 0 for no limit", true, 64 * 1024 * 1024, &dp);
 
 			m = new motion_trigger_other_source(id, descr, s, lr_motion_trigger, motion_targets, dp, sched);
 		}
@@ -1545,17 +1562,32 @@ std::vector<interface *> load_motion_triggers(configuration_t *const cfg, const
 
 			cfg_str(trigger, "despeckle-filter", "filter to apply before detecting motion, see example in constatus.cfg from the source distribution", true, "", &dp);
 
+			std::string detection_method = cfg_str(trigger, "detection-method", "\"pixels\" (compare each pixel), \"blocks\" (compare blocks of a downscaled luma image), \"jpeg-dc\" (compare the average of each 8x8 pixels, from the JPEG DC coefficients when available) or \"background\" (compare each pixel with a learned background)", true, "pixels", &dp);
+			if (detection_method != "pixels" && detection_method != "blocks" && detection_method != "jpeg-dc" && detection_method != "background")
+				error_exit(false, "Motion triggers: detection-method must be \"pixels\", \"blocks\", \"jpeg-dc\" or \"background\"");
+
+			cfg_int(trigger, "background-learn-shift", "background detection method: the background adapts with 1/2^n of each frame", true, 5, &dp);
+			cfg_int(trigger, "background-sigma", "background detection method: how many standard deviations a pixel must differ from the background", true, 3, &dp);
+
+			int block_downscale = cfg_int(trigger, "block-downscale", "blocks detection method: downscale the luma by this factor (4 or 8)", true, 4, &dp);
+			if (block_downscale != 4 && block_downscale != 8)
+				error_exit(false, "Motion triggers: block-downscale must be either 4 or 8");
+
+			cfg_int(trigger, "block-size", "blocks detection method: width/height of a block in pixels of the downscaled image (multiple of 8)", true, 8, &dp);
+			cfg_int(trigger, "block-noise-factor", "blocks detection method: minimum average difference of the pixels of a block for it to be counted as changed", true, 8, &dp);
+
 			cfg_int(trigger, "min-duration", "minimum number of frames to record", true, 5, &dp);
 			cfg_int(trigger, "mute-duration", "how long not to record (in frames) after motion has stopped", true, 5, &dp);
 			cfg_int(trigger, "min-n-frames", "how many frames should have motion before recording starts", true, 1, &dp);
 			cfg_int(trigger, "pre-motion-record-duration", "how many frames to record that happened before the motion started", true, 10, &dp);
+			cfg_int(trigger, "pre-motion-record-bytes", "maximum size (in bytes, as JPEG) of the frames recorded before the motion started, 0 for no limit", true, 64 * 1024 * 1024, &dp);
 			int warmup_duration = cfg_int(trigger, "warmup-duration", "how many frames to ignore so that the camera can warm-up", true, 10);
 
 			if (cfg_float(trigger, "max-fps", "maximum number of frames per second to analyze (or -1.0 for no limit)", true, -1.0, &dp) == 0)
 				error_exit(false, "Motion triggers: max-fps must be either > 0 or -1.0. Use -1.0 for no FPS limit.");
 
 			std::string selection_bitmap = cfg_str(trigger, "selection-bitmap", "bitmaps indicating which pixels to look at. must be same size as webcam image and must be a .pbm-file. leave empty to disable.", true, "");
-			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(cfg->r, selection_bitmap);
+			selection_mask *sm = selection_bitmap.empty() ? nullptr : new selection_mask(selection_bitmap);
 
 			std::vector<filter *> *filters_detection = nullptr;
 			try {
@@ -1924,7 +1956,9 @@ std::vector<interface *> load_http_servers(configuration_t *const cfg, instance
 
 		int max_cookie_age = cfg_int(server, "max-cookie-age", "maximum age of an HTTP cookie (in seconds)", true, 1800);
 
-		interface *h = new http_server(cfg, auth, ci, id, descr, { listen_adapter, listen_port, SOMAXCONN, false }, fps, jpeg_quality, time_limit, http_filters, resize_w, resize_h, motion_compatible ? s : nullptr, allow_admin, archive_access, snapshot_dir, with_subdirs, is_rest, views, handle_failure, ssl_enabled ? &sp : nullptr, stylesheet, websocket_port, websocket_url, max_cookie_age, motd, ws_privacy, notify_viewer_script);
+		int io_threads = cfg_int(server, "io-threads", "number of threads handling the connections event driven (epoll); 0 for a thread per connection", true, 0);
+
+		interface *h = new http_server(cfg, auth, ci, id, descr, { listen_adapter, listen_port, SOMAXCONN, false }, fps, jpeg_quality, time_limit, http_filters, resize_w, resize_h, motion_compatible ? s : nullptr, allow_admin, archive_access, snapshot_dir, with_subdirs, is_rest, views, handle_failure, ssl_enabled ? &sp : nullptr, stylesheet, websocket_port, websocket_url, max_cookie_age, motd, ws_privacy, notify_viewer_script, io_threads);
 
 		if (ci)
 			ci -> interfaces.push_back(h);
@@ -1940,7 +1974,7 @@ interface * load_v4l2_loopback(configuration_t *const cfg, const Setting & o_vlb
 {
 	const std::string id = cfg_str(o_vlb, "id", "some identifier: used for selecting this module", true, "");
 	const std::string descr = cfg_str(o_vlb, "descr", "description: visible in e.g. the http server", true, "");
-	const std::string pixel_format = cfg_str(o_vlb, "pixel-format", "format of the pixel-values. YUV420, RGB24", false, "YUV420");
+	const std::string pixel_format = cfg_str(o_vlb, "pixel-format", "format of the pixel-values. YUV420, NV12, RGB24, YUYV", false, "YUV420");
 
 	std::string dev = cfg_str(o_vlb, "device", "Linux v4l2 device to connect to", true, "");
 
@@ -2002,7 +2036,7 @@ bool load_configuration(configuration_t *const cfg, const bool verbose, const in
 
 	log(LL_INFO, " *** " NAME " v" VERSION " starting ***");
 
-	std::string resize_type = cfg_str(lc_cfg, "resize-type", "can be regular or crop. This selects what method will be used for resizing the video stream (if requested).", true, "");
+	std::string resize_type = cfg_str(lc_cfg, "resize-type", "can be regular, fine, fast-area, bilinear or crop. This selects what method will be used for resizing the video stream (if requested).", true, "");
 	bool resize_before_crop = cfg_bool(lc_cfg, "resize-before-crop", "resize before crop", true, false);
 	bool resize_crop_center = cfg_bool(lc_cfg, "resize-crop-center", "center after crop", true, false);
 
@@ -2015,6 +2049,10 @@ bool load_configuration(configuration_t *const cfg, const bool verbose, const in
 	}
 	else if (resize_type == "fine")
 		cfg->r = new resize_fine();
+	else if (resize_type == "fast-area")
+		cfg->r = new resize_fast(resize_fast_area);
+	else if (resize_type == "bilinear")
+		cfg->r = new resize_fast(resize_fast_bilinear);
 	else if (resize_type == "crop")
 		cfg->r = new resize_crop(resize_crop_center, resize_before_crop);
 	else {
@@ -2022,6 +2060,10 @@ bool load_configuration(configuration_t *const cfg, const bool verbose, const in
 		return false;
 	}
 
+	int worker_threads = cfg_int(root, "worker-threads", "number of threads for resizing/filtering parts of a frame in parallel (0 to disable)", true, 0);
+	int worker_stripes = cfg_int(root, "worker-stripes", "in how many stripes a frame is split for that (0: one per thread)", true, 0);
+	init_worker_pool(worker_threads, worker_stripes);
+
 	log(LL_INFO, "Configuring text feeds...");
 	try {
 		const Setting & feeds = root["text-feeds"];
@@ -2089,6 +2131,7 @@ bool load_configuration(configuration_t *const cfg, const bool verbose, const in
 
 		ci -> name = cfg_str(instance_root, "instance-name", "instance-name", true, "default instance name");
 		ci -> descr = cfg_str(instance_root, "instance-descr", "instance-descr", true, "");
+		ci -> stripes = cfg_int(instance_root, "stripes", "in how many stripes frames of this instance are filtered in parallel (0: worker-stripes)", true, 0);
 
 		ci -> interfaces.push_back(s);
 
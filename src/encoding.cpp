@@ -1,19 +1,25 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #include <algorithm>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "encoding.h"
 
 // yuy2 aka uyvy
 // based on https://stackoverflow.com/questions/4491649/how-to-convert-yuy2-to-a-bitmap-in-c
-void yuy2_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t **out)
+void yuy2_to_rgb_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
 {
 	const uint8_t *in_work = in;
-	const int n_pixels = width * height;
-	const int n_bytes_out = n_pixels * 3;
+	uint8_t *out_work = out;
 
-	uint8_t *out_work = *out = (uint8_t *)malloc(n_bytes_out);
-
-	const int n = height * width / 2;
-	for(int loop=0; loop<n; loop++) {
+	const size_t n = n_pixels / 2;
+	for(size_t loop=0; loop<n; loop++) {
 		int y0 = *in_work++;
 		int u0 = *in_work++;
 		int y1 = *in_work++;
@@ -42,38 +48,678 @@ void yuy2_to_rgb(const uint8_t *const in, const int width, const int height, uin
 #define RGB2U(R, G, B) std::clamp(( ( -38 * (R) -  74 * (G) + 112 * (B) + 128) >> 8) + 128, 0, 255)
 #define RGB2V(R, G, B) std::clamp(( ( 112 * (R) -  94 * (G) -  18 * (B) + 128) >> 8) + 128, 0, 255)
 // uyvy
+void rgb_to_yuy2_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	size_t outo = 0;
+
+	for(size_t i=0; i + 1<n_pixels; i += 2) {
+		size_t o = i * 3;
+
+		int r1 = in[o + 0];
+		int g1 = in[o + 1];
+		int b1 = in[o + 2];
+
+		int r2 = in[o + 3];
+		int g2 = in[o + 4];
+		int b2 = in[o + 5];
+
+		uint8_t Y1 = RGB2Y(r1, g1, b1);
+		uint8_t U1 = RGB2U(r1, g1, b1);
+		uint8_t V1 = RGB2V(r1, g1, b1);
+
+		uint8_t Y2 = RGB2Y(r2, g2, b2);
+		uint8_t U2 = RGB2U(r2, g2, b2);
+		uint8_t V2 = RGB2V(r2, g2, b2);
+
+		uint8_t u12 = (U1 + U2 + 1) / 2;
+		uint8_t v12 = (V1 + V2 + 1) / 2;
+
+		out[outo++] = Y1;
+		out[outo++] = u12;
+		out[outo++] = Y2;
+		out[outo++] = v12;
+	}
+}
+
+void bgr_to_rgb_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const size_t n_bytes = n_pixels * 3;
+
+	for(size_t i=0; i<n_bytes; i += 3) {
+		const uint8_t b = in[i + 0];
+
+		out[i + 0] = in[i + 2];
+		out[i + 1] = in[i + 1];
+		out[i + 2] = b;
+	}
+}
+
+// The SIMD versions below give exactly the same output as the scalar ones
+// above: the same integer formulas are evaluated in 32 bit lanes and the
+// saturating packs do what std::clamp does. They process the bulk of a
+// picture, the scalar code does the few pixels that are left.
+// x86: SSE4.1 and AVX2, selected at runtime; ARM64: NEON (always there).
+
+typedef encoding_kernel_t kernel_t;
+
+#if defined(__x86_64__) || defined(__i386__)
+// YUYV for 8 pixels (16 bytes) -> y, u, v each in 2x 4 int32 lanes
+__attribute__((target("sse4.1")))
+static size_t yuy2_to_rgb_sse41(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const __m128i shuf_y_lo = _mm_setr_epi8(0, -1, -1, -1, 2, -1, -1, -1, 4, -1, -1, -1, 6, -1, -1, -1);
+	const __m128i shuf_y_hi = _mm_setr_epi8(8, -1, -1, -1, 10, -1, -1, -1, 12, -1, -1, -1, 14, -1, -1, -1);
+	const __m128i shuf_u_lo = _mm_setr_epi8(1, -1, -1, -1, 1, -1, -1, -1, 5, -1, -1, -1, 5, -1, -1, -1);
+	const __m128i shuf_u_hi = _mm_setr_epi8(9, -1, -1, -1, 9, -1, -1, -1, 13, -1, -1, -1, 13, -1, -1, -1);
+	const __m128i shuf_v_lo = _mm_setr_epi8(3, -1, -1, -1, 3, -1, -1, -1, 7, -1, -1, -1, 7, -1, -1, -1);
+	const __m128i shuf_v_hi = _mm_setr_epi8(11, -1, -1, -1, 11, -1, -1, -1, 15, -1, -1, -1, 15, -1, -1, -1);
+
+	// r0..r7 g0..g7 -> r0 g0 . r1 g1 . ...; b0..b7 fills the holes
+	const __m128i shuf_rg_0 = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+	const __m128i shuf_b_0  = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i shuf_rg_1 = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i shuf_b_1  = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	const __m128i c16  = _mm_set1_epi32(16);
+	const __m128i c128 = _mm_set1_epi32(128);
+	const __m128i c298 = _mm_set1_epi32(298);
+	const __m128i c409 = _mm_set1_epi32(409);
+	const __m128i c100 = _mm_set1_epi32(100);
+	const __m128i c208 = _mm_set1_epi32(208);
+	const __m128i c516 = _mm_set1_epi32(516);
+
+	size_t i = 0;
+
+	for(; i + 8 <= n_pixels; i += 8) {
+		const __m128i yuyv = _mm_loadu_si128((const __m128i *)&in[i * 2]);
+
+		__m128i r[2], g[2], b[2];
+
+		for(int half=0; half<2; half++) {
+			const __m128i y = _mm_shuffle_epi8(yuyv, half ? shuf_y_hi : shuf_y_lo);
+			const __m128i u = _mm_shuffle_epi8(yuyv, half ? shuf_u_hi : shuf_u_lo);
+			const __m128i v = _mm_shuffle_epi8(yuyv, half ? shuf_v_hi : shuf_v_lo);
+
+			const __m128i c = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(y, c16), c298), c128);
+			const __m128i d = _mm_sub_epi32(u, c128);
+			const __m128i e = _mm_sub_epi32(v, c128);
+
+			r[half] = _mm_srai_epi32(_mm_add_epi32(c, _mm_mullo_epi32(e, c409)), 8);
+			g[half] = _mm_srai_epi32(_mm_sub_epi32(_mm_sub_epi32(c, _mm_mullo_epi32(d, c100)), _mm_mullo_epi32(e, c208)), 8);
+			b[half] = _mm_srai_epi32(_mm_add_epi32(c, _mm_mullo_epi32(d, c516)), 8);
+		}
+
+		// saturating packs clamp to 0...255
+		const __m128i r16 = _mm_packs_epi32(r[0], r[1]);
+		const __m128i g16 = _mm_packs_epi32(g[0], g[1]);
+		const __m128i b16 = _mm_packs_epi32(b[0], b[1]);
+
+		const __m128i rg = _mm_packus_epi16(r16, g16);
+		const __m128i bb = _mm_packus_epi16(b16, b16);
+
+		const __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(rg, shuf_rg_0), _mm_shuffle_epi8(bb, shuf_b_0));
+		const __m128i out1 = _mm_or_si128(_mm_shuffle_epi8(rg, shuf_rg_1), _mm_shuffle_epi8(bb, shuf_b_1));
+
+		_mm_storeu_si128((__m128i *)&out[i * 3], out0);
+		_mm_storel_epi64((__m128i *)&out[i * 3 + 16], out1);
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t yuy2_to_rgb_avx2(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const __m128i shuf_y = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i shuf_u = _mm_setr_epi8(1, 1, 5, 5, 9, 9, 13, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i shuf_v = _mm_setr_epi8(3, 3, 7, 7, 11, 11, 15, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	const __m128i shuf_rg_0 = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+	const __m128i shuf_b_0  = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i shuf_rg_1 = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i shuf_b_1  = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	const __m256i c16  = _mm256_set1_epi32(16);
+	const __m256i c128 = _mm256_set1_epi32(128);
+	const __m256i c298 = _mm256_set1_epi32(298);
+	const __m256i c409 = _mm256_set1_epi32(409);
+	const __m256i c100 = _mm256_set1_epi32(100);
+	const __m256i c208 = _mm256_set1_epi32(208);
+	const __m256i c516 = _mm256_set1_epi32(516);
+
+	size_t i = 0;
+
+	for(; i + 8 <= n_pixels; i += 8) {
+		const __m128i yuyv = _mm_loadu_si128((const __m128i *)&in[i * 2]);
+
+		const __m256i y = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(yuyv, shuf_y));
+		const __m256i u = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(yuyv, shuf_u));
+		const __m256i v = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(yuyv, shuf_v));
+
+		const __m256i c = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(y, c16), c298), c128);
+		const __m256i d = _mm256_sub_epi32(u, c128);
+		const __m256i e = _mm256_sub_epi32(v, c128);
+
+		const __m256i r = _mm256_srai_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(e, c409)), 8);
+		const __m256i g = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_sub_epi32(c, _mm256_mullo_epi32(d, c100)), _mm256_mullo_epi32(e, c208)), 8);
+		const __m256i b = _mm256_srai_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(d, c516)), 8);
+
+		const __m128i r16 = _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+		const __m128i g16 = _mm_packs_epi32(_mm256_castsi256_si128(g), _mm256_extracti128_si256(g, 1));
+		const __m128i b16 = _mm_packs_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+
+		const __m128i rg = _mm_packus_epi16(r16, g16);
+		const __m128i bb = _mm_packus_epi16(b16, b16);
+
+		const __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(rg, shuf_rg_0), _mm_shuffle_epi8(bb, shuf_b_0));
+		const __m128i out1 = _mm_or_si128(_mm_shuffle_epi8(rg, shuf_rg_1), _mm_shuffle_epi8(bb, shuf_b_1));
+
+		_mm_storeu_si128((__m128i *)&out[i * 3], out0);
+		_mm_storel_epi64((__m128i *)&out[i * 3 + 16], out1);
+	}
+
+	return i;
+}
+
+// 4 RGB pixels -> r, g, b in int32 lanes
+#define RGB_TO_YUY2_SHUFFLES \
+	const __m128i shuf_r = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1); \
+	const __m128i shuf_g = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1); \
+	const __m128i shuf_b = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+
+__attribute__((target("sse4.1")))
+static size_t rgb_to_yuy2_sse41(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	RGB_TO_YUY2_SHUFFLES
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c255 = _mm_set1_epi32(255);
+	const __m128i one  = _mm_set1_epi32(1);
+	const __m128i c16  = _mm_set1_epi32(16);
+	const __m128i c128 = _mm_set1_epi32(128);
+
+	size_t i = 0;
+
+	// reads 16 bytes for 4 pixels (12 bytes)
+	for(; i + 6 <= n_pixels; i += 4) {
+		const __m128i rgb = _mm_loadu_si128((const __m128i *)&in[i * 3]);
+
+		const __m128i r = _mm_shuffle_epi8(rgb, shuf_r);
+		const __m128i g = _mm_shuffle_epi8(rgb, shuf_g);
+		const __m128i b = _mm_shuffle_epi8(rgb, shuf_b);
+
+		__m128i y = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(66)), _mm_mullo_epi32(g, _mm_set1_epi32(129))), _mm_add_epi32(_mm_mullo_epi32(b, _mm_set1_epi32(25)), c128));
+		y = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_srai_epi32(y, 8), c16), zero), c255);
+
+		__m128i u = _mm_add_epi32(_mm_sub_epi32(_mm_mullo_epi32(b, _mm_set1_epi32(112)), _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(38)), _mm_mullo_epi32(g, _mm_set1_epi32(74)))), c128);
+		u = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_srai_epi32(u, 8), c128), zero), c255);
+
+		__m128i v = _mm_add_epi32(_mm_sub_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(112)), _mm_add_epi32(_mm_mullo_epi32(g, _mm_set1_epi32(94)), _mm_mullo_epi32(b, _mm_set1_epi32(18)))), c128);
+		v = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_srai_epi32(v, 8), c128), zero), c255);
+
+		// (U1 + U2 + 1) / 2 for each pair of pixels
+		const __m128i uu = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(u, u), one), 1);
+		const __m128i vv = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(v, v), one), 1);
+		const __m128i uv = _mm_unpacklo_epi32(uu, vv);
+
+		const __m128i yuyv16 = _mm_packs_epi32(_mm_unpacklo_epi32(y, uv), _mm_unpackhi_epi32(y, uv));
+
+		_mm_storel_epi64((__m128i *)&out[i * 2], _mm_packus_epi16(yuyv16, yuyv16));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t rgb_to_yuy2_avx2(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	RGB_TO_YUY2_SHUFFLES
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c255 = _mm256_set1_epi32(255);
+	const __m256i one  = _mm256_set1_epi32(1);
+	const __m256i c16  = _mm256_set1_epi32(16);
+	const __m256i c128 = _mm256_set1_epi32(128);
+
+	size_t i = 0;
+
+	// reads 28 bytes for 8 pixels (24 bytes)
+	for(; i + 10 <= n_pixels; i += 8) {
+		const __m256i rgb = _mm256_setr_m128i(_mm_loadu_si128((const __m128i *)&in[i * 3]), _mm_loadu_si128((const __m128i *)&in[i * 3 + 12]));
+
+		const __m256i shuf_r2 = _mm256_broadcastsi128_si256(shuf_r);
+		const __m256i shuf_g2 = _mm256_broadcastsi128_si256(shuf_g);
+		const __m256i shuf_b2 = _mm256_broadcastsi128_si256(shuf_b);
+
+		const __m256i r = _mm256_shuffle_epi8(rgb, shuf_r2);
+		const __m256i g = _mm256_shuffle_epi8(rgb, shuf_g2);
+		const __m256i b = _mm256_shuffle_epi8(rgb, shuf_b2);
+
+		__m256i y = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(66)), _mm256_mullo_epi32(g, _mm256_set1_epi32(129))), _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(25)), c128));
+		y = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(_mm256_srai_epi32(y, 8), c16), zero), c255);
+
+		__m256i u = _mm256_add_epi32(_mm256_sub_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(112)), _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(38)), _mm256_mullo_epi32(g, _mm256_set1_epi32(74)))), c128);
+		u = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(_mm256_srai_epi32(u, 8), c128), zero), c255);
+
+		__m256i v = _mm256_add_epi32(_mm256_sub_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(112)), _mm256_add_epi32(_mm256_mullo_epi32(g, _mm256_set1_epi32(94)), _mm256_mullo_epi32(b, _mm256_set1_epi32(18)))), c128);
+		v = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(_mm256_srai_epi32(v, 8), c128), zero), c255);
+
+		// per 128 bit lane, as in the SSE4.1 version
+		const __m256i uu = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(u, u), one), 1);
+		const __m256i vv = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(v, v), one), 1);
+		const __m256i uv = _mm256_unpacklo_epi32(uu, vv);
+
+		const __m256i yuyv16 = _mm256_packs_epi32(_mm256_unpacklo_epi32(y, uv), _mm256_unpackhi_epi32(y, uv));
+		const __m256i yuyv8  = _mm256_permute4x64_epi64(_mm256_packus_epi16(yuyv16, yuyv16), 0x08);
+
+		_mm_storeu_si128((__m128i *)&out[i * 2], _mm256_castsi256_si128(yuyv8));
+	}
+
+	return i;
+}
+
+// 5 pixels per 16 bytes; the 16th byte written is overwritten by the next round
+__attribute__((target("sse4.1")))
+static size_t bgr_to_rgb_sse41(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const __m128i shuf = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+	size_t i = 0;
+
+	for(; i + 6 <= n_pixels; i += 5)
+		_mm_storeu_si128((__m128i *)&out[i * 3], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&in[i * 3]), shuf));
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t bgr_to_rgb_avx2(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const __m256i shuf = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15, 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+	size_t i = 0;
+
+	for(; i + 11 <= n_pixels; i += 10) {
+		const __m256i bgr = _mm256_setr_m128i(_mm_loadu_si128((const __m128i *)&in[i * 3]), _mm_loadu_si128((const __m128i *)&in[i * 3 + 15]));
+		const __m256i rgb = _mm256_shuffle_epi8(bgr, shuf);
+
+		_mm_storeu_si128((__m128i *)&out[i * 3], _mm256_castsi256_si128(rgb));
+		_mm_storeu_si128((__m128i *)&out[i * 3 + 15], _mm256_extracti128_si256(rgb, 1));
+	}
+
+	return i;
+}
+
+static kernel_t select_kernel(const kernel_t sse41, const kernel_t avx2)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return avx2;
+
+	if (__builtin_cpu_supports("sse4.1"))
+		return sse41;
+
+	return nullptr;
+}
+
+static const kernel_t yuy2_to_rgb_simd = select_kernel(yuy2_to_rgb_sse41, yuy2_to_rgb_avx2);
+static const kernel_t rgb_to_yuy2_simd = select_kernel(rgb_to_yuy2_sse41, rgb_to_yuy2_avx2);
+static const kernel_t bgr_to_rgb_simd  = select_kernel(bgr_to_rgb_sse41, bgr_to_rgb_avx2);
+
+#elif defined(__aarch64__)
+static inline uint8x8_t neon_clamp(const int32x4_t lo, const int32x4_t hi)
+{
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+// 16 pixels: vld4 splits YUYV in the even pixels, u, the odd pixels and v
+static size_t yuy2_to_rgb_neon(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	size_t i = 0;
+
+	for(; i + 16 <= n_pixels; i += 16) {
+		const uint8x8x4_t yuyv = vld4_u8(&in[i * 2]);
+
+		const int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(yuyv.val[1])), vdupq_n_s16(128));
+		const int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(yuyv.val[3])), vdupq_n_s16(128));
+
+		uint8x8_t r[2], g[2], b[2];
+
+		for(int odd=0; odd<2; odd++) {
+			const int16x8_t c = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(yuyv.val[odd * 2])), vdupq_n_s16(16));
+
+			int32x4_t c_part[2], d_part[2], e_part[2];
+			c_part[0] = vaddq_s32(vmulq_n_s32(vmovl_s16(vget_low_s16(c)), 298), vdupq_n_s32(128));
+			c_part[1] = vaddq_s32(vmulq_n_s32(vmovl_s16(vget_high_s16(c)), 298), vdupq_n_s32(128));
+			d_part[0] = vmovl_s16(vget_low_s16(d));
+			d_part[1] = vmovl_s16(vget_high_s16(d));
+			e_part[0] = vmovl_s16(vget_low_s16(e));
+			e_part[1] = vmovl_s16(vget_high_s16(e));
+
+			int32x4_t rp[2], gp[2], bp[2];
+			for(int h=0; h<2; h++) {
+				rp[h] = vshrq_n_s32(vmlaq_n_s32(c_part[h], e_part[h], 409), 8);
+				gp[h] = vshrq_n_s32(vmlsq_n_s32(vmlsq_n_s32(c_part[h], d_part[h], 100), e_part[h], 208), 8);
+				bp[h] = vshrq_n_s32(vmlaq_n_s32(c_part[h], d_part[h], 516), 8);
+			}
+
+			r[odd] = neon_clamp(rp[0], rp[1]);
+			g[odd] = neon_clamp(gp[0], gp[1]);
+			b[odd] = neon_clamp(bp[0], bp[1]);
+		}
+
+		// even/odd pixels back in order
+		uint8x16x3_t rgb;
+		rgb.val[0] = vcombine_u8(vzip1_u8(r[0], r[1]), vzip2_u8(r[0], r[1]));
+		rgb.val[1] = vcombine_u8(vzip1_u8(g[0], g[1]), vzip2_u8(g[0], g[1]));
+		rgb.val[2] = vcombine_u8(vzip1_u8(b[0], b[1]), vzip2_u8(b[0], b[1]));
+
+		vst3q_u8(&out[i * 3], rgb);
+	}
+
+	return i;
+}
+
+static inline int32x4_t neon_rgb2yuv(const int32x4_t r, const int32x4_t g, const int32x4_t b, const int cr, const int cg, const int cb, const int add)
+{
+	int32x4_t v = vdupq_n_s32(128);
+	v = vmlaq_n_s32(v, r, cr);
+	v = vmlaq_n_s32(v, g, cg);
+	v = vmlaq_n_s32(v, b, cb);
+
+	return vminq_s32(vmaxq_s32(vaddq_s32(vshrq_n_s32(v, 8), vdupq_n_s32(add)), vdupq_n_s32(0)), vdupq_n_s32(255));
+}
+
+// 8 pixels: vld3 gives r, g, b; the even and odd pixels are split with vuzp
+static size_t rgb_to_yuy2_neon(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	size_t i = 0;
+
+	for(; i + 8 <= n_pixels; i += 8) {
+		const uint8x8x3_t rgb = vld3_u8(&in[i * 3]);
+
+		int32x4_t y[2], u[2], v[2];
+
+		for(int odd=0; odd<2; odd++) {
+			const uint16x8_t r16 = vmovl_u8(odd ? vuzp2_u8(rgb.val[0], rgb.val[0]) : vuzp1_u8(rgb.val[0], rgb.val[0]));
+			const uint16x8_t g16 = vmovl_u8(odd ? vuzp2_u8(rgb.val[1], rgb.val[1]) : vuzp1_u8(rgb.val[1], rgb.val[1]));
+			const uint16x8_t b16 = vmovl_u8(odd ? vuzp2_u8(rgb.val[2], rgb.val[2]) : vuzp1_u8(rgb.val[2], rgb.val[2]));
+
+			const int32x4_t r = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(r16)));
+			const int32x4_t g = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(g16)));
+			const int32x4_t b = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(b16)));
+
+			y[odd] = neon_rgb2yuv(r, g, b,  66, 129,  25,  16);
+			u[odd] = neon_rgb2yuv(r, g, b, -38, -74, 112, 128);
+			v[odd] = neon_rgb2yuv(r, g, b, 112, -94, -18, 128);
+		}
+
+		// (U1 + U2 + 1) / 2
+		const int32x4_t uu = vshrq_n_s32(vaddq_s32(vaddq_s32(u[0], u[1]), vdupq_n_s32(1)), 1);
+		const int32x4_t vv = vshrq_n_s32(vaddq_s32(vaddq_s32(v[0], v[1]), vdupq_n_s32(1)), 1);
+
+		uint8x8x4_t yuyv;
+		yuyv.val[0] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(y[0])), vmovn_u32(vreinterpretq_u32_s32(y[0]))));
+		yuyv.val[1] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(uu)), vmovn_u32(vreinterpretq_u32_s32(uu))));
+		yuyv.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(y[1])), vmovn_u32(vreinterpretq_u32_s32(y[1]))));
+		yuyv.val[3] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(vv)), vmovn_u32(vreinterpretq_u32_s32(vv))));
+
+		// only the first 4 of each are valid: 16 bytes
+		uint8_t temp[32];
+		vst4_u8(temp, yuyv);
+		memcpy(&out[i * 2], temp, 16);
+	}
+
+	return i;
+}
+
+static size_t bgr_to_rgb_neon(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	size_t i = 0;
+
+	for(; i + 16 <= n_pixels; i += 16) {
+		uint8x16x3_t px = vld3q_u8(&in[i * 3]);
+
+		const uint8x16_t temp = px.val[0];
+		px.val[0] = px.val[2];
+		px.val[2] = temp;
+
+		vst3q_u8(&out[i * 3], px);
+	}
+
+	return i;
+}
+
+static const kernel_t yuy2_to_rgb_simd = yuy2_to_rgb_neon;
+static const kernel_t rgb_to_yuy2_simd = rgb_to_yuy2_neon;
+static const kernel_t bgr_to_rgb_simd  = bgr_to_rgb_neon;
+
+#else
+static const kernel_t yuy2_to_rgb_simd = nullptr;
+static const kernel_t rgb_to_yuy2_simd = nullptr;
+static const kernel_t bgr_to_rgb_simd  = nullptr;
+#endif
+
+std::vector<encoding_kernels_t> get_encoding_kernels()
+{
+	std::vector<encoding_kernels_t> out;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse4.1"))
+		out.push_back({ "sse4.1", yuy2_to_rgb_sse41, rgb_to_yuy2_sse41, bgr_to_rgb_sse41 });
+
+	if (__builtin_cpu_supports("avx2"))
+		out.push_back({ "avx2", yuy2_to_rgb_avx2, rgb_to_yuy2_avx2, bgr_to_rgb_avx2 });
+#elif defined(__aarch64__)
+	out.push_back({ "neon", yuy2_to_rgb_neon, rgb_to_yuy2_neon, bgr_to_rgb_neon });
+#endif
+
+	return out;
+}
+
+void yuy2_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t **out)
+{
+	const size_t n_pixels = size_t(width) * height;
+
+	*out = (uint8_t *)malloc(n_pixels * 3);
+
+	const size_t done = yuy2_to_rgb_simd ? yuy2_to_rgb_simd(in, n_pixels, *out) : 0;
+
+	yuy2_to_rgb_scalar(&in[done * 2], n_pixels - done, &(*out)[done * 3]);
+}
+
 void rgb_to_yuy2(const uint8_t *const in, const int width, const int height, uint8_t **const out)
 {
-	*out = (uint8_t *)malloc(width * 2 * height);
-	int outo = 0;
+	const size_t n_pixels = size_t(width) * height;
+
+	*out = (uint8_t *)malloc(n_pixels * 2);
+
+	const size_t done = rgb_to_yuy2_simd ? rgb_to_yuy2_simd(in, n_pixels, *out) : 0;
+
+	rgb_to_yuy2_scalar(&in[done * 3], n_pixels - done, &(*out)[done * 2]);
+}
+
+void bgr_to_rgb(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	const size_t done = bgr_to_rgb_simd ? bgr_to_rgb_simd(in, n_pixels, out) : 0;
+
+	bgr_to_rgb_scalar(&in[done * 3], n_pixels - done, &out[done * 3]);
+}
+
+size_t yuv420_size(const int width, const int height)
+{
+	const size_t cw = (width + 1) / 2;
+	const size_t ch = (height + 1) / 2;
+
+	return size_t(width) * height + cw * ch * 2;
+}
+
+void i420_planes(const uint8_t *const in, const int width, const int height, const uint8_t **const y, const uint8_t **const u, const uint8_t **const v)
+{
+	const size_t cw = (width + 1) / 2;
+	const size_t ch = (height + 1) / 2;
+
+	*y = in;
+	*u = in + size_t(width) * height;
+	*v = *u + cw * ch;
+}
+
+// the chroma of two lines is averaged; width must be even
+void yuy2_to_i420(const uint8_t *const in, const int width, const int height, uint8_t *const out)
+{
+	const int cw = (width + 1) / 2;
+	const int ch = (height + 1) / 2;
+	const int in_stride = width * 2;
+
+	uint8_t *y_out = out;
+	uint8_t *u_out = out + width * height;
+	uint8_t *v_out = u_out + cw * ch;
 
 	for(int y=0; y<height; y++) {
-		for(int x=0; x<width; x += 2) {
-			int o = y * width * 3 + x * 3;
+		const uint8_t *line = &in[y * in_stride];
+
+		for(int x=0; x<width; x++)
+			*y_out++ = line[x * 2];
+	}
+
+	for(int y=0; y<ch; y++) {
+		const uint8_t *line1 = &in[y * 2 * in_stride];
+		const uint8_t *line2 = y * 2 + 1 < height ? line1 + in_stride : line1;
+
+		for(int x=0; x<cw; x++) {
+			const int o = x * 4;
+
+			*u_out++ = (line1[o + 1] + line2[o + 1] + 1) / 2;
+			*v_out++ = (line1[o + 3] + line2[o + 3] + 1) / 2;
+		}
+	}
+}
+
+void i420_to_nv12(const uint8_t *const in, const int width, const int height, uint8_t *const out)
+{
+	const size_t n_y = size_t(width) * height;
+	const size_t n_c = size_t((width + 1) / 2) * ((height + 1) / 2);
+
+	memcpy(out, in, n_y);
+
+	const uint8_t *u = in + n_y;
+	const uint8_t *v = u + n_c;
+	uint8_t *uv = out + n_y;
+
+	for(size_t i=0; i<n_c; i++) {
+		*uv++ = u[i];
+		*uv++ = v[i];
+	}
+}
+
+void nv12_to_i420(const uint8_t *const in, const int width, const int height, uint8_t *const out)
+{
+	const size_t n_y = size_t(width) * height;
+	const size_t n_c = size_t((width + 1) / 2) * ((height + 1) / 2);
+
+	memcpy(out, in, n_y);
+
+	const uint8_t *uv = in + n_y;
+	uint8_t *u = out + n_y;
+	uint8_t *v = u + n_c;
+
+	for(size_t i=0; i<n_c; i++) {
+		u[i] = *uv++;
+		v[i] = *uv++;
+	}
+}
 
-			int r1 = in[o + 0];
-			int g1 = in[o + 1];
-			int b1 = in[o + 2];
+void i420_to_limited_range(uint8_t *const data, const int width, const int height)
+{
+	static const struct range_lut_t {
+		uint8_t y[256], c[256];
+
+		range_lut_t() {
+			for(int i=0; i<256; i++) {
+				y[i] = 16 + (i * 219 + 127) / 255;
+				c[i] = 128 + ((i - 128) * 224 + (i >= 128 ? 127 : -127)) / 255;
+			}
+		}
+	} lut;
+
+	const size_t n_y = size_t(width) * height;
+	const size_t n = yuv420_size(width, height);
 
-			int r2 = in[o + 3];
-			int g2 = in[o + 4];
-			int b2 = in[o + 5];
+	for(size_t i=0; i<n_y; i++)
+		data[i] = lut.y[data[i]];
 
-			uint8_t Y1 = RGB2Y(r1, g1, b1);
-			uint8_t U1 = RGB2U(r1, g1, b1);
-			uint8_t V1 = RGB2V(r1, g1, b1);
+	for(size_t i=n_y; i<n; i++)
+		data[i] = lut.c[data[i]];
+}
+
+// 'c_step' is 1 for separate U and V planes, 2 for interleaved ones
+static void yuv420_to_rgb(const uint8_t *const y_in, const uint8_t *const u_in, const uint8_t *const v_in, const int c_step, const int c_stride, const int width, const int height, uint8_t *const out)
+{
+	uint8_t *out_work = out;
 
-			uint8_t Y2 = RGB2Y(r2, g2, b2);
-			uint8_t U2 = RGB2U(r2, g2, b2);
-			uint8_t V2 = RGB2V(r2, g2, b2);
+	for(int y=0; y<height; y++) {
+		const uint8_t *const y_line = &y_in[size_t(y) * width];
+		const uint8_t *const u_line = &u_in[size_t(y / 2) * c_stride];
+		const uint8_t *const v_line = &v_in[size_t(y / 2) * c_stride];
 
-			uint8_t u12 = (U1 + U2 + 1) / 2;
-			uint8_t v12 = (V1 + V2 + 1) / 2;
+		for(int x=0; x<width; x++) {
+			const int c298 = (y_line[x] - 16) * 298;
+			const int d = u_line[x / 2 * c_step] - 128;
+			const int e = v_line[x / 2 * c_step] - 128;
 
-			(*out)[outo++] = Y1;
-			(*out)[outo++] = u12;
-			(*out)[outo++] = Y2;
-			(*out)[outo++] = v12;
+			*out_work++ = std::clamp((c298 + 409 * e + 128) >> 8, 0, 255); // red
+			*out_work++ = std::clamp((c298 - 100 * d - 208 * e + 128) >> 8, 0, 255); // green
+			*out_work++ = std::clamp((c298 + 516 * d + 128) >> 8, 0, 255); // blue
 		}
 	}
 }
+
+void i420_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t *const out)
+{
+	const uint8_t *y = nullptr, *u = nullptr, *v = nullptr;
+	i420_planes(in, width, height, &y, &u, &v);
+
+	yuv420_to_rgb(y, u, v, 1, (width + 1) / 2, width, height, out);
+}
+
+void nv12_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t *const out)
+{
+	const uint8_t *uv = in + size_t(width) * height;
+
+	yuv420_to_rgb(in, uv, uv + 1, 2, (width + 1) / 2 * 2, width, height, out);
+}
+
+// simple enough for the compiler to vectorize
+void rgb_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	for(size_t i=0; i<n_pixels; i++) {
+		const uint8_t *const p = &in[i * 3];
+
+		out[i] = (p[0] * 77 + p[1] * 150 + p[2] * 29 + 128) >> 8;
+	}
+}
+
+// limited (16...235) to full range luma
+static const struct luma_lut_t {
+	uint8_t v[256];
+
+	luma_lut_t() {
+		for(int i=0; i<256; i++)
+			v[i] = std::clamp(((i - 16) * 255 + 109) / 219, 0, 255);
+	}
+} luma_lut;
+
+void yuy2_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	for(size_t i=0; i<n_pixels; i++)
+		out[i] = luma_lut.v[in[i * 2]];
+}
+
+void luma_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out)
+{
+	for(size_t i=0; i<n_pixels; i++)
+		out[i] = luma_lut.v[in[i]];
+}
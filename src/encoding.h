@@ -1,7 +1,54 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
-typedef enum { E_RGB, E_BGR, E_JPEG, E_YUYV } encoding_t;
+// E_I420: Y plane, U plane, V plane (chroma at half the width and height)
+// E_NV12: Y plane, interleaved U/V plane
+// E_YUYV, E_I420 and E_NV12 are BT.601 limited ("video") range: as cameras
+// deliver them and as the encoders expect them.
+// E_GRAY: only the Y (luma) plane
+typedef enum { E_RGB, E_BGR, E_JPEG, E_YUYV, E_I420, E_NV12, E_GRAY } encoding_t;
 
+// these use SIMD instructions when the cpu has them
 void yuy2_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t **out);
 void rgb_to_yuy2(const uint8_t *const in, const int width, const int height, uint8_t **const out);
+void bgr_to_rgb(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+
+// plain C++ reference versions of the above
+void yuy2_to_rgb_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+void rgb_to_yuy2_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+void bgr_to_rgb_scalar(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+
+// A SIMD kernel converts the pixels it can (whole vectors) and returns
+// how many that were; the scalar versions do the rest.
+typedef size_t (*encoding_kernel_t)(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+
+typedef struct {
+	const char *isa;
+	encoding_kernel_t yuy2_to_rgb, rgb_to_yuy2, bgr_to_rgb;
+} encoding_kernels_t;
+
+// the kernels of each instruction set the cpu supports (for testing them)
+std::vector<encoding_kernels_t> get_encoding_kernels();
+
+// size of an E_I420 or E_NV12 frame; odd dimensions are rounded up for the chroma planes
+size_t yuv420_size(const int width, const int height);
+// returns the start of the Y, U and V planes of an E_I420 frame
+void i420_planes(const uint8_t *const in, const int width, const int height, const uint8_t **const y, const uint8_t **const u, const uint8_t **const v);
+void yuy2_to_i420(const uint8_t *const in, const int width, const int height, uint8_t *const out);
+void i420_to_nv12(const uint8_t *const in, const int width, const int height, uint8_t *const out);
+void nv12_to_i420(const uint8_t *const in, const int width, const int height, uint8_t *const out);
+// full range (JFIF, e.g. from a JPEG) E_I420 to limited range, in place
+void i420_to_limited_range(uint8_t *const data, const int width, const int height);
+// same (limited range) math as yuy2_to_rgb(); 'out' is width * height * 3 bytes
+void i420_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t *const out);
+void nv12_to_rgb(const uint8_t *const in, const int width, const int height, uint8_t *const out);
+
+// luma (BT.601) for E_GRAY; E_GRAY is always full range (0...255), also
+// when it comes from (limited range) YUV
+void rgb_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+void yuy2_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
+// the Y plane of E_I420/E_NV12 to E_GRAY
+void luma_to_gray(const uint8_t *const in, const size_t n_pixels, uint8_t *const out);
@@ -6,8 +6,10 @@
 
 #include "gen.h"
 #include "filter.h"
+#include "instance.h"
 #include "log.h"
 #include "utils.h"
+#include "worker_pool.h"
 
 void apply_filters(instance *const i, interface *const specific_int, const std::vector<filter *> *const filters, const uint8_t *const prev, uint8_t *const work, const uint64_t ts, const int w, const int h)
 {
@@ -17,24 +19,44 @@ void apply_filters(instance *const i, interface *const specific_int, const std::
 	const size_t bytes = IMS(w, h, 3);
 	uint8_t *temp = nullptr;
 
+	// (per instance) number of stripes for row independent filters
+	const int n_stripes = i ? i->stripes : 0;
+
 	bool flag = false;
 	for(filter *f : *filters) {
 		if (f -> uses_in_out()) {
 			if (!temp)
 				temp = (uint8_t *)malloc(bytes);
 
-			if (flag == false)
-				f -> apply_io(i, specific_int, ts, w, h, prev, work, temp);
-			else
-				f -> apply_io(i, specific_int, ts, w, h, prev, temp, work);
+			const uint8_t *const in = flag ? temp : work;
+			uint8_t *const out = flag ? work : temp;
+
+			if (f -> is_row_independent()) {
+				run_stripes(h, n_stripes, [&](const int y_start, const int y_end) {
+						const size_t offset = size_t(y_start) * w * 3;
+
+						f -> apply_io(i, specific_int, ts, w, y_end - y_start, prev ? prev + offset : nullptr, in + offset, out + offset);
+					});
+			}
+			else {
+				f -> apply_io(i, specific_int, ts, w, h, prev, in, out);
+			}
 
 			flag = !flag;
 		}
 		else {
-			if (flag == false)
-				f -> apply(i, specific_int, ts, w, h, prev, work);
-			else
-				f -> apply(i, specific_int, ts, w, h, prev, temp);
+			uint8_t *const in_out = flag ? temp : work;
+
+			if (f -> is_row_independent()) {
+				run_stripes(h, n_stripes, [&](const int y_start, const int y_end) {
+						const size_t offset = size_t(y_start) * w * 3;
+
+						f -> apply(i, specific_int, ts, w, y_end - y_start, prev ? prev + offset : nullptr, in_out + offset);
+					});
+			}
+			else {
+				f -> apply(i, specific_int, ts, w, h, prev, in_out);
+			}
 		}
 	}
 
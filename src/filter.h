@@ -17,6 +17,9 @@ public:
 	virtual ~filter();
 
 	virtual bool uses_in_out() const { return true; }
+	// true when each output row only depends on the same input row (and
+	// no other state); these are then applied in stripes in parallel
+	virtual bool is_row_independent() const { return false; }
 	virtual void apply_io(instance *const i, interface *const specific_int, const uint64_t ts, const int w, const int h, const uint8_t *const prev, const uint8_t *const in, uint8_t *const out);
 	virtual void apply(instance *const i, interface *const specific_int, const uint64_t ts, const int w, const int h, const uint8_t *const prev, uint8_t *const in_out);
 };
@@ -2,74 +2,11 @@
 #include "config.h"
 #include <stddef.h>
 #include <cstring>
+#include <vector>
 
 #include "gen.h"
 #include "filter_despeckle.h"
-#include "utils.h"
-
-void dilation(const uint8_t *const in, uint8_t *const gray, const int w, const int h, const int kernel_size, uint8_t *const out)
-{
-	int half_kernel = kernel_size / 2;
-
-	for(int y=half_kernel; y<h-half_kernel; y++) {
-		for(int x=half_kernel; x<w-half_kernel; x++) {
-			int best = -1, r = 0, g = 0, b = 0;
-
-			for(int ky=y-half_kernel; ky<y+half_kernel; ky++) {
-				for(int kx=x-half_kernel; kx<x+half_kernel; kx++) {
-					int offset = ky * w + kx;
-
-					if (gray[offset] > best) {
-						best = gray[offset];
-
-						r = in[offset * 3 + 0];
-						g = in[offset * 3 + 1];
-						b = in[offset * 3 + 2];
-					}
-				}
-			}
-
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = r;
-			out[offset + 1] = g;
-			out[offset + 2] = b;
-
-			gray[y * w + x] = best;
-		}
-	}
-}
-
-void erode(const uint8_t *const in, uint8_t *const gray, const int w, const int h, const int kernel_size, uint8_t *const out)
-{
-	int half_kernel = kernel_size / 2;
-
-	for(int y=half_kernel; y<h-half_kernel; y++) {
-		for(int x=half_kernel; x<w-half_kernel; x++) {
-			int worst = 256, r, g, b;
-
-			for(int ky=y-half_kernel; ky<y+half_kernel; ky++) {
-				for(int kx=x-half_kernel; kx<x+half_kernel; kx++) {
-					int offset = ky * w + kx;
-
-					if (gray[offset] < worst) {
-						worst = gray[offset];
-
-						r = in[offset * 3 + 0];
-						g = in[offset * 3 + 1];
-						b = in[offset * 3 + 2];
-					}
-				}
-			}
-
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = r;
-			out[offset + 1] = g;
-			out[offset + 2] = b;
-
-			gray[y * w + x] = worst;
-		}
-	}
-}
+#include "morphology.h"
 
 filter_despeckle::filter_despeckle(const std::string & pattern) : pattern(pattern)
 {
@@ -79,81 +16,33 @@ filter_despeckle::~filter_despeckle()
 {
 }
 
-void make_gray(const uint8_t *const in, const size_t n, uint8_t *const out)
-{
-	for(size_t i=0; i<n; i++) {
-		size_t offset = i * 3;
-
-		out[i] = (in[offset + 0] + in[offset + 1] + in[offset + 2]) / 3;
-	}
-}
-
 void filter_despeckle::apply_io(instance *const i, interface *const specific_int, const uint64_t ts, const int w, const int h, const uint8_t *const prev, const uint8_t *const in, uint8_t *const out)
 {
-	size_t n = size_t(w) * size_t(h);
-	size_t n3 = n * size_t(3);
-	uint8_t *temp1 = (uint8_t *)malloc(n3);
-	uint8_t *temp2 = (uint8_t *)malloc(n3);
-
-	uint8_t *gray = (uint8_t *)malloc(n);
-
-	memcpy(temp1, in, n3);
-
-	for(auto c : pattern) {
-		make_gray(temp1, n, gray);
+	const size_t n = size_t(w) * size_t(h);
 
-		if (c == 'd')
-			dilation(temp1, gray, w, h, 5, temp2);
-		else if (c == 'e')
-			erode(temp1, gray, w, h, 5, temp2);
-		else if (c == 'D')
-			dilation(temp1, gray, w, h, 9, temp2);
-		else if (c == 'E')
-			erode(temp1, gray, w, h, 9, temp2);
+	// one filter object is used by several threads at the same time (e.g.
+	// the MJPEG hubs of an http-server): the scratch buffers are per thread
+	thread_local morphology m;
+	thread_local std::vector<uint32_t> pixels;
 
-		uint8_t *temp = temp1;
-		temp1 = temp2;
-		temp2 = temp;
-	}
-
-	memcpy(out, temp1, n3);
+	pixels.resize(n);
 
-	int half_kernel = 9 / 2;
+	uint32_t *const p = pixels.data();
 
-	for(int x=0; x<w; x++) {
-		for(int y=0; y<half_kernel; y++) {
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = 0;
-			out[offset + 1] = 0;
-			out[offset + 2] = 0;
-		}
+	// the (gray) brightness in the upper byte: the pixel with the
+	// highest/lowest brightness in a window is selected, including its
+	// color
+	for(size_t o=0, i3=0; o<n; o++, i3 += 3) {
+		const uint32_t r = in[i3 + 0], g = in[i3 + 1], b = in[i3 + 2];
 
-		for(int y=h-half_kernel; y<h; y++) {
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = 0;
-			out[offset + 1] = 0;
-			out[offset + 2] = 0;
-		}
+		p[o] = (((r + g + b) / 3) << 24) | (r << 16) | (g << 8) | b;
 	}
 
-	for(int y=0; y<h; y++) {
-		for(int x=0; x<half_kernel; x++) {
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = 0;
-			out[offset + 1] = 0;
-			out[offset + 2] = 0;
-		}
+	m.apply_pattern(p, w, h, pattern);
 
-		for(int x=w-half_kernel; x<w; x++) {
-			int offset = y * w * 3 + x * 3;
-			out[offset + 0] = 0;
-			out[offset + 1] = 0;
-			out[offset + 2] = 0;
-		}
+	for(size_t o=0, i3=0; o<n; o++, i3 += 3) {
+		out[i3 + 0] = p[o] >> 16;
+		out[i3 + 1] = p[o] >> 8;
+		out[i3 + 2] = p[o];
 	}
-
-	free(gray);
-
-	free(temp2);
-	free(temp1);
 }
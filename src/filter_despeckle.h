@@ -1,5 +1,7 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
+#include <string>
+
 #include "filter.h"
 
 class filter_despeckle : public filter
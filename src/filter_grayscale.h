@@ -14,5 +14,6 @@ public:
 	~filter_grayscale();
 
 	bool uses_in_out() const override { return true; }
+	bool is_row_independent() const override { return true; }
 	void apply_io(instance *const i, interface *const specific_int, const uint64_t ts, const int w, const int h, const uint8_t *const prev, const uint8_t *const in, uint8_t *const out) override;
 };
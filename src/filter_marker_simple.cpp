@@ -115,9 +115,6 @@ void filter_marker_simple::notify_thread_of_event(const std::string & subject)
 
 void filter_marker_simple::apply(instance *const inst, interface *const specific_int, const uint64_t ts, const int w, const int h, const uint8_t *const prev, uint8_t *const in_out)
 {
-	if (!prev)
-		return;
-
         bool motion = false;
         if (this->i) { // when we're waiting for an other object to signal us
                 motion = changed.exchange(false);
@@ -126,6 +123,24 @@ void filter_marker_simple::apply(instance *const inst, interface *const specific
                         return;
         }
 
+	// use the foreground as determined by the motion trigger when it
+	// has one (e.g. with detection-method "background")
+	std::shared_ptr<const foreground_mask_t> fg;
+
+	if (this->i) {
+		for(auto mi : find_motion_triggers(this->i)) {
+			fg = static_cast<motion_trigger *>(mi)->get_foreground_mask();
+
+			if (fg && fg->w == w && fg->h == h)
+				break;
+
+			fg = nullptr;
+		}
+	}
+
+	if (!prev && !fg)
+		return;
+
 	bool *diffs = nullptr;
 
 	const int nl3 = noise_level * 3;
@@ -134,7 +149,15 @@ void filter_marker_simple::apply(instance *const inst, interface *const specific
 
 	int cn = 0;
 
-	if (psb) {
+	if (fg) {
+		diffs = new bool[w * h];
+
+		const uint8_t *const mask = fg->mask.data();
+
+		for(int i=0; i<w*h; i++)
+			cn += diffs[i] = mask[i] && (!psb || psb[i]);
+	}
+	else if (psb) {
 		diffs = new bool[w * h]();
 
 		for(int i=0; i<w*h; i++) {
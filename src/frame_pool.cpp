@@ -0,0 +1,92 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <stdlib.h>
+
+#include "frame_pool.h"
+
+// upper limits of what is kept in the pool, the rest is free()d
+constexpr size_t max_per_class = 8;
+constexpr size_t max_bytes_kept = 64 * 1024 * 1024;
+
+frame_pool::frame_pool()
+{
+}
+
+frame_pool::~frame_pool()
+{
+	for(auto & it : buffers) {
+		for(auto p : it.second)
+			free(p);
+	}
+}
+
+// Sizes are rounded up to at most 1/8th more than requested so that
+// buffers of which the size varies a bit (e.g. JPEG) can be reused.
+// RGB buffers (IMS(w, h, 3)) of the same resolution always end up in
+// the same class.
+size_t frame_pool::get_size_class(const size_t size)
+{
+	size_t granularity = 65536;
+
+	while(granularity * 8 < size)
+		granularity *= 2;
+
+	return (size + granularity - 1) / granularity * granularity;
+}
+
+std::shared_ptr<uint8_t> frame_pool::allocate(const size_t size)
+{
+	const size_t size_class = get_size_class(size);
+
+	uint8_t *p = nullptr;
+
+	std::unique_lock<std::mutex> lck(lock);
+
+	auto it = buffers.find(size_class);
+
+	if (it != buffers.end() && it->second.empty() == false) {
+		p = it->second.back();
+		it->second.pop_back();
+
+		bytes_kept -= size_class;
+
+		lck.unlock();
+
+		hits++;
+	}
+	else {
+		lck.unlock();
+
+		p = (uint8_t *)malloc(size_class);
+
+		misses++;
+	}
+
+	auto self = shared_from_this();
+
+	return std::shared_ptr<uint8_t>(p, [self, size_class](uint8_t *p) { self->release(p, size_class); });
+}
+
+void frame_pool::release(uint8_t *const p, const size_t size_class)
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	auto & list = buffers[size_class];
+
+	if (list.size() < max_per_class && bytes_kept + size_class <= max_bytes_kept) {
+		list.push_back(p);
+
+		bytes_kept += size_class;
+	}
+	else {
+		lck.unlock();
+
+		free(p);
+	}
+}
+
+size_t frame_pool::get_bytes_kept()
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	return bytes_kept;
+}
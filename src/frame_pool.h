@@ -0,0 +1,37 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// Recycles the pixel buffers of the video_frames of a source. Sources
+// produce frames of the same size at capture rate; malloc/free of these
+// multi-megabyte buffers fragments the glibc arenas.
+// Must be created via std::make_shared: the buffers keep a reference
+// to the pool so that they can return to it after the source is gone.
+class frame_pool : public std::enable_shared_from_this<frame_pool>
+{
+private:
+	std::mutex lock;
+	std::map<size_t, std::vector<uint8_t *> > buffers; // key is the size class
+	size_t bytes_kept { 0 };
+
+	std::atomic_uint64_t hits { 0 }, misses { 0 };
+
+	void release(uint8_t *const p, const size_t size_class);
+
+public:
+	frame_pool();
+	virtual ~frame_pool();
+
+	static size_t get_size_class(const size_t size);
+
+	std::shared_ptr<uint8_t> allocate(const size_t size);
+
+	uint64_t get_hits() const { return hits; }
+	uint64_t get_misses() const { return misses; }
+	size_t get_bytes_kept();
+};
@@ -0,0 +1,90 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <climits>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "frame_slot.h"
+#include "utils.h"
+#include "video_frame.h"
+
+static_assert(sizeof(std::atomic_uint32_t) == sizeof(uint32_t), "futex word must be 32 bit");
+
+frame_slot::frame_slot()
+{
+}
+
+frame_slot::~frame_slot()
+{
+}
+
+void frame_slot::wake_up()
+{
+	seq.fetch_add(1, std::memory_order_release);
+
+	// no system call when nobody is waiting
+	if (n_waiting.load())
+		syscall(SYS_futex, reinterpret_cast<uint32_t *>(&seq), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void frame_slot::publish(video_frame *const vf)
+{
+	std::shared_ptr<video_frame> new_frame(vf);
+
+	{
+		const std::lock_guard<std::mutex> lck(cur_lock);
+
+		// the previous frame is freed outside of the lock (if this
+		// was the last reference)
+		cur.swap(new_frame);
+	}
+
+	wake_up();
+}
+
+std::shared_ptr<video_frame> frame_slot::get() const
+{
+	const std::lock_guard<std::mutex> lck(cur_lock);
+
+	return cur;
+}
+
+std::shared_ptr<video_frame> frame_slot::wait_for(const uint64_t after, const int64_t timeout)
+{
+	const uint64_t stop_at = get_us() + timeout;
+
+	for(;;) {
+		// read the sequence number before the frame: a frame published
+		// in between changes it and the futex wait returns right away
+		const uint32_t cur_seq = seq.load(std::memory_order_acquire);
+
+		auto f = get();
+
+		if (f && f->get_ts() > after)
+			return f;
+
+		const int64_t left = stop_at - get_us();
+
+		if (left <= 0)
+			return nullptr;
+
+		struct timespec ts { left / 1000000, (left % 1000000) * 1000 };
+
+		n_waiting++;
+		syscall(SYS_futex, reinterpret_cast<uint32_t *>(&seq), FUTEX_WAIT_PRIVATE, cur_seq, &ts, nullptr, 0);
+		n_waiting--;
+	}
+}
+
+bool frame_slot::wait_for_first(const int64_t timeout)
+{
+	return wait_for(0, timeout) != nullptr;
+}
+
+uint64_t frame_slot::get_ts() const
+{
+	auto f = get();
+
+	return f ? f->get_ts() : 0;
+}
@@ -0,0 +1,39 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+class video_frame;
+
+// Holds the latest frame of a source. The capture thread publishes, any
+// number of consumers take it. This is not lock-free: a small mutex of
+// its own protects the (reference counted) pointer, but it is held only
+// to copy or swap that pointer, never while a frame is duplicated,
+// filtered or freed, and not the (busy) per-source lock. Waiting for a
+// newer frame is done with a futex on a sequence number.
+class frame_slot
+{
+private:
+	mutable std::mutex cur_lock;
+	std::shared_ptr<video_frame> cur;
+	std::atomic_uint32_t seq { 0 };
+	std::atomic_int n_waiting { 0 };
+
+	void wake_up();
+
+public:
+	frame_slot();
+	virtual ~frame_slot();
+
+	void publish(video_frame *const vf);  // takes ownership
+	std::shared_ptr<video_frame> get() const;
+
+	// nullptr when there's no frame newer than 'after' within 'timeout' us
+	std::shared_ptr<video_frame> wait_for(const uint64_t after, const int64_t timeout);
+	// same as wait_for() but for a frame with a timestamp
+	bool wait_for_first(const int64_t timeout);
+
+	uint64_t get_ts() const;
+};
@@ -6,6 +6,18 @@
 #include "http_content_theora.h"
 #include "log.h"
 
+// header and body of a page in one write: with TLS the header goes in the
+// same record as (the start of) the body
+static bool write_page(h_handle_t & hh, const ogg_page & og)
+{
+	const struct iovec iov[] {
+		{ og.header, size_t(og.header_len) },
+		{ og.body, size_t(og.body_len) }
+	};
+
+	return WRITEV_SSL(hh, iov, 2) == og.header_len + og.body_len;
+}
+
 theora_t *theora_init(const int w, const int h, const int fps, const int quality, h_handle_t & hh)
 {
 	theora_t *t = new theora_t();
@@ -49,8 +61,7 @@ theora_t *theora_init(const int w, const int h, const int fps, const int quality
 
 	if (ogg_stream_pageout(&t->ss,&og)!=1)
 		log(LL_ERR, "Internal Ogg library error");
-	WRITE_SSL(hh, (const char *)og.header, og.header_len);
-	WRITE_SSL(hh, (const char *)og.body, og.body_len);
+	write_page(hh, og);
 
 	// remaining headers
 	for(;;) {
@@ -73,8 +84,7 @@ theora_t *theora_init(const int w, const int h, const int fps, const int quality
 		if (result == 0)
 			break;
 
-		WRITE_SSL(hh, (const char *)og.header, og.header_len);
-		WRITE_SSL(hh, (const char *)og.body, og.body_len);
+		write_page(hh, og);
 	}
 
 	return t;
@@ -133,12 +143,7 @@ int theora_write_frame(theora_t *const t, h_handle_t & hh, int w, int h, uint8_t
 		log(LL_ERR, "ogg_stream_packetin failed");
 
 	while(ogg_stream_pageout(&t->ss, &og)) {
-		if (WRITE_SSL(hh, (const char *)og.header, og.header_len) != og.header_len) {
-			log(LL_ERR, "[theora_write_frame] Error: Could not write to file\n");
-			return -1;
-		}
-
-		if (WRITE_SSL(hh, (const char *)og.body, og.body_len) != og.body_len) {
+		if (!write_page(hh, og)) {
 			log(LL_ERR, "[theora_write_frame] Error: Could not write to file\n");
 			return -1;
 		}
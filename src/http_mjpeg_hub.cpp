@@ -0,0 +1,225 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <chrono>
+
+#include "http_mjpeg_hub.h"
+#include "log.h"
+#include "source.h"
+#include "utils.h"
+#include "video_frame.h"
+#include "view.h"
+
+// a hub without viewers for this long stops its thread
+#define IDLE_TIMEOUT 5
+
+http_mjpeg_hub::http_mjpeg_hub(const std::string & id, source *const s, const bool is_view_proxy, const bool acc_fps, const int resize_w, const int resize_h, const std::vector<filter *> *const filters, resize *const r, configuration_t *const cfg, const bool handle_failure) : id(id), s(s), is_view_proxy(is_view_proxy), acc_fps(acc_fps), resize_w(resize_w), resize_h(resize_h), filters(filters), r(r), cfg(cfg), handle_failure(handle_failure)
+{
+	th = new std::thread(std::ref(*this));
+}
+
+http_mjpeg_hub::~http_mjpeg_hub()
+{
+	{
+		const std::lock_guard<std::mutex> lck(lock);
+
+		stop_flag = true;
+	}
+
+	cv_clients.notify_all();
+
+	th->join();
+	delete th;
+
+	for(auto c : clients)
+		delete c;
+}
+
+mjpeg_hub_client_t *http_mjpeg_hub::subscribe(const double fps, std::atomic_uint64_t *const dropped, std::function<void()> notify)
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	if (ended)
+		return nullptr;
+
+	mjpeg_hub_client_t *c = new mjpeg_hub_client_t();
+	c->interval = fps > 0 ? 1000000 / fps : 0;
+	c->next_ts  = 0;
+	c->dropped  = dropped;
+	c->notify   = notify;
+
+	clients.push_back(c);
+
+	cv_clients.notify_all();
+
+	return c;
+}
+
+void http_mjpeg_hub::unsubscribe(mjpeg_hub_client_t *const c)
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	clients.erase(std::find(clients.begin(), clients.end(), c));
+
+	delete c;
+}
+
+std::shared_ptr<const mjpeg_part_t> http_mjpeg_hub::get(mjpeg_hub_client_t *const c)
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	if (c->queue.empty())
+		return nullptr;
+
+	auto part = c->queue.front();
+	c->queue.pop_front();
+
+	return part;
+}
+
+std::shared_ptr<const mjpeg_part_t> http_mjpeg_hub::wait(mjpeg_hub_client_t *const c, const uint64_t us)
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	if (!cv_parts.wait_for(lck, std::chrono::microseconds(us), [c] { return !c->queue.empty(); }))
+		return nullptr;
+
+	auto part = c->queue.front();
+	c->queue.pop_front();
+
+	return part;
+}
+
+bool http_mjpeg_hub::has_ended()
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	return ended;
+}
+
+void http_mjpeg_hub::broadcast(const std::shared_ptr<const mjpeg_part_t> & part)
+{
+	const uint64_t now = get_us();
+
+	const std::lock_guard<std::mutex> lck(lock);
+
+	for(auto c : clients) {
+		// decimate to the frame rate of the viewer; a bit early is ok as
+		// the frames of the source jitter too
+		if (c->interval && now + c->interval / 2 < c->next_ts)
+			continue;
+
+		c->next_ts = std::max(c->next_ts + c->interval, now);
+
+		if (c->queue.size() >= MJPEG_HUB_QUEUE_LEN) {
+			c->queue.pop_front();
+
+			(*c->dropped)++;
+		}
+
+		c->queue.push_back(part);
+
+		if (c->notify)
+			c->notify();
+	}
+
+	cv_parts.notify_all();
+}
+
+void http_mjpeg_hub::operator()()
+{
+	set_thread_name("mjpeg-hub");
+
+	const bool sc = resize_h != -1 || resize_w != -1;
+	const bool nf = filters == nullptr || filters->empty();
+
+	video_frame *prev_frame = nullptr;
+	uint64_t prev_ts = 0;
+
+	std::shared_ptr<const mjpeg_part_t> prev_part;
+
+	for(;;) {
+		uint64_t interval = 0;
+
+		{
+			std::unique_lock<std::mutex> lck(lock);
+
+			if (!cv_clients.wait_for(lck, std::chrono::seconds(IDLE_TIMEOUT), [this] { return stop_flag || !clients.empty(); })) {
+				log(id, LL_DEBUG, "MJPEG hub for %s has no viewers, stopping", s->get_id().c_str());
+
+				ended = true;
+			}
+
+			if (stop_flag || ended)
+				break;
+
+			// the fastest viewer determines how long to wait for a frame
+			for(auto c : clients) {
+				if (c->interval && (interval == 0 || c->interval < interval))
+					interval = c->interval;
+			}
+		}
+
+		video_frame *pvf = interval && acc_fps ? s->get_frame_to(handle_failure, prev_ts, interval) : s->get_frame(handle_failure, prev_ts);
+
+		if (!pvf) {
+			// keep the viewers going with the previous frame (the
+			// copy shares its data)
+			if (prev_part) {
+				auto part = std::make_shared<mjpeg_part_t>(*prev_part);
+				part->captured_ts = 0;
+
+				broadcast(part);
+			}
+
+			continue;
+		}
+
+		prev_ts = pvf->get_ts();
+
+		if (sc || !nf) {
+			if (sc) {
+				video_frame *temp = pvf->do_resize(r, resize_w, resize_h);
+				delete pvf;
+				pvf = temp;
+			}
+
+			if (!nf) {
+				source *cur_s = is_view_proxy ? ((view *)s)->get_current_source() : s;
+				instance *inst = find_instance_by_interface(cfg, cur_s);
+
+				video_frame *temp = pvf->apply_filtering(inst, s, prev_frame, filters, nullptr);
+				delete pvf;
+				pvf = temp;
+			}
+
+			delete prev_frame;
+			prev_frame = pvf->duplicate({ });
+		}
+
+		auto rc = pvf->get_data_and_len(E_JPEG);
+
+		auto data = std::make_shared<std::string>(myformat(
+			"--myboundary\r\n"
+			"Content-Type: image/jpeg\r\n"
+			"Content-Length: %zu\r\n"
+			"\r\n", std::get<1>(rc)));
+		data->reserve(data->size() + std::get<1>(rc) + 2);
+		data->append(reinterpret_cast<const char *>(std::get<0>(rc)), std::get<1>(rc));
+		*data += "\r\n";
+
+		auto part = std::make_shared<mjpeg_part_t>();
+
+		part->data = data;
+
+		part->ts          = prev_ts;
+		part->captured_ts = pvf->get_stage_ts(FS_CAPTURED);
+
+		delete pvf;
+
+		prev_part = part;
+
+		broadcast(part);
+	}
+
+	delete prev_frame;
+}
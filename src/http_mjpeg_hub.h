@@ -0,0 +1,83 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cfg.h"
+
+class filter;
+class resize;
+class source;
+
+// how many parts a viewer may lag behind before the oldest is dropped
+#define MJPEG_HUB_QUEUE_LEN 3
+
+// A part of a multipart/x-mixed-replace stream: the boundary header, the
+// JPEG and the terminating cr/lf, so that it can be sent in one go. A
+// repeated frame shares the data of the part it repeats.
+typedef struct {
+	std::shared_ptr<const std::string> data;
+	uint64_t ts;           // of the frame
+	uint64_t captured_ts;  // 0 for a repeated frame
+} mjpeg_part_t;
+
+typedef struct {
+	uint64_t interval, next_ts;
+	std::deque<std::shared_ptr<const mjpeg_part_t> > queue;
+	std::atomic_uint64_t *dropped;
+	// invoked (with the hub locked) when a part was queued
+	std::function<void()> notify;
+} mjpeg_hub_client_t;
+
+// Produces the MJPEG stream of a source (at a resolution, with the filters
+// of an http-server) once for all of its viewers. Each viewer has a small
+// queue: a viewer that can't keep up loses the oldest parts instead of
+// slowing down the others.
+// The thread ends by itself when it has had no viewers for a while, see
+// has_ended().
+class http_mjpeg_hub
+{
+private:
+	const std::string id;
+	source *const s;
+	const bool is_view_proxy, acc_fps;
+	const int resize_w, resize_h;
+	const std::vector<filter *> *const filters;
+	resize *const r;
+	configuration_t *const cfg;
+	const bool handle_failure;
+
+	std::mutex lock;
+	std::condition_variable cv_clients, cv_parts;
+	std::vector<mjpeg_hub_client_t *> clients;
+	bool stop_flag { false }, ended { false };
+
+	std::thread *th { nullptr };
+
+	void broadcast(const std::shared_ptr<const mjpeg_part_t> & part);
+
+public:
+	http_mjpeg_hub(const std::string & id, source *const s, const bool is_view_proxy, const bool acc_fps, const int resize_w, const int resize_h, const std::vector<filter *> *const filters, resize *const r, configuration_t *const cfg, const bool handle_failure);
+	virtual ~http_mjpeg_hub();
+
+	// nullptr when the hub has ended; 'dropped' is incremented for each
+	// part the viewer lost
+	mjpeg_hub_client_t *subscribe(const double fps, std::atomic_uint64_t *const dropped, std::function<void()> notify);
+	void unsubscribe(mjpeg_hub_client_t *const c);
+
+	// the next part for 'c' or nullptr; get() does not wait
+	std::shared_ptr<const mjpeg_part_t> get(mjpeg_hub_client_t *const c);
+	std::shared_ptr<const mjpeg_part_t> wait(mjpeg_hub_client_t *const c, const uint64_t us);
+
+	bool has_ended();
+
+	void operator()();
+};
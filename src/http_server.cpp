@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <filesystem>
+#include <inttypes.h>
 #include <jansson.h>
 #include <math.h>
 #include <netdb.h>
@@ -45,6 +46,7 @@
 #include "target_avi.h"
 #include "webservices.h"
 #include "http_server.h"
+#include "http_server_epoll.h"
 #include "http_server_rest.h"
 #include "http_server_support.h"
 #include "icons.h"
@@ -57,6 +59,8 @@
 #include "filter.h"
 #include "controls.h"
 #include "exec.h"
+#include "frame_pool.h"
+#include "jpeg_cache.h"
 #include "http_cookies.h"
 #include "default-stylesheet.h"
 
@@ -76,6 +80,24 @@ std::string date_header(const uint64_t ts)
 	return date_str;
 }
 
+// IMF-fixdate (as produced by date_header()), -1 when it can't be parsed
+time_t parse_date_header(const std::string & value)
+{
+	struct tm tm { };
+
+	const char *end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	if (!end)
+		return -1;
+
+	return timegm(&tm);
+}
+
+// "<mtime>-<size>", like other webservers
+std::string file_etag(const time_t mtime, const off_t size)
+{
+	return myformat("\"%llx-%llx\"", (long long)mtime, (long long)size);
+}
+
 bool sort_files_last_change(const file_t &left, const file_t & right)
 {
 	return left.last_change < right.last_change;
@@ -862,6 +884,9 @@ void http_server::send_gstats(http_thread_t *const ct, const std::string & cooki
 
         json_object_set_new(json, "gcpu", json_real(cfg->st->get_cpu_usage() * 100.0));
 
+        json_object_set_new(json, "frame-bytes-copied", json_integer(video_frame::get_bytes_copied()));
+        json_object_set_new(json, "frame-bytes-shared", json_integer(video_frame::get_bytes_shared()));
+
         char *js = json_dumps(json, JSON_COMPACT);
         std::string reply = myformat("HTTP/1.0 200 OK\r\nServer: " NAME " " VERSION "\r\nContent-Type: application/json\r\n%s\r\n%s", cookie.c_str(), js);
         free(js);
@@ -891,10 +916,27 @@ void http_server::send_stats(http_thread_t *const ct, const std::map<std::string
 			auto fps = i->get_fps();
 			json_object_set_new(json, "fps", json_real(fps.has_value() ? fps.value() : -1));
 			json_object_set_new(json, "bw", json_integer(i->get_bw() / 1024));
+			json_object_set_new(json, "latency", get_latency_json(i));
 
-			if (i->get_class_type() == CT_HTTPSERVER)
+			if (i->get_class_type() == CT_HTTPSERVER) {
 				json_object_set_new(json, "cc", json_integer(((http_server *)i)->get_connection_count()));
 
+				auto [ dl_n, dl_rate, dl_last_rate ] = ((http_server *)i)->get_download_stats();
+				json_object_set_new(json, "downloads", json_integer(dl_n));
+				json_object_set_new(json, "download-rate", json_integer(dl_rate / 1024));
+				json_object_set_new(json, "download-last-rate", json_integer(dl_last_rate / 1024));
+			}
+
+			if (i->get_class_type() == CT_SOURCE) {
+				auto pool = static_cast<source *>(i)->get_frame_pool();
+				json_object_set_new(json, "pool-hits", json_integer(pool->get_hits()));
+				json_object_set_new(json, "pool-misses", json_integer(pool->get_misses()));
+
+				auto jcache = static_cast<source *>(i)->get_jpeg_cache();
+				json_object_set_new(json, "jpeg-cache-hits", json_integer(jcache->get_hits()));
+				json_object_set_new(json, "jpeg-cache-misses", json_integer(jcache->get_misses()));
+			}
+
 			char *js = json_dumps(json, JSON_COMPACT);
 			std::string reply = myformat("HTTP/1.0 200 OK\r\nServer: " NAME " " VERSION "\r\nContent-Type: application/json\r\n%s\r\n%s", cookie.c_str(), js);
 			free(js);
@@ -910,7 +952,7 @@ void http_server::send_stats(http_thread_t *const ct, const std::map<std::string
 	}
 }
 
-bool http_server::send_snapshot(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie, const bool db)
+bool http_server::send_snapshot(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie, const bool db, const std::vector<std::string> *const header_lines)
 {
 	bool force_dl = pars.find("download") != pars.end();
 
@@ -922,14 +964,14 @@ bool http_server::send_snapshot(http_thread_t *const ct, const std::map<std::str
 		if (auto it_file = pars.find("file_nr"); it_file != pars.end())
 			file = get_db()->retrieve_filename(atol(it_file->second.c_str()));
 
-		rc = send_file(ct->hh, snapshot_dir, file.c_str(), force_dl, st, cookie, true);
+		rc = send_file(ct->hh, snapshot_dir, file.c_str(), force_dl, st, cookie, true, header_lines);
 	}
 	else {
 		if (auto file_it = pars.find("file"); file_it != pars.end())
 			file = file_it -> second;
 
 		if (!file.empty() && validate_file(snapshot_dir, with_subdirs, file))
-			rc = send_file(ct->hh, snapshot_dir, file.c_str(), force_dl, st, cookie, false);
+			rc = send_file(ct->hh, snapshot_dir, file.c_str(), force_dl, st, cookie, false, header_lines);
 	}
 
 	if (!rc)
@@ -1666,6 +1708,8 @@ void http_server::send_index_html(http_thread_t *const ct, const std::string & p
 		reply += myformat("<dt>HTTP video bandwidth</dt><dd><strong id=\"gbw\">%d </strong> <strong>kB/s</strong></dd>", g_bw / 1024);
 		reply += myformat("<dt>HTTP connection count</dt><dd><strong id=\"gcc\">%d</strong></dd>", g_cc);
 		reply += myformat("<dt>Global CPU usage</dt><dd><strong id=\"gcpu\">%d</strong> <strong>%%</strong></dd>", g_cc);
+		reply += myformat("<dt>Frame data copied</dt><dd><strong>%" PRIu64 "</strong> <strong>MB</strong></dd>", video_frame::get_bytes_copied() / 1024 / 1024);
+		reply += myformat("<dt>Frame data shared (not copied)</dt><dd><strong>%" PRIu64 "</strong> <strong>MB</strong></dd>", video_frame::get_bytes_shared() / 1024 / 1024);
 		reply += "</dl><h3>This HTTP server</h3><dl>\n";
 		reply += myformat("<dt>CPU usage</dt><dd><strong id=\"cpu-%s\">%.2f%%</strong></dd>", server_id.c_str(), get_cpu_usage() * 100.0);
 		reply += myformat("<dt>Bandwidth usage</dt><dd><strong id=\"bw-%s\">%d</strong><strong>kB/s</strong></dd>", server_id.c_str(), get_bw() / 1024);
@@ -1771,27 +1815,29 @@ std::optional<std::string> http_server::get_headers(http_thread_t *const ct)
 
 void http_server::handle_http_client(http_thread_t *const ct)
 {
-	sigset_t all_sigs;
-	sigfillset(&all_sigs);
-	pthread_sigmask(SIG_BLOCK, &all_sigs, nullptr);
-
 	ct->peer_name = get_endpoint_name(ct->hh.fd);
 
-	std::string username;
-
 	auto request_headers = get_headers(ct);
 	if (!request_headers.has_value() && !motion_compatible) {
 		CLOSE_SSL(ct->hh);
 		return;
 	}
 
+	handle_request(ct, request_headers);
+
+	CLOSE_SSL(ct->hh);
+}
+
+void http_server::handle_request(http_thread_t *const ct, const std::optional<std::string> & request_headers)
+{
+	std::string username;
+
 	std::vector<std::string> *header_lines = nullptr;
 	if (!motion_compatible)
 		header_lines = split(request_headers.value(), "\r\n");
 
 	if (!motion_compatible && header_lines->empty()) {
 		delete header_lines;
-		CLOSE_SSL(ct->hh);
 		return;
 	}
 
@@ -1811,7 +1857,6 @@ void http_server::handle_http_client(http_thread_t *const ct)
 	else {
 		delete request_parts;
 		delete header_lines;
-		CLOSE_SSL(ct->hh);
 		return;
 	}
 
@@ -1902,7 +1947,10 @@ void http_server::handle_http_client(http_thread_t *const ct)
 	if (s == nullptr && motion_compatible)
 		s = motion_compatible;
 
-	if (s)
+	// an I/O thread only handles requests that don't need frames (see
+	// is_blocking_request()); a stream starts the source itself. Stopping
+	// an on-demand source joins its thread.
+	if (s && !ct->hh.conn)
 		s->start();
 
 	auto vp_it = pars.find("view-proxy"); // interface
@@ -1938,9 +1986,14 @@ void http_server::handle_http_client(http_thread_t *const ct)
 
 		register_peer(true, ct->peer_name);
 
-		send_mjpeg_stream(ct->hh, s, final_fps, quality, get_or_post, time_limit, filters, cfg->r, final_w, final_h, cfg, is_view_proxy, handle_failure, &ct->st, cookie, acc_fps);
+		// with io-threads the I/O thread sends the frames
+		if (ct->hh.conn)
+			start_mjpeg_stream(ct, s, final_fps, get_or_post, final_w, final_h, is_view_proxy, cookie, acc_fps);
+		else {
+			send_mjpeg_stream(ct, s, final_fps, get_or_post, time_limit, final_w, final_h, is_view_proxy, cookie, acc_fps);
 
-		register_peer(false, ct->peer_name);
+			register_peer(false, ct->peer_name);
+		}
 	}
 	else if (path == "stream.ogg" && s) {
 		ct->is_stream = true;
@@ -1991,9 +2044,9 @@ void http_server::handle_http_client(http_thread_t *const ct)
 	else if (path == "stats")
 		send_stats(ct, pars, cookie);
 	else if ((path == "view-snapshots/send-file" || path == "send-file") && (archive_acces || allow_admin))
-		send_snapshot(ct, pars, cookie, false);
+		send_snapshot(ct, pars, cookie, false, header_lines);
 	else if (path == "send-file-db" && (archive_acces || allow_admin))
-		send_snapshot(ct, pars, cookie, true);
+		send_snapshot(ct, pars, cookie, true, header_lines);
 	else if (path == "view-view" && this->views)
 		view_view(ct, pars, cookie);
 	else if (path == "view-menu" && this->views)
@@ -2067,26 +2120,36 @@ do404:
 		send_404(ct, path, pars, cookie);
 	}
 
-	CLOSE_SSL(ct->hh);
-
 	delete request_parts;
 	delete header_lines;
 
-	if (s)
+	if (s && !ct->hh.conn)
 		s -> stop();
 }
 
-void http_server::handle_http_client_thread(http_thread_t *const ct)
+void http_server::handle_http_client_thread(http_thread_t *const ct, const std::optional<std::string> request_headers)
 {
 	set_thread_name("http_client");
 
+	sigset_t all_sigs;
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_BLOCK, &all_sigs, nullptr);
+
 	try {
+		// handed over by an I/O thread: the request has been read
+		if (request_headers.has_value()) {
+			handle_request(ct, motion_compatible ? std::optional<std::string>() : request_headers);
+
+			CLOSE_SSL(ct->hh);
+		}
+		else {
 #if HAVE_OPENSSL == 1
-		if (ct -> hh.sh)
-			ACCEPT_SSL(ct->hh);
+			if (ct -> hh.sh)
+				ACCEPT_SSL(ct->hh);
 #endif
 
-		handle_http_client(ct);
+			handle_http_client(ct);
+		}
 	}
 	catch(const std::runtime_error & re) {
 		log(LL_ERR, "Runtime error for %s: %s", ct->peer_name.c_str(), re.what());
@@ -2113,7 +2176,7 @@ void http_server::register_trigger_notifier(instance *const inst, const bool is_
 	}
 }
 
-http_server::http_server(configuration_t *const cfg, http_auth *const auth, instance *const limit_to, const std::string & id, const std::string & descr, const listen_adapter_t & la, const double fps, const int quality, const int time_limit, const std::vector<filter *> *const f, const int resize_w, const int resize_h, source *const motion_compatible, const bool allow_admin, const bool archive_acces, const std::string & snapshot_dir, const bool with_subdirs, const bool is_rest, instance  *const views, const bool handle_failure, const ssl_pars_t *const sp, const std::string & stylesheet, const int websocket_port, const std::string & websocket_url, const int max_cookie_age, const std::string & motd_file, const bool ws_privacy, const std::string & notify_viewer_script) : cfg(cfg), la(la), auth(auth), interface(id, descr), fps(fps), quality(quality), time_limit(time_limit), filters(f), resize_w(resize_w), resize_h(resize_h), motion_compatible(motion_compatible), allow_admin(allow_admin), archive_acces(archive_acces), snapshot_dir(snapshot_dir), with_subdirs(with_subdirs), is_rest(is_rest), views(views), limit_to(limit_to), handle_failure(handle_failure), stylesheet(stylesheet), websocket_url(websocket_url), max_cookie_age(max_cookie_age), motd_file(motd_file), ws_privacy(ws_privacy), notify_viewer_script(notify_viewer_script)
+http_server::http_server(configuration_t *const cfg, http_auth *const auth, instance *const limit_to, const std::string & id, const std::string & descr, const listen_adapter_t & la, const double fps, const int quality, const int time_limit, const std::vector<filter *> *const f, const int resize_w, const int resize_h, source *const motion_compatible, const bool allow_admin, const bool archive_acces, const std::string & snapshot_dir, const bool with_subdirs, const bool is_rest, instance  *const views, const bool handle_failure, const ssl_pars_t *const sp, const std::string & stylesheet, const int websocket_port, const std::string & websocket_url, const int max_cookie_age, const std::string & motd_file, const bool ws_privacy, const std::string & notify_viewer_script, const int io_threads) : cfg(cfg), la(la), auth(auth), interface(id, descr), fps(fps), quality(quality), time_limit(time_limit), filters(f), resize_w(resize_w), resize_h(resize_h), motion_compatible(motion_compatible), allow_admin(allow_admin), archive_acces(archive_acces), snapshot_dir(snapshot_dir), with_subdirs(with_subdirs), is_rest(is_rest), views(views), limit_to(limit_to), handle_failure(handle_failure), stylesheet(stylesheet), websocket_url(websocket_url), max_cookie_age(max_cookie_age), motd_file(motd_file), ws_privacy(ws_privacy), notify_viewer_script(notify_viewer_script), io_threads(io_threads)
 {
 	ct = CT_HTTPSERVER;
 
@@ -2257,7 +2320,13 @@ void http_server::purge_threads()
 
 	for(size_t i=0; i<data.size();) {
 		if (data.at(i)->is_terminated) {
-			data.at(i)->th->join();
+			// no thread when it was handled by an I/O thread
+			if (data.at(i)->th)
+				data.at(i)->th->join();
+
+			// left by an I/O thread: it may join the thread of the source
+			if (data.at(i)->stop_source)
+				data.at(i)->stop_source->stop();
 
 			delete data.at(i);
 			data.erase(data.begin() + i);
@@ -2274,6 +2343,9 @@ void http_server::operator()()
 
 	struct pollfd fds[] { { fd, POLLIN, 0 } };
 
+	if (io_threads > 0)
+		start_io_threads();
+
 	for(;!local_stop_flag;) {
 		purge_threads();
 
@@ -2296,7 +2368,9 @@ void http_server::operator()()
 		log(id, LL_DEBUG, "HTTP connected with: %s", get_endpoint_name(cfd).c_str());
 
 		http_thread_t *ct = new http_thread_t();
-		ct->st.start();
+		// connections of I/O threads share their thread
+		if (io_threads <= 0)
+			ct->st.start();
 
 #if HAVE_OPENSSL == 1
 		if (ssl_ctx) {
@@ -2318,7 +2392,15 @@ void http_server::operator()()
 
 		st->track_cpu_usage();
 
-		ct -> th = new std::thread(&http_server::handle_http_client_thread, this, ct);
+		if (!io.empty()) {
+			add_io_connection(ct);
+
+			c->clean_cookies(max_cookie_age);
+
+			continue;
+		}
+
+		ct -> th = new std::thread(&http_server::handle_http_client_thread, this, ct, std::optional<std::string>());
 
 		if (ct -> th == nullptr) {
 			log(id, LL_ERR, "new std::thread failed (http server): %s", strerror(errno));
@@ -2339,11 +2421,24 @@ void http_server::operator()()
 		c->clean_cookies(max_cookie_age);
 	}
 
-	for(auto d : data)
-		d->th->join();
+	stop_io_threads();
+
+	for(auto d : data) {
+		if (d->th)
+			d->th->join();
+	}
+
+	for(auto d : data) {
+		if (d->stop_source)
+			d->stop_source->stop();
 
-	for(auto d : data)
 		delete d;
+	}
+
+	for(auto h : hubs)
+		delete h.second;
+
+	hubs.clear();
 
 	log(id, LL_INFO, "HTTP server thread terminating");
 }
@@ -2357,6 +2452,9 @@ double http_server::get_cpu_usage() const
 	for(auto d : data)
 		total += d->st.get_cpu_usage();
 
+	for(auto i : io)
+		total += i->st.get_cpu_usage();
+
 	return total;
 }
 
@@ -2384,6 +2482,13 @@ size_t http_server::get_connection_count() const
 	return n;
 }
 
+std::tuple<uint64_t, uint64_t, uint64_t> http_server::get_download_stats() const
+{
+	const uint64_t us = dl_us;
+
+	return { dl_count, us ? dl_bytes * 1000000 / us : 0, dl_last_rate };
+}
+
 std::vector<std::string> http_server::get_active_connections() const
 {
 	std::vector<std::string> out;
@@ -2392,7 +2497,7 @@ std::vector<std::string> http_server::get_active_connections() const
 
 	for(auto d : data) {
 		if (d->is_stream)
-			out.push_back(d->peer_name);
+			out.push_back(myformat("%s (%" PRIu64 " frames dropped)", d->peer_name.c_str(), uint64_t(d->dropped_frames)));
 	}
 
 	return out;
@@ -1,6 +1,9 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
 #include <atomic>
+#include <functional>
+#include <optional>
+#include <tuple>
 #include <vector>
 
 #include "config.h"
@@ -13,6 +16,7 @@
 #include "interface.h"
 #include "webservices.h"
 #include "utils.h"
+#include "http_mjpeg_hub.h"
 
 class http_auth;
 class filter;
@@ -20,12 +24,16 @@ class meta;
 class source;
 class view;
 
+struct http_conn_t;
+struct http_io_thread_t;
+
 typedef struct
 {
 #if HAVE_OPENSSL == 1
 	SSL *sh;
 #endif
 	int fd;
+	http_conn_t *conn;  // set when handled by an I/O thread
 } h_handle_t;
 
 class ws_server;
@@ -39,6 +47,8 @@ typedef struct {
 	stats_tracker st { "st:http-server", false };
 	std::string peer_name, base_url;
 	bool is_stream;
+	std::atomic_uint64_t dropped_frames { 0 };  // MJPEG parts a slow viewer lost
+	source *stop_source { nullptr };  // to be stopped by purge_threads()
 } http_thread_t;
 
 class http_server : public interface
@@ -62,6 +72,7 @@ private:
 	const std::string motd_file;
 	const bool ws_privacy;
 	const std::string notify_viewer_script;
+	const int io_threads;
 
 	http_cookies *c { nullptr };
 
@@ -81,18 +92,46 @@ private:
 	mutable std::mutex data_lock;
 	std::vector<http_thread_t *> data;
 
+	// io-threads > 0: connections are handled by these (epoll)
+	std::vector<http_io_thread_t *> io;
+	size_t io_next { 0 };
+
+	// MJPEG streams: source, resize width/height, view-proxy, acc-fps
+	std::mutex hubs_lock;
+	std::map<std::tuple<source *, int, int, bool, bool>, http_mjpeg_hub *> hubs;
+
+	// files sent by send_file(), for the statistics
+	std::atomic_uint64_t dl_count { 0 }, dl_bytes { 0 }, dl_us { 0 }, dl_last_rate { 0 };
+
 	std::string get_websocket_js();
 
 	void purge_threads();
-	void handle_http_client_thread(http_thread_t *const ct);
+	void handle_http_client_thread(http_thread_t *const ct, const std::optional<std::string> request_headers);
 	void handle_http_client(http_thread_t *const ct);
-
-	void send_mjpeg_stream(h_handle_t & hh, source *s, double fps, int quality, bool get, int time_limit, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie, const bool acc_fps);
+	void handle_request(http_thread_t *const ct, const std::optional<std::string> & request_headers);
+
+	void start_io_threads();
+	void stop_io_threads();
+	void add_io_connection(http_thread_t *const ct);
+	void io_thread(http_io_thread_t *const io);
+	void io_set_events(http_io_thread_t *const io, http_thread_t *const ct);
+	void io_handle(http_io_thread_t *const io, http_thread_t *const ct);
+	bool io_read_request(http_thread_t *const ct);
+	void io_dispatch(http_io_thread_t *const io, http_thread_t *const ct);
+	void io_handoff(http_io_thread_t *const io, http_thread_t *const ct, const std::string & request_headers);
+	bool io_write(http_thread_t *const ct);
+	void io_close(http_io_thread_t *const io, http_thread_t *const ct);
+	void start_mjpeg_stream(http_thread_t *const ct, source *const s, const double fps, const bool get, const int resize_w, const int resize_h, const bool is_view_proxy, const std::string & cookie, const bool acc_fps);
+	bool stream_mjpeg_frame(http_thread_t *const ct);
+
+	std::pair<http_mjpeg_hub *, mjpeg_hub_client_t *> subscribe_mjpeg(source *const s, const double fps, const int resize_w, const int resize_h, const bool is_view_proxy, const bool acc_fps, std::atomic_uint64_t *const dropped, std::function<void()> notify);
+	void send_mjpeg_stream(http_thread_t *const ct, source *s, double fps, bool get, int time_limit, const int resize_w, const int resize_h, const bool is_view_proxy, const std::string & cookie, const bool acc_fps);
 	void send_theora_stream(h_handle_t & hh, source *s, double fps, int quality, bool get, int time_limit, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie, const bool acc_fps);
 	void send_mpng_stream(h_handle_t & hh, source *s, double fps, bool get, const int time_limit, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie, const bool acc_fps);
 	void send_png_frame(h_handle_t & hh, source *s, bool get, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie);
 	void send_jpg_frame(h_handle_t & hh, source *s, bool get, int quality, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie);
-	bool send_file(h_handle_t & hh, const std::string & path, const char *const name, const bool dl, stats_tracker *const st, const std::string & cookie, const bool path_is_valid);
+	bool send_file(h_handle_t & hh, const std::string & path, const char *const name, const bool dl, stats_tracker *const st, const std::string & cookie, const bool path_is_valid, const std::vector<std::string> *const header_lines = nullptr);
+	void track_download(const std::string & name, const uint64_t bytes, const uint64_t took_us, const bool zero_copy);
 	bool get_fs_db_pars(const std::map<std::string, std::string> & pars, std::string *const name, int *const width, int *const height, int *const nw, int *const nh, int *const feed_w, int *const feed_h);
 	void send_fs_db_mjpeg(http_thread_t *const ct, const std::string & username, const std::map<std::string, std::string> & pars, const std::string & cookie, int quality);
 	std::string get_motd(const std::string & motd_file);
@@ -111,7 +150,7 @@ private:
 	void send_copypaste(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie);
 	void send_gstats(http_thread_t *const ct, const std::string & cookie);
 	void send_stats(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie);
-	bool send_snapshot(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie, const bool db);
+	bool send_snapshot(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie, const bool db, const std::vector<std::string> *const header_lines);
 	void view_view(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie);
 	void view_menu(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & cookie, const std::string & username);
 	void view_file(http_thread_t *const ct, const std::map<std::string, std::string> & pars, const std::string & page_header, const std::string & cookie);
@@ -134,7 +173,7 @@ private:
 	void publish_motion_detected(void *ws, const std::string & subject);
 
 public:
-	http_server(configuration_t *const cfg, http_auth *const auth, instance *const limit_to, const std::string & id, const std::string & descr, const listen_adapter_t & la, const double fps, const int quality, const int time_limit, const std::vector<filter *> *const f, const int resize_w, const int resize_h, source *const motion_compatible, const bool allow_admin, const bool archive_access, const std::string & snapshot_dir, const bool with_subdirs, const bool is_rest, instance *const views, const bool handle_failure, const ssl_pars_t *const sp, const std::string & stylesheet, const int websocket_port, const std::string & websocket_url, const int max_cookie_age, const std::string & motd_file, const bool ws_privacy, const std::string & notify_viewer_script);
+	http_server(configuration_t *const cfg, http_auth *const auth, instance *const limit_to, const std::string & id, const std::string & descr, const listen_adapter_t & la, const double fps, const int quality, const int time_limit, const std::vector<filter *> *const f, const int resize_w, const int resize_h, source *const motion_compatible, const bool allow_admin, const bool archive_access, const std::string & snapshot_dir, const bool with_subdirs, const bool is_rest, instance *const views, const bool handle_failure, const ssl_pars_t *const sp, const std::string & stylesheet, const int websocket_port, const std::string & websocket_url, const int max_cookie_age, const std::string & motd_file, const bool ws_privacy, const std::string & notify_viewer_script, const int io_threads);
 	virtual ~http_server();
 
 	static void mjpeg_stream_url(configuration_t *const cfg, const std::string & id, std::string *const img_url, std::string *const page_url);
@@ -143,6 +182,9 @@ public:
 	int get_bw() const override;
 	size_t get_connection_count() const;
 	std::vector<std::string> get_active_connections() const;
+	// number of downloads, their average and the last one's throughput
+	// (bytes per second)
+	std::tuple<uint64_t, uint64_t, uint64_t> get_download_stats() const;
 
 	std::pair<std::string, std::string> gen_video_url(instance *const i);
 	std::vector<std::pair<std::string, std::string> > get_motion_video_urls();
@@ -160,4 +202,7 @@ public:
 };
 
 std::string date_header(const uint64_t ts);
+time_t parse_date_header(const std::string & value);
+std::string file_etag(const time_t mtime, const off_t size);
+std::optional<std::pair<std::string, std::string> > find_header(const std::vector<std::string> & header_lines, const std::string & search_key);
 void calc_global_http_stats(const configuration_t *const cfg, int *const bw, int *const conn_count);
@@ -1,6 +1,9 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #include "config.h"
+#include <algorithm>
 #include <atomic>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string>
 #include <cstring>
@@ -19,6 +22,7 @@
 #include "error.h"
 #include "webservices.h"
 #include "http_server.h"
+#include "http_server_epoll.h"
 #include "http_utils.h"
 #include "resize.h"
 #include "db.h"
@@ -26,171 +30,171 @@
 #include "view_all.h"
 #include "http_content_theora.h"
 
-void http_server::send_mjpeg_stream(h_handle_t & hh, source *s, double fps, int quality, bool get, int time_limit, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie, const bool acc_fps)
+// send_file(): sendfile() per this many bytes (so that the bandwidth
+// statistics are updated), else read/write with a buffer of this size
+#define SENDFILE_CHUNK_SIZE (8 * 1024 * 1024)
+#define SEND_FILE_BUFFER_SIZE (256 * 1024)
+
+static std::string mjpeg_reply_headers(const uint64_t ts, const std::string & cookie)
 {
-	bool first = true;
+	return myformat(
+		"HTTP/1.0 200 OK\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Pragma: no-cache\r\n"
+		"Server: " NAME " " VERSION "\r\n"
+		"Expires: Thu, 01 Dec 1994 16:00:00 GMT\r\n"
+		"Last-Modified: %s\r\n"
+		"Date: %s\r\n"
+		"Connection: close\r\n"
+		"%s"
+		"Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n"
+		"\r\n", date_header(ts).c_str(), date_header(0).c_str(), cookie.c_str());
+}
 
-	video_frame *prev_frame = nullptr;
+// all viewers of the same stream (see the key of 'hubs') share a hub
+std::pair<http_mjpeg_hub *, mjpeg_hub_client_t *> http_server::subscribe_mjpeg(source *const s, const double fps, const int resize_w, const int resize_h, const bool is_view_proxy, const bool acc_fps, std::atomic_uint64_t *const dropped, std::function<void()> notify)
+{
+	const std::lock_guard<std::mutex> lck(hubs_lock);
 
-	bool sc = resize_h != -1 || resize_w != -1;
-	bool nf = filters == nullptr || filters -> empty();
+	for(auto it = hubs.begin(); it != hubs.end();) {
+		if (it->second->has_ended()) {
+			delete it->second;
+			it = hubs.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
 
-        timespec next { };
-        clock_gettime(CLOCK_REALTIME, &next);
-	double interval = 1. / fps;
-	int    dropped  = 0;
+	const auto key = std::make_tuple(s, resize_w, resize_h, is_view_proxy, acc_fps);
 
-	uint64_t prev = 0;
-	time_t   end  = time(nullptr) + time_limit;
-	while((time_limit <= 0 || time(nullptr) < end) && !local_stop_flag) {
-		next.tv_sec  += interval;
-                next.tv_nsec += (interval - int(interval)) * 1'000'000'000;
-                while (next.tv_nsec >= 1'000'000'000) {
-                        next.tv_nsec -= 1'000'000'000;
-                        next.tv_sec++;
-                }
-
-		timespec now { };
-		clock_gettime(CLOCK_REALTIME, &now);
-		uint64_t next_ts = next.tv_sec * 1'000'000 + next.tv_nsec / 1000;
-		uint64_t now_ts  = now.tv_sec  * 1'000'000 + now.tv_nsec  / 1000;
-
-		if (now_ts > next_ts) {
-			dropped++;
-			printf("frames dropped: %d\n", dropped);
-			continue;
-		}
+	for(;;) {
+		auto it = hubs.find(key);
 
-                if (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next, nullptr) == -1) {
-                        if (errno == EINTR)
-                                continue;  // FIXME retry the sleep, do not increase the 'next'
-//                        DOLOG(log_ss::LS_GENERIC, "clock_nanosleep failed: %s", strerror(errno));
-                        break;
-                }
+		if (it == hubs.end())
+			it = hubs.insert({ key, new http_mjpeg_hub(id, s, is_view_proxy, acc_fps, resize_w, resize_h, filters, cfg->r, cfg, handle_failure) }).first;
 
-		video_frame *pvf = fps > 0 && acc_fps ? s->get_frame_to(handle_failure, prev, 1000000 / fps) : s->get_frame(handle_failure, prev);
+		mjpeg_hub_client_t *c = it->second->subscribe(fps, dropped, notify);
 
-		if (!pvf && prev_frame)
-			pvf = prev_frame->duplicate(E_RGB);
+		if (c)
+			return { it->second, c };
 
-		if (pvf) {
-			prev = pvf->get_ts();
+		// it stopped just now (no viewers)
+		delete it->second;
+		hubs.erase(it);
+	}
+}
 
-			// send header
-			constexpr char term[] = "\r\n";
+void http_server::send_mjpeg_stream(http_thread_t *const ct, source *s, double fps, bool get, int time_limit, const int resize_w, const int resize_h, const bool is_view_proxy, const std::string & cookie, const bool acc_fps)
+{
+	auto [ hub, c ] = subscribe_mjpeg(s, fps, resize_w, resize_h, is_view_proxy, acc_fps, &ct->dropped_frames, { });
 
-			if (first) {
-				first = false;
+	bool first = true;
 
-				std::string reply_headers = myformat(
-					"HTTP/1.0 200 OK\r\n"
-					"Cache-Control: no-cache\r\n"
-					"Pragma: no-cache\r\n"
-					"Server: " NAME " " VERSION "\r\n"
-					"Expires: Thu, 01 Dec 1994 16:00:00 GMT\r\n"
-					"Last-Modified: %s\r\n"
-					"Date: %s\r\n"
-					"Connection: close\r\n"
-					"%s"
-					"Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n"
-					"\r\n", date_header(prev).c_str(), date_header(0).c_str(), cookie.c_str());
+	time_t end = time(nullptr) + time_limit;
+	while((time_limit <= 0 || time(nullptr) < end) && !local_stop_flag) {
+		auto part = hub->wait(c, 500000);
+
+		if (!part)
+			continue;
+
+		// the response headers go with the first part
+		std::string reply_headers;
 
-				if (WRITE_SSL(hh, reply_headers.c_str(), reply_headers.size()) <= 0) {
+		if (first) {
+			first = false;
+
+			reply_headers = mjpeg_reply_headers(part->ts, cookie);
+
+			if (!get) {
+				if (WRITE_SSL(ct->hh, reply_headers.c_str(), reply_headers.size()) <= 0)
 					log(LL_DEBUG, "short write on response header");
-					delete pvf;
-					break;
-				}
 
-				if (!get) {
-					delete pvf;
-					break;
-				}
-			}
-			else if (WRITE_SSL(hh, term, strlen(term)) <= 0)
-			{
-				log(LL_DEBUG, "short write on terminating cr/lf: %s", strerror(errno));
-				delete pvf;
 				break;
 			}
+		}
 
-			st->track_bw(2);
+		const struct iovec iov[] {
+			{ const_cast<char *>(reply_headers.data()), reply_headers.size() },
+			{ const_cast<char *>(part->data->data()), part->data->size() }
+		};
 
-			// decode, encode, etc frame
-			if (nf && !sc) {
-				auto rc = pvf->get_data_and_len(E_JPEG);
+		if (WRITEV_SSL(ct->hh, iov, 2) <= 0) {
+			log(LL_DEBUG, "short write on img data: %s", strerror(errno));
+			break;
+		}
 
-				char img_h[4096] = { 0 };
-				int header_len = snprintf(img_h, sizeof img_h, 
-					"--myboundary\r\n"
-					"Content-Type: image/jpeg\r\n"
-					"Content-Length: %zu\r\n"
-					"\r\n", std::get<1>(rc));
-
-				if (WRITE_SSL(hh, img_h, header_len) <= 0)
-				{
-					log(LL_DEBUG, "short write on boundary header: %s", strerror(errno));
-					delete pvf;
-					break;
-				}
+		// repeated frames are not counted in the latency statistics
+		if (part->captured_ts)
+			ct->st.track_latency(FS_WRITTEN, get_us() - part->captured_ts);
 
-				if (WRITE_SSL(hh, (const char *)std::get<0>(rc), std::get<1>(rc)) <= 0)
-				{
-					log(LL_DEBUG, "short write on img data: %s", strerror(errno));
-					delete pvf;
-					break;
-				}
+		ct->st.track_bw(part->data->size());
 
-				st->track_bw(header_len + std::get<1>(rc));
+		ct->st.track_cpu_usage();
+	}
 
-				delete pvf;
-			}
-			else {
-				if (resize_h != -1 || resize_w != -1) {
-					// printf("%dx%d => %dx%d\n", pvf->get_w(), pvf->get_h(), resize_w, resize_h);
-					video_frame *temp = pvf->do_resize(r, resize_w, resize_h);
-					delete pvf;
-					pvf = temp;
-				}
+	hub->unsubscribe(c);
+}
 
-				if (filters && !filters->empty()) {
-					source *cur_s = is_view_proxy ? ((view *)s) -> get_current_source() : s;
-					instance *inst = find_instance_by_interface(cfg, cur_s);
+// The event driven version of send_mjpeg_stream(): the hub wakes up the I/O
+// thread which then invokes stream_mjpeg_frame() when the previous part has
+// been sent.
+void http_server::start_mjpeg_stream(http_thread_t *const ct, source *const s, const double fps, const bool get, const int resize_w, const int resize_h, const bool is_view_proxy, const std::string & cookie, const bool acc_fps)
+{
+	http_conn_t *const hc = ct->hh.conn;
 
-					video_frame *temp = pvf->apply_filtering(inst, s, prev_frame, filters, nullptr);
-					delete pvf;
-					pvf = temp;
-				}
+	// released when the connection is closed
+	s->start();
 
-				delete prev_frame;
-				prev_frame = pvf;
+	hc->state  = HC_STREAM;
+	hc->s      = s;
+	hc->get    = get;
+	hc->cookie = cookie;
+	hc->end_ts = time_limit > 0 ? get_us() + time_limit * 1000000ll : 0;
 
-				auto rc = pvf->get_data_and_len(E_JPEG);
+	const int wake_fd = hc->io->wake_fd;
 
-				char img_h[4096] = { 0 };
-				int header_len = snprintf(img_h, sizeof img_h, 
-					"--myboundary\r\n"
-					"Content-Type: image/jpeg\r\n"
-					"Content-Length: %zu\r\n"
-					"\r\n", std::get<1>(rc));
+	std::tie(hc->hub, hc->hub_client) = subscribe_mjpeg(s, fps, resize_w, resize_h, is_view_proxy, acc_fps, &ct->dropped_frames, [wake_fd] {
+			uint64_t v = 1;
+			if (write(wake_fd, &v, sizeof v) != sizeof v)
+				log(LL_DEBUG, "waking up I/O thread failed");
+		});
+}
 
-				if (WRITE_SSL(hh, img_h, header_len) <= 0) {
-					log(LL_INFO, "short write on boundary header: %s", strerror(errno));
-					break;
-				}
+// false when the stream has ended
+bool http_server::stream_mjpeg_frame(http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
 
-				if (WRITE_SSL(hh, (const char *)std::get<0>(rc), std::get<1>(rc)) <= 0) {
-					log(LL_INFO, "short write on img data: %s", strerror(errno));
-					break;
-				}
+	if (hc->end_ts && get_us() >= hc->end_ts)
+		return false;
 
-				st->track_bw(header_len + std::get<1>(rc));
-			}
-		}
+	auto part = hc->hub->get(hc->hub_client);
 
-		st->track_cpu_usage();
+	if (!part)
+		return true;
+
+	if (hc->first) {
+		hc->first = false;
+
+		hc->out = mjpeg_reply_headers(part->ts, hc->cookie);
+
+		if (!hc->get) {
+			// closed when the headers have been sent
+			hc->state = HC_RESPONSE;
+
+			return true;
+		}
 	}
 
-	delete prev_frame;
+	// sent without copying; the latency is recorded by io_write() when it
+	// has been written
+	hc->out_part        = part;
+	hc->out_data        = reinterpret_cast<const uint8_t *>(part->data->data());
+	hc->out_data_len    = part->data->size();
+	hc->out_data_offset = 0;
+
+	return true;
 }
 
 void http_server::send_theora_stream(h_handle_t & hh, source *s, double fps, int quality, bool get, int time_limit, const std::vector<filter *> *const filters, resize *const r, const int resize_w, const int resize_h, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, stats_tracker *const st, const std::string & cookie, const bool acc_fps)
@@ -226,8 +230,6 @@ void http_server::send_theora_stream(h_handle_t & hh, source *s, double fps, int
 
 	bool stop = false;
 
-	transformer_t local_th = myjpeg::allocate_transformer();
-
 	uint64_t prev = 0;
 	time_t end = time(nullptr) + time_limit;
 	for(;(time_limit <= 0 || time(nullptr) < end) && !local_stop_flag && !stop;) {
@@ -259,15 +261,13 @@ void http_server::send_theora_stream(h_handle_t & hh, source *s, double fps, int
 			delete prev_frame;
 			prev_frame = pvf;
 
-			uint8_t *rgb = pvf->get_data(E_RGB);
+			const uint8_t *i420 = pvf->get_data(E_I420);
 
-			uint8_t *i420 { nullptr }, *y { nullptr }, *u { nullptr }, *v { nullptr };
-			my_jpeg.rgb_to_i420(local_th, rgb, use_w, use_h, &i420, &y, &u, &v, true);
+			const uint8_t *y { nullptr }, *u { nullptr }, *v { nullptr };
+			i420_planes(i420, use_w, use_h, &y, &u, &v);
 
-			if (theora_write_frame(t, hh, use_w, use_h, y, u, v, 0) == -1)
+			if (theora_write_frame(t, hh, use_w, use_h, (uint8_t *)y, (uint8_t *)u, (uint8_t *)v, 0) == -1)
 				stop = true;
-
-			free(i420);
 		}
 
 		st->track_cpu_usage();
@@ -275,8 +275,6 @@ void http_server::send_theora_stream(h_handle_t & hh, source *s, double fps, int
 		handle_fps(&local_stop_flag, fps, before_ts);
 	}
 
-	myjpeg::free_transformer(local_th);
-
 	delete prev_frame;
 
 	theora_uninit(t);
@@ -335,6 +333,7 @@ void http_server::send_mpng_stream(h_handle_t & hh, source *s, double fps, bool
 
 			// send
 			constexpr char term[] = "\r\n";
+			std::string lead;  // before the boundary header
 
 			if (first) {
 				first = false;
@@ -352,21 +351,19 @@ void http_server::send_mpng_stream(h_handle_t & hh, source *s, double fps, bool
 					"Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n"
 					"\r\n", date_header(prev).c_str(), date_header(0).c_str(), cookie.c_str());
 
-				if (WRITE_SSL(hh, reply_headers.c_str(), reply_headers.size()) <= 0) {
-					log(LL_DEBUG, "short write on response header");
-					free(data_out);
-					break;
-				}
-
 				if (!get) {
+					if (WRITE_SSL(hh, reply_headers.c_str(), reply_headers.size()) <= 0)
+						log(LL_DEBUG, "short write on response header");
+
 					free(data_out);
 					break;
 				}
+
+				// sent together with the first part
+				lead = reply_headers;
 			}
-			else if (WRITE_SSL(hh, term, strlen(term)) <= 0) {
-				log(LL_DEBUG, "short write on terminating cr/lf");
-				free(data_out);
-				break;
+			else {
+				lead = term;
 			}
 
 			char img_h[4096] = { 0 };
@@ -376,13 +373,13 @@ void http_server::send_mpng_stream(h_handle_t & hh, source *s, double fps, bool
 					"Content-Length: %d\r\n"
 					"\r\n", (int)data_out_len);
 
-			if (WRITE_SSL(hh, img_h, strlen(img_h)) <= 0) {
-				log(LL_DEBUG, "short write on boundary header");
-				free(data_out);
-				break;
-			}
+			const struct iovec iov[] {
+				{ const_cast<char *>(lead.data()), lead.size() },
+				{ img_h, strlen(img_h) },
+				{ data_out, data_out_len }
+			};
 
-			if (WRITE_SSL(hh, data_out, data_out_len) <= 0) {
+			if (WRITEV_SSL(hh, iov, 3) <= 0) {
 				log(LL_DEBUG, "short write on img data");
 				free(data_out);
 				break;
@@ -531,7 +528,57 @@ void http_server::send_jpg_frame(h_handle_t & hh, source *s, bool get, int quali
 	}
 }
 
-bool http_server::send_file(h_handle_t & hh, const std::string & path, const char *const name, const bool dl, stats_tracker *const st, const std::string & cookie, const bool path_is_valid)
+// "bytes=first-last", "bytes=first-" or "bytes=-suffix_length"; lists of
+// ranges are not supported (the whole file is sent then)
+// false when the whole file is to be sent, *unsatisfiable is set when
+// the range is beyond the file
+static bool parse_range(const std::string & value, const off_t size, off_t *const start, off_t *const end, bool *const unsatisfiable)
+{
+	if (value.substr(0, 6) != "bytes=" || value.find(',') != std::string::npos)
+		return false;
+
+	std::string spec = value.substr(6);
+
+	size_t dash = spec.find('-');
+	if (dash == std::string::npos)
+		return false;
+
+	std::string first = spec.substr(0, dash), last = spec.substr(dash + 1);
+
+	if (first.empty()) {
+		if (last.empty())
+			return false;
+
+		off_t n = atoll(last.c_str());
+
+		if (n <= 0) {
+			*unsatisfiable = true;
+			return false;
+		}
+
+		*start = std::max(off_t(0), size - n);
+		*end   = size;
+
+		return true;
+	}
+
+	*start = atoll(first.c_str());
+
+	// invalid: ignored
+	if (!last.empty() && atoll(last.c_str()) < *start)
+		return false;
+
+	*end   = last.empty() ? size : std::min(off_t(atoll(last.c_str())) + 1, size);
+
+	if (*start >= size) {
+		*unsatisfiable = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool http_server::send_file(h_handle_t & hh, const std::string & path, const char *const name, const bool dl, stats_tracker *const st, const std::string & cookie, const bool path_is_valid, const std::vector<std::string> *const header_lines)
 {
 	std::string complete_path = path_is_valid ? name : (path + "/" + name);
 
@@ -583,36 +630,162 @@ bool http_server::send_file(h_handle_t & hh, const std::string & path, const cha
 
 	bool rc = true;
 
+	const std::string etag = file_etag(sb.st_mtime, sb.st_size);
+	const std::string validators = "ETag: " + etag + "\r\nLast-Modified: " + date_header(sb.st_mtime * 1000ll * 1000ll) + "\r\n";
+
+	// the part of the file to send: [offset, end)
+	off_t offset = 0, end = sb.st_size;
+	bool partial = false;
+
+	if (header_lines) {
+		// a browser (cache) that has this version already
+		bool not_modified = false;
+
+		if (auto inm = find_header(*header_lines, "If-None-Match"); inm.has_value())
+			not_modified = inm.value().second == "*" || inm.value().second.find(etag) != std::string::npos;
+		else if (auto ims = find_header(*header_lines, "If-Modified-Since"); ims.has_value()) {
+			time_t since = parse_date_header(ims.value().second);
+
+			not_modified = since != -1 && sb.st_mtime <= since;
+		}
+
+		if (not_modified) {
+			fclose(fh);
+
+			std::string headers = "HTTP/1.0 304 Not Modified\r\nServer: " NAME " " VERSION "\r\nDate: " + date_header(0) + "\r\n" + validators + cookie + "\r\n";
+
+			if (WRITE_SSL(hh, headers.c_str(), headers.size()) <= 0)
+				return false;
+
+			st->track_bw(headers.size());
+
+			return true;
+		}
+
+		// e.g. a <video> element seeking; If-Range: only when it is
+		// still the same file
+		auto range = find_header(*header_lines, "Range");
+		auto if_range = find_header(*header_lines, "If-Range");
+
+		if (range.has_value() && (!if_range.has_value() || if_range.value().second == etag || if_range.value().second == date_header(sb.st_mtime * 1000ll * 1000ll))) {
+			bool unsatisfiable = false;
+
+			if (parse_range(range.value().second, sb.st_size, &offset, &end, &unsatisfiable))
+				partial = true;
+			else if (unsatisfiable) {
+				fclose(fh);
+
+				std::string headers = myformat("HTTP/1.0 416 Range Not Satisfiable\r\nServer: " NAME " " VERSION "\r\nContent-Range: bytes */%lld\r\n%s\r\n", (long long)sb.st_size, cookie.c_str());
+
+				// a reply has been sent, no 404
+				return WRITE_SSL(hh, headers.c_str(), headers.size()) > 0;
+			}
+		}
+	}
+
 	std::string name_header = dl ? myformat("Content-Disposition: attachment; filename=\"%s\"\r\n", name) : "";
-	std::string headers = "HTTP/1.0 200 OK\r\nServer: " NAME " " VERSION "\r\n" + name_header + "Content-Type: " + type + "\r\nDate: " + date_header(0) + "\r\nLast-Modified:" + date_header(sb.st_mtime * 1000ll * 1000ll) + "\r\n" + cookie + "\r\n";
+	std::string range_header = partial ? myformat("Content-Range: bytes %lld-%lld/%lld\r\n", (long long)offset, (long long)end - 1, (long long)sb.st_size) : "";
+	std::string headers = std::string(partial ? "HTTP/1.0 206 Partial Content" : "HTTP/1.0 200 OK") + "\r\nServer: " NAME " " VERSION "\r\n" + name_header + "Content-Type: " + type + "\r\nContent-Length: " + myformat("%lld", (long long)(end - offset)) + "\r\nAccept-Ranges: bytes\r\n" + range_header + "Date: " + date_header(0) + "\r\n" + validators + cookie + "\r\n";
 	if (WRITE_SSL(hh, headers.c_str(), headers.size()) <= 0)
 		rc = false;
 
 	st->track_bw(headers.size());
 
-	while(!feof(fh) && rc) {
-		char buffer[4096];
+	// with io-threads the I/O thread sends it whenever the socket is writable
+	if (hh.conn) {
+		hh.conn->state          = HC_FILE;
+		hh.conn->file_fd        = dup(fileno(fh));
+		hh.conn->file_start     = offset;
+		hh.conn->file_offset    = offset;
+		hh.conn->file_end       = end;
+		hh.conn->file_zero_copy = CAN_SENDFILE_SSL(hh);
+		hh.conn->file_name      = complete_path;
+		hh.conn->file_start_ts  = get_us();
+
+		fclose(fh);
+
+		return rc;
+	}
+
+	const uint64_t start_ts = get_us();
+	const off_t start = offset;
+
+	const int fd = fileno(fh);
+
+	// recordings can be gigabytes: let the kernel copy them to the socket
+	bool zero_copy = CAN_SENDFILE_SSL(hh);
+
+	while(zero_copy && offset < end && rc) {
+		ssize_t n = SENDFILE_SSL(hh, fd, &offset, std::min(off_t(SENDFILE_CHUNK_SIZE), end - offset));
 
-		int fread_rc = fread(buffer, 1, sizeof(buffer), fh);
-		if (fread_rc <= 0) {
+		if (n == -1 && errno == EINTR)
+			continue;
+
+		if (n <= 0) {
+			// e.g. a filesystem that doesn't support it
+			if (offset == start && (errno == EINVAL || errno == ENOSYS)) {
+				log(LL_DEBUG, "sendfile not possible for %s, using read/write", complete_path.c_str());
+				zero_copy = false;
+				break;
+			}
+
+			log(LL_INFO, "Short write: %s", strerror(errno));
 			rc = false;
 			break;
 		}
 
-		if (WRITE_SSL(hh, buffer, fread_rc) <= 0) {
-			log(LL_INFO, "Short write");
-			rc = false;
-			break;
+		st->track_bw(n);
+	}
+
+	if (!zero_copy) {
+		uint8_t *buffer = reinterpret_cast<uint8_t *>(malloc(SEND_FILE_BUFFER_SIZE));
+
+		while(offset < end && rc) {
+			ssize_t n = pread(fd, buffer, std::min(off_t(SEND_FILE_BUFFER_SIZE), end - offset), offset);
+
+			if (n == -1 && errno == EINTR)
+				continue;
+
+			if (n <= 0) {
+				log(LL_WARNING, "Cannot read %s: %s", complete_path.c_str(), n == 0 ? "unexpected end" : strerror(errno));
+				rc = false;
+				break;
+			}
+
+			if (WRITE_SSL(hh, reinterpret_cast<const char *>(buffer), n) <= 0) {
+				log(LL_INFO, "Short write");
+				rc = false;
+				break;
+			}
+
+			offset += n;
+
+			st->track_bw(n);
 		}
 
-		st->track_bw(rc);
+		free(buffer);
 	}
 
 	fclose(fh);
 
+	track_download(complete_path, offset - start, get_us() - start_ts, zero_copy);
+
 	return rc;
 }
 
+void http_server::track_download(const std::string & name, const uint64_t bytes, const uint64_t took_us, const bool zero_copy)
+{
+	const uint64_t rate = took_us ? bytes * 1000000 / took_us : 0;
+
+	log(id, LL_INFO, "Sent %" PRIu64 " bytes of %s in %.3fs: %.1f kB/s%s", bytes, name.c_str(), took_us / 1000000., rate / 1024., zero_copy ? " (sendfile)" : "");
+
+	dl_count++;
+	dl_bytes += bytes;
+	dl_us    += took_us;
+
+	dl_last_rate = rate;
+}
+
 bool http_server::get_fs_db_pars(const std::map<std::string, std::string> & pars, std::string *const name, int *const width, int *const height, int *const nw, int *const nh, int *const feed_w, int *const feed_h)
 {
 	auto db_it = pars.find("dashboard");
@@ -702,6 +875,7 @@ void http_server::send_fs_db_mjpeg(http_thread_t *const ct, const std::string &
 		if (pvf) {
 			// send header
 			constexpr char term[] = "\r\n";
+			std::string lead;  // before the boundary header
 
 			if (first) {
 				first = false;
@@ -719,21 +893,13 @@ void http_server::send_fs_db_mjpeg(http_thread_t *const ct, const std::string &
 					"Content-Type: multipart/x-mixed-replace; boundary=--myboundary\r\n"
 					"\r\n", date_header(prev).c_str(), date_header(0).c_str(), cookie.c_str());
 
-				if (WRITE_SSL(ct->hh, reply_headers.c_str(), reply_headers.size()) <= 0) {
-					log(LL_DEBUG, "short write on response header");
-					delete pvf;
-					break;
-				}
+				// sent together with the first part
+				lead = reply_headers;
 			}
-			else if (WRITE_SSL(ct->hh, term, strlen(term)) <= 0)
-			{
-				log(LL_DEBUG, "short write on terminating cr/lf: %s", strerror(errno));
-				delete pvf;
-				break;
+			else {
+				lead = term;
 			}
 
-			ct->st.track_bw(2);
-
 			auto img = pvf->get_data_and_len(E_JPEG);
 
 			char img_h[4096] = { 0 };
@@ -743,21 +909,20 @@ void http_server::send_fs_db_mjpeg(http_thread_t *const ct, const std::string &
 				"Content-Length: %zu\r\n"
 				"\r\n", std::get<1>(img));
 
-			if (WRITE_SSL(ct->hh, img_h, len) <= 0)
-			{
-				log(LL_DEBUG, "short write on boundary header: %s", strerror(errno));
-				delete pvf;
-				break;
-			}
+			const struct iovec iov[] {
+				{ const_cast<char *>(lead.data()), lead.size() },
+				{ img_h, size_t(len) },
+				{ std::get<0>(img), std::get<1>(img) }
+			};
 
-			if (WRITE_SSL(ct->hh, (const char *)std::get<0>(img), std::get<1>(img)) <= 0)
+			if (WRITEV_SSL(ct->hh, iov, 3) <= 0)
 			{
 				log(LL_DEBUG, "short write on img data: %s", strerror(errno));
 				delete pvf;
 				break;
 			}
 
-			ct->st.track_bw(len + std::get<1>(img));
+			ct->st.track_bw(lead.size() + len + std::get<1>(img));
 
 			delete pvf;
 		}
@@ -0,0 +1,725 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include "config.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string>
+#include <cstring>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#if HAVE_OPENSSL == 1
+#include <openssl/ssl.h>
+#endif
+
+#include "error.h"
+#include "http_server.h"
+#include "http_server_epoll.h"
+#include "http_utils.h"
+#include "log.h"
+#include "source.h"
+#include "utils.h"
+
+// Event driven connection handling: a few I/O threads with each an epoll
+// set of non-blocking sockets, instead of a thread (and its stack) per
+// connection. The request handlers are shared with the thread-per-
+// connection mode, see http_conn_t.
+
+#define IO_BUFFER_SIZE 65536
+// as much as fits in the socket buffer is sent anyway
+#define IO_SENDFILE_SIZE (16 * 1024 * 1024)
+
+static void set_non_blocking(const int fd, const bool nb)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags == -1 || fcntl(fd, F_SETFL, nb ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) == -1)
+		log(LL_WARNING, "fcntl on %d failed: %s", fd, strerror(errno));
+}
+
+// >0: bytes, 0: connection closed, -1: error, -2: try again later
+static int io_read(h_handle_t & hh, char *const whereto, const int len)
+{
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+		int rc = SSL_read(hh.sh, whereto, len);
+
+		if (rc > 0)
+			return rc;
+
+		int err = SSL_get_error(hh.sh, rc);
+
+		if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+			return -2;
+
+		return err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+	}
+#endif
+
+	int rc = read(hh.fd, whereto, len);
+
+	if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return -2;
+
+	return rc;
+}
+
+// >0: bytes, -1: error, -2: try again later
+static int io_send(h_handle_t & hh, const void *const wherefrom, const size_t len)
+{
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+		int rc = SSL_write(hh.sh, wherefrom, std::min(len, size_t(IO_BUFFER_SIZE)));
+
+		if (rc > 0)
+			return rc;
+
+		int err = SSL_get_error(hh.sh, rc);
+
+		return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? -2 : -1;
+	}
+#endif
+
+	ssize_t rc = send(hh.fd, wherefrom, len, MSG_NOSIGNAL);
+
+	if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return -2;
+
+	return rc <= 0 ? -1 : rc;
+}
+
+// as io_send() but gathering the buffers; plain sockets only
+static int io_sendv(h_handle_t & hh, struct iovec *const iov, const int iovcnt)
+{
+	msghdr msg { };
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = iovcnt;
+
+	ssize_t rc = sendmsg(hh.fd, &msg, MSG_NOSIGNAL);
+
+	if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return -2;
+
+	return rc <= 0 ? -1 : rc;
+}
+
+// as io_send() but from a file, without copying (see CAN_SENDFILE_SSL())
+static int io_sendfile(h_handle_t & hh, const int fd, off_t *const offset, const size_t len)
+{
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+#if defined(SSL_OP_ENABLE_KTLS)
+		ossl_ssize_t rc = SSL_sendfile(hh.sh, fd, *offset, len, 0);
+
+		if (rc > 0) {
+			*offset += rc;
+
+			return rc;
+		}
+
+		int err = SSL_get_error(hh.sh, rc);
+
+		return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? -2 : -1;
+#else
+		return -1;
+#endif
+	}
+#endif
+
+	ssize_t rc = sendfile(hh.fd, fd, offset, len);
+
+	if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return -2;
+
+	return rc <= 0 ? -1 : rc;
+}
+
+void http_server::start_io_threads()
+{
+	log(id, LL_INFO, "Starting %d I/O threads", io_threads);
+
+	const std::lock_guard<std::mutex> lock(data_lock);
+
+	for(int i=0; i<io_threads; i++) {
+		http_io_thread_t *cur = new http_io_thread_t();
+
+		cur->efd = epoll_create1(EPOLL_CLOEXEC);
+		if (cur->efd == -1)
+			error_exit(true, "epoll_create1 failed");
+
+		cur->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (cur->wake_fd == -1)
+			error_exit(true, "eventfd failed");
+
+		epoll_event ev { };
+		ev.events   = EPOLLIN;
+		ev.data.ptr = nullptr;
+
+		if (epoll_ctl(cur->efd, EPOLL_CTL_ADD, cur->wake_fd, &ev) == -1)
+			error_exit(true, "epoll_ctl failed");
+
+		cur->th = new std::thread(&http_server::io_thread, this, cur);
+
+		io.push_back(cur);
+	}
+}
+
+void http_server::stop_io_threads()
+{
+	std::vector<http_io_thread_t *> temp;
+
+	{
+		const std::lock_guard<std::mutex> lock(data_lock);
+
+		std::swap(temp, io);
+	}
+
+	for(auto cur : temp) {
+		uint64_t v = 1;
+		if (write(cur->wake_fd, &v, sizeof v) != sizeof v)
+			log(id, LL_DEBUG, "waking up I/O thread failed");
+
+		cur->th->join();
+		delete cur->th;
+
+		close(cur->wake_fd);
+		close(cur->efd);
+
+		delete cur;
+	}
+}
+
+// invoked by the thread accepting connections
+void http_server::add_io_connection(http_thread_t *const ct)
+{
+	ct->peer_name = get_endpoint_name(ct->hh.fd);
+
+	set_non_blocking(ct->hh.fd, true);
+
+	ct->hh.conn = new http_conn_t();
+
+#if HAVE_OPENSSL == 1
+	if (ct->hh.sh) {
+		// a write that would block must be retried with the same data;
+		// 'out' may be appended to in the mean time
+		SSL_set_mode(ct->hh.sh, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+		ct->hh.conn->state = HC_TLS_ACCEPT;
+	}
+#endif
+
+	{
+		const std::lock_guard<std::mutex> lock(data_lock);
+
+		data.push_back(ct);
+	}
+
+	http_io_thread_t *const cur = io.at(io_next++ % io.size());
+
+	{
+		const std::lock_guard<std::mutex> lock(cur->lock);
+
+		cur->pending.push_back(ct);
+	}
+
+	uint64_t v = 1;
+	if (write(cur->wake_fd, &v, sizeof v) != sizeof v)
+		log(id, LL_WARNING, "waking up I/O thread failed");
+}
+
+void http_server::io_set_events(http_io_thread_t *const io, http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+	uint32_t events = hc->in_eof ? 0 : EPOLLIN;
+
+	if (hc->has_output() || hc->tls_want_write)
+		events |= EPOLLOUT;
+
+	if (events == hc->events)
+		return;
+
+	epoll_event ev { };
+	ev.events   = events;
+	ev.data.ptr = ct;
+
+	if (epoll_ctl(io->efd, EPOLL_CTL_MOD, ct->hh.fd, &ev) == -1)
+		log(id, LL_WARNING, "epoll_ctl failed: %s", strerror(errno));
+	else
+		hc->events = events;
+}
+
+// false when the connection failed
+bool http_server::io_read_request(http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+	for(;;) {
+		char buffer[4096];
+
+		int rc = io_read(ct->hh, buffer, sizeof buffer);
+
+		if (rc == -2)
+			break;
+
+		if (rc <= 0)
+			return false;
+
+		hc->in.append(buffer, rc);
+
+		if (hc->in.size() > IO_BUFFER_SIZE) {
+			log(id, LL_INFO, "Request from %s too large", ct->peer_name.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// These wait for frames, for other threads, for the database or scan
+// directories. They get a thread of their own instead of stalling all
+// connections of an I/O thread. This is decided before anything of the
+// request is handled: the thread handles it completely.
+static bool is_blocking_request(const std::string & request_headers)
+{
+	std::vector<std::string> *parts = split(request_headers.substr(0, request_headers.find_first_of("\r\n")), " ");
+
+	std::string path = parts->size() == 3 ? un_url_escape(parts->at(1)) : "/";
+
+	delete parts;
+
+	while(!path.empty() && path.at(0) == '/')
+		path = path.substr(1);
+
+	path = path.substr(0, path.find('?'));
+
+	return path == "stream.ogg" || path == "stream.mpng" || path == "image.jpg" || path == "image.png" ||
+		path == "fs-db.html" || path == "fs-db.mjpeg" || path.substr(0, 5) == "rest/" ||
+		path == "start" || path == "stop" || path == "toggle-start-stop" || path == "restart" ||
+		path == "snapshot-img/" || path == "snapshot-video/" ||
+		path == "view-snapshots" || path == "view-snapshots/" || path == "send-file-db" || path == "view-menu";
+}
+
+void http_server::io_dispatch(http_io_thread_t *const io, http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+	std::optional<std::string> request_headers;
+
+	if (!motion_compatible) {
+		size_t end = hc->in.find("\r\n\r\n");
+		size_t end_len = 4;
+
+		if (end == std::string::npos) {
+			end = hc->in.find("\n\n");
+			end_len = 2;
+		}
+
+		if (end == std::string::npos)
+			return;  // not complete yet
+
+		request_headers = hc->in.substr(0, end + end_len);
+
+		// a POST request: wait for its body; the handler obtains it via
+		// READ_SSL()
+		std::vector<std::string> *header_lines = split(request_headers.value(), "\r\n");
+
+		auto content_length = find_header(*header_lines, "Content-Length");
+
+		delete header_lines;
+
+		size_t cl = content_length.has_value() ? size_t(atoll(content_length.value().second.c_str())) : 0;
+
+		// the request must fit in the input buffer: a partial body is never
+		// dispatched
+		if (cl > IO_BUFFER_SIZE - (end + end_len)) {
+			log(id, LL_INFO, "Request body from %s too large (%zu bytes)", ct->peer_name.c_str(), cl);
+
+			std::string reply = "HTTP/1.0 413 Payload Too Large\r\nServer: " NAME " " VERSION "\r\n\r\n";
+
+			(void)WRITE_SSL(ct->hh, reply.c_str(), reply.size());
+
+			hc->in.clear();
+			hc->state = HC_RESPONSE;
+
+			return;
+		}
+
+		if (hc->in.size() < end + end_len + cl)
+			return;
+
+		hc->body_offset = end + end_len;
+	}
+
+	if (request_headers.has_value() && is_blocking_request(request_headers.value())) {
+		hc->state = HC_HANDOFF;
+
+		io_handoff(io, ct, request_headers.value());
+
+		return;
+	}
+
+	hc->state = HC_RESPONSE;
+
+	try {
+		handle_request(ct, request_headers);
+	}
+	catch(const std::exception & ex) {
+		log(id, LL_ERR, "std::exception for %s: %s", ct->peer_name.c_str(), ex.what());
+
+		hc->state = HC_CLOSED;
+	}
+}
+
+// for requests that would block the I/O thread: handled by a thread of its
+// own (like with io-threads = 0)
+void http_server::io_handoff(http_io_thread_t *const io, http_thread_t *const ct, const std::string & request_headers)
+{
+	if (epoll_ctl(io->efd, EPOLL_CTL_DEL, ct->hh.fd, nullptr) == -1)
+		log(id, LL_WARNING, "epoll_ctl failed: %s", strerror(errno));
+
+	io->conns.erase(std::find(io->conns.begin(), io->conns.end(), ct));
+
+	delete ct->hh.conn;
+	ct->hh.conn = nullptr;
+
+	set_non_blocking(ct->hh.fd, false);
+
+	ct->st.start();
+
+	// purge_threads() must not see it without its thread
+	const std::lock_guard<std::mutex> lock(data_lock);
+
+	ct->th = new std::thread(&http_server::handle_http_client_thread, this, ct, request_headers);
+}
+
+// false when the connection failed
+bool http_server::io_write(http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+	for(;;) {
+		int rc = 0;
+
+		bool tls = false;
+#if HAVE_OPENSSL == 1
+		tls = ct->hh.sh != nullptr;
+#endif
+
+		if (hc->out_offset < hc->out.size() && hc->out_data_offset < hc->out_data_len && !tls) {
+			// e.g. the response headers and the first part of a stream
+			struct iovec iov[] {
+				{ &hc->out[hc->out_offset], hc->out.size() - hc->out_offset },
+				{ const_cast<uint8_t *>(&hc->out_data[hc->out_data_offset]), hc->out_data_len - hc->out_data_offset }
+			};
+
+			rc = io_sendv(ct->hh, iov, 2);
+
+			if (rc > 0) {
+				size_t n_out = std::min(size_t(rc), iov[0].iov_len);
+
+				hc->out_offset      += n_out;
+				hc->out_data_offset += rc - n_out;
+			}
+		}
+		else if (hc->out_offset < hc->out.size()) {
+			rc = io_send(ct->hh, &hc->out[hc->out_offset], hc->out.size() - hc->out_offset);
+
+			if (rc > 0)
+				hc->out_offset += rc;
+		}
+		else if (hc->out_data_offset < hc->out_data_len) {
+			rc = io_send(ct->hh, &hc->out_data[hc->out_data_offset], hc->out_data_len - hc->out_data_offset);
+
+			if (rc > 0)
+				hc->out_data_offset += rc;
+		}
+		else {
+			hc->out.clear();
+			hc->out_offset = 0;
+
+			// a part of an MJPEG stream has been sent completely; repeated
+			// frames are not counted in the latency statistics
+			if (hc->out_part && hc->out_part->captured_ts)
+				ct->st.track_latency(FS_WRITTEN, get_us() - hc->out_part->captured_ts);
+
+			hc->out_part.reset();
+
+			hc->out_data = nullptr;
+			hc->out_data_len = hc->out_data_offset = 0;
+
+			if (hc->state != HC_FILE)
+				break;
+
+			size_t n = std::min(off_t(IO_BUFFER_SIZE), hc->file_end - hc->file_offset);
+
+			if (n == 0) {
+				hc->state = HC_RESPONSE;
+				break;
+			}
+
+			if (hc->file_zero_copy) {
+				rc = io_sendfile(ct->hh, hc->file_fd, &hc->file_offset, std::min(off_t(IO_SENDFILE_SIZE), hc->file_end - hc->file_offset));
+
+				// e.g. a filesystem that doesn't support it
+				if (rc == -1 && hc->file_offset == hc->file_start && (errno == EINVAL || errno == ENOSYS)) {
+					hc->file_zero_copy = false;
+					continue;
+				}
+			}
+			else {
+				hc->out.resize(n);
+
+				ssize_t n_read = pread(hc->file_fd, &hc->out[0], n, hc->file_offset);
+
+				if (n_read <= 0) {
+					log(id, LL_WARNING, "Cannot read file: %s", n_read == 0 ? "unexpected end" : strerror(errno));
+					return false;
+				}
+
+				hc->out.resize(n_read);
+				hc->file_offset += n_read;
+
+				continue;
+			}
+		}
+
+		if (rc == -2)
+			break;
+
+		if (rc < 0) {
+			log(id, LL_DEBUG, "short write to %s", ct->peer_name.c_str());
+			return false;
+		}
+
+		ct->st.track_bw(rc);
+	}
+
+	return true;
+}
+
+void http_server::io_close(http_io_thread_t *const io, http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+	if (epoll_ctl(io->efd, EPOLL_CTL_DEL, ct->hh.fd, nullptr) == -1)
+		log(id, LL_DEBUG, "epoll_ctl failed: %s", strerror(errno));
+
+	io->conns.erase(std::find(io->conns.begin(), io->conns.end(), ct));
+
+	if (hc->hub)
+		hc->hub->unsubscribe(hc->hub_client);
+
+	if (hc->s) {
+		register_peer(false, ct->peer_name);
+
+		// stopping an on-demand source joins its thread: not here
+		ct->stop_source = hc->s;
+	}
+
+	if (hc->file_fd != -1) {
+		track_download(hc->file_name, hc->file_offset - hc->file_start, get_us() - hc->file_start_ts, hc->file_zero_copy);
+
+		close(hc->file_fd);
+	}
+
+	delete hc;
+	ct->hh.conn = nullptr;
+
+	CLOSE_SSL(ct->hh);
+
+	ct->is_terminated = true;
+}
+
+void http_server::io_handle(http_io_thread_t *const io, http_thread_t *const ct)
+{
+	http_conn_t *const hc = ct->hh.conn;
+
+#if HAVE_OPENSSL == 1
+	if (hc->state == HC_TLS_ACCEPT) {
+		int rc = SSL_accept(ct->hh.sh);
+
+		if (rc == 1)
+			hc->state = HC_REQUEST;
+		else {
+			int err = SSL_get_error(ct->hh.sh, rc);
+
+			if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) {
+				log(id, LL_WARNING, "SSL (accept) error for %s", ct->peer_name.c_str());
+				hc->state = HC_CLOSED;
+				return;
+			}
+
+			hc->tls_want_write = err == SSL_ERROR_WANT_WRITE;
+			return;
+		}
+
+		hc->tls_want_write = false;
+	}
+#endif
+
+	if (hc->state == HC_REQUEST) {
+		if (!motion_compatible && !io_read_request(ct)) {
+			hc->state = HC_CLOSED;
+			return;
+		}
+
+		io_dispatch(io, ct);
+
+		if (hc->state == HC_HANDOFF || hc->state == HC_REQUEST || hc->state == HC_CLOSED)
+			return;
+	}
+	else if (!hc->in_eof) {
+		// nothing is expected from the client anymore
+		char buffer[4096];
+		int rc = 0;
+
+		while((rc = io_read(ct->hh, buffer, sizeof buffer)) > 0) {
+		}
+
+		if (rc == 0 || rc == -1) {
+			// a viewer has gone, other replies are sent anyway
+			if (hc->state == HC_STREAM || rc == -1) {
+				hc->state = HC_CLOSED;
+				return;
+			}
+
+			hc->in_eof = true;
+		}
+	}
+
+	if (!io_write(ct))
+		hc->state = HC_CLOSED;
+}
+
+void http_server::io_thread(http_io_thread_t *const io)
+{
+	set_thread_name("http_io");
+
+	sigset_t all_sigs;
+	sigfillset(&all_sigs);
+	pthread_sigmask(SIG_BLOCK, &all_sigs, nullptr);
+
+	uint64_t next_tick = get_us() + 1000000;
+
+	constexpr int max_events = 64;
+	epoll_event events[max_events];
+
+	while(!local_stop_flag) {
+		// new stream parts wake this thread via wake_fd
+		int n = epoll_wait(io->efd, events, max_events, 100);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+
+			log(id, LL_ERR, "epoll_wait failed: %s", strerror(errno));
+			break;
+		}
+
+		for(int i=0; i<n; i++) {
+			http_thread_t *ct = reinterpret_cast<http_thread_t *>(events[i].data.ptr);
+
+			if (!ct) {
+				uint64_t v = 0;
+				if (read(io->wake_fd, &v, sizeof v) != sizeof v)
+					log(id, LL_DEBUG, "reading eventfd failed");
+
+				std::vector<http_thread_t *> temp;
+
+				{
+					const std::lock_guard<std::mutex> lock(io->lock);
+
+					std::swap(temp, io->pending);
+				}
+
+				for(auto cur : temp) {
+					epoll_event ev { };
+					ev.events   = EPOLLIN;
+					ev.data.ptr = cur;
+
+					cur->hh.conn->io = io;
+
+					io->conns.push_back(cur);
+
+					if (epoll_ctl(io->efd, EPOLL_CTL_ADD, cur->hh.fd, &ev) == -1) {
+						log(id, LL_WARNING, "epoll_ctl failed: %s", strerror(errno));
+
+						cur->hh.conn->state = HC_CLOSED;
+					}
+					else {
+						cur->hh.conn->events = EPOLLIN;
+
+						// e.g. motion-compatible doesn't wait for a request
+						io_handle(io, cur);
+					}
+				}
+
+				continue;
+			}
+
+			if (ct->hh.conn == nullptr || ct->hh.conn->state == HC_CLOSED)
+				continue;
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				ct->hh.conn->state = HC_CLOSED;
+			else
+				io_handle(io, ct);
+		}
+
+		const uint64_t now = get_us();
+
+		// handed off connections are no longer in 'conns'
+		for(size_t i=0; i<io->conns.size();) {
+			http_thread_t *ct = io->conns.at(i);
+			http_conn_t *const hc = ct->hh.conn;
+
+			if (hc->state == HC_STREAM && !hc->has_output()) {
+				if (!stream_mjpeg_frame(ct) || !io_write(ct))
+					hc->state = HC_CLOSED;
+			}
+
+			if (hc->state == HC_RESPONSE && !hc->has_output())
+				hc->state = HC_CLOSED;
+
+			if (hc->state == HC_CLOSED) {
+				io_close(io, ct);
+				continue;
+			}
+
+			io_set_events(io, ct);
+
+			i++;
+		}
+
+		if (now >= next_tick) {
+			next_tick = now + 1000000;
+
+			for(auto ct : io->conns)
+				ct->st.tick();
+
+			io->st.track_cpu_usage();
+			io->st.tick();
+		}
+	}
+
+	while(!io->conns.empty())
+		io_close(io, io->conns.at(0));
+
+	const std::lock_guard<std::mutex> lock(io->lock);
+
+	for(auto ct : io->pending) {
+		ct->hh.conn->state = HC_CLOSED;
+
+		io->conns.push_back(ct);
+
+		io_close(io, ct);
+	}
+
+	io->pending.clear();
+}
@@ -0,0 +1,81 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#include "http_server.h"
+#include "stats_tracker.h"
+
+class source;
+struct http_io_thread_t;
+
+typedef enum {
+	HC_TLS_ACCEPT,  // TLS handshake
+	HC_REQUEST,     // receiving the request headers (and body)
+	HC_RESPONSE,    // sending the reply, closed when done
+	HC_FILE,        // sending a file (send_file())
+	HC_STREAM,      // MJPEG stream, a part per frame
+	HC_HANDOFF,     // the handler blocks: it gets a thread of its own
+	HC_CLOSED
+} http_conn_state_t;
+
+// State of a connection handled by an I/O thread (io-threads > 0). The
+// request handlers are the same as for thread-per-connection: in this
+// mode WRITE_SSL() appends to 'out' which is sent when the (non-blocking)
+// socket is writable.
+struct http_conn_t
+{
+	http_io_thread_t *io { nullptr };
+
+	http_conn_state_t state { HC_REQUEST };
+	uint32_t events { 0 };  // what epoll is waiting for
+	bool in_eof { false }, tls_want_write { false };
+
+	std::string in;  // request headers and body
+	size_t body_offset { 0 };  // READ_SSL() continues here
+
+	std::string out;
+	size_t out_offset { 0 };
+
+	// sent after 'out' without copying: a part of a stream
+	std::shared_ptr<const mjpeg_part_t> out_part;
+	const uint8_t *out_data { nullptr };
+	size_t out_data_len { 0 }, out_data_offset { 0 };
+
+	// HC_FILE: the range [file_start, file_end) of the file
+	int file_fd { -1 };
+	off_t file_start { 0 }, file_offset { 0 }, file_end { 0 };
+	bool file_zero_copy { false };  // sendfile() instead of pread()
+	std::string file_name;
+	uint64_t file_start_ts { 0 };
+
+	// HC_STREAM
+	source *s { nullptr };
+	http_mjpeg_hub *hub { nullptr };
+	mjpeg_hub_client_t *hub_client { nullptr };
+	uint64_t end_ts { 0 };
+	bool first { true }, get { true };
+	std::string cookie;
+
+	bool has_output() const { return out_offset < out.size() || out_data_offset < out_data_len; }
+};
+
+struct http_io_thread_t
+{
+	int efd { -1 };
+	int wake_fd { -1 };  // eventfd, signalled for new connections in 'pending' and new stream parts
+	std::thread *th { nullptr };
+
+	std::mutex lock;
+	std::vector<http_thread_t *> pending;
+
+	// only accessed by 'th'
+	std::vector<http_thread_t *> conns;
+
+	stats_tracker st { "st:http-io", false };
+};
@@ -28,6 +28,29 @@
 #include "target.h"
 #include "controls.h"
 
+#if HAVE_JANSSON == 1
+json_t *get_latency_json(const interface *const i)
+{
+	json_t *json = json_object();
+
+	for(int stage=FS_CAPTURED + 1; stage<FS_N; stage++) {
+		auto p = i->get_latency_percentiles(frame_stage_t(stage), { 50., 95., 99. });
+
+		if (p.empty())
+			continue;
+
+		json_t *record = json_object();
+		json_object_set_new(record, "p50", json_integer(p.at(0)));
+		json_object_set_new(record, "p95", json_integer(p.at(1)));
+		json_object_set_new(record, "p99", json_integer(p.at(2)));
+
+		json_object_set_new(json, frame_stage_name(frame_stage_t(stage)).c_str(), record);
+	}
+
+	return json;
+}
+#endif
+
 void run_rest(h_handle_t & hh, configuration_t *const cfg, const std::string & path, const std::map<std::string, std::string> & pars, const std::string & snapshot_dir, const int quality)
 {
 #if HAVE_JANSSON == 1
@@ -112,6 +135,8 @@ void run_rest(h_handle_t & hh, configuration_t *const cfg, const std::string & p
 			json_object_set_new(record, "file", json_string(file.name.c_str()));
 			json_object_set_new(record, "mtime", json_integer(file.last_change));
 			json_object_set_new(record, "size", json_integer(file.size));
+			// for If-None-Match when fetching it
+			json_object_set_new(record, "etag", json_string(file_etag(file.last_change, file.size).c_str()));
 
 			json_array_append_new(out_arr, record);
 		}
@@ -336,6 +361,11 @@ void run_rest(h_handle_t & hh, configuration_t *const cfg, const std::string & p
 			json_object_set_new(json, "result", json_false());
 		}
 	}
+	else if (parts -> at(1) == "get-latency") {
+		json_object_set_new(json, "msg", json_string("OK"));
+		json_object_set_new(json, "result", json_true());
+		json_object_set_new(json, "data", get_latency_json(i));
+	}
 	else if (parts -> at(1) == "reset-controls") {
 		controls *c = static_cast<source *>(i)->get_controls();
 
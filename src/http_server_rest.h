@@ -1,5 +1,14 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
+#include "config.h"
+#if HAVE_JANSSON == 1
+#include <jansson.h>
+#endif
 #include "http_server.h"
 
 void run_rest(h_handle_t & hh, configuration_t *const cfg, const std::string & path, const std::map<std::string, std::string> & pars, const std::string & snapshot_dir, const int quality);
+
+#if HAVE_JANSSON == 1
+// p50/p95/p99 (in microseconds) of the time from capture to each stage
+json_t *get_latency_json(const interface *const i);
+#endif
@@ -1,8 +1,11 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #include "config.h"
+#include <inttypes.h>
 #include <string>
 
 #include "gen.h"
+#include "frame_pool.h"
+#include "jpeg_cache.h"
 #include "utils.h"
 #if HAVE_GSTREAMER == 1
 #include "target_avi.h"
@@ -107,6 +110,22 @@ std::string describe_interface(const instance *const inst, const interface *cons
 		out += "<dt>bandwidth</dt><dd><strong id=\"bw-" + module_int + "\">" + myformat("%d", i->get_bw() / 1024) + "</strong><strong>kB/s</strong></dd>";
 		out += "<dt>connection count</dt><dd><strong id=\"cc-" + module_int + "\">" + myformat("%ld", ((http_server *)i)->get_connection_count()) + "</strong></dd>";
 	}
+	if (i->get_class_type() == CT_SOURCE) {
+		auto pool = static_cast<const source *>(i)->get_frame_pool();
+		out += "<dt>frame buffer pool hits/misses</dt><dd><strong>" + myformat("%" PRIu64 " / %" PRIu64, pool->get_hits(), pool->get_misses()) + "</strong></dd>";
+		out += "<dt>frame buffer pool size</dt><dd><strong>" + myformat("%zu", pool->get_bytes_kept() / 1024) + "</strong><strong>kB</strong></dd>";
+		auto jcache = static_cast<const source *>(i)->get_jpeg_cache();
+		out += "<dt>shared JPEG encodings (reused/encoded)</dt><dd><strong>" + myformat("%" PRIu64 " / %" PRIu64, jcache->get_hits(), jcache->get_misses()) + "</strong></dd>";
+	}
+	std::string latencies;
+	for(int stage=FS_CAPTURED + 1; stage<FS_N; stage++) {
+		auto p = i->get_latency_percentiles(frame_stage_t(stage), { 50., 95., 99. });
+
+		if (!p.empty())
+			latencies += myformat("%s: %.1f / %.1f / %.1f<br>", frame_stage_name(frame_stage_t(stage)).c_str(), p.at(0) / 1000., p.at(1) / 1000., p.at(2) / 1000.);
+	}
+	if (!latencies.empty())
+		out += "<dt>time since capture p50/p95/p99 (ms)</dt><dd><strong>" + latencies + "</strong></dd>";
 	out += "</dl>";
 
 	out += emit_stats_refresh_js(module_int, true, true, is_httpd, is_httpd);
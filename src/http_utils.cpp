@@ -1,6 +1,13 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #include "config.h"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <string>
 #include <unistd.h>
+#include <vector>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #if HAVE_OPENSSL == 1
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -9,8 +16,12 @@
 #include "error.h"
 #include "interface.h"
 #include "http_server.h"
+#include "http_server_epoll.h"
 #include "log.h"
 
+// the maximum payload of a TLS record
+#define TLS_RECORD_SIZE size_t(16384)
+
 #if HAVE_OPENSSL == 1
 SSL_CTX *create_context(const ssl_pars_t & sp)
 {
@@ -24,6 +35,12 @@ SSL_CTX *create_context(const ssl_pars_t & sp)
 
 	SSL_CTX_set_ecdh_auto(ctx, 1);
 
+#if defined(SSL_OP_ENABLE_KTLS)
+	// let the kernel do the encryption (when it can) so that files can be
+	// sent with SSL_sendfile()
+	SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
 	if (SSL_CTX_use_certificate_file(ctx, sp.certificate_file.c_str(), SSL_FILETYPE_PEM) <= 0) {
 		ERR_print_errors_fp(stderr);
 		error_exit(false, "Unable to set certificate file");
@@ -40,6 +57,10 @@ SSL_CTX *create_context(const ssl_pars_t & sp)
 
 void CLOSE_SSL(h_handle_t & hh)
 {
+	// the I/O thread closes it when everything has been sent
+	if (hh.conn)
+		return;
+
 #if HAVE_OPENSSL == 1
 	if (hh.sh) {
 		SSL_shutdown(hh.sh);
@@ -52,6 +73,9 @@ void CLOSE_SSL(h_handle_t & hh)
 
 int AVAILABLE_SSL(h_handle_t & hh)
 {
+	if (hh.conn)
+		return hh.conn->in.size() - hh.conn->body_offset;
+
 #if HAVE_OPENSSL == 1
 	if (hh.sh)
 		return SSL_pending(hh.sh);
@@ -63,6 +87,16 @@ int AVAILABLE_SSL(h_handle_t & hh)
 // note: can return less than requested
 int READ_SSL(h_handle_t & hh, char *whereto, int len)
 {
+	// the I/O thread has received the request body already
+	if (hh.conn) {
+		int n = std::min(size_t(len), hh.conn->in.size() - hh.conn->body_offset);
+
+		memcpy(whereto, &hh.conn->in[hh.conn->body_offset], n);
+		hh.conn->body_offset += n;
+
+		return n;
+	}
+
         for(;;) {
 		int rc = -1;
 #if HAVE_OPENSSL == 1
@@ -102,6 +136,13 @@ int READ_SSL(h_handle_t & hh, char *whereto, int len)
 // note: blocks until everything has been sent
 int WRITE_SSL(h_handle_t & hh, const char *wherefrom, int len)
 {
+	// queued, the I/O thread sends it when the socket is writable
+	if (hh.conn) {
+		hh.conn->out.append(wherefrom, len);
+
+		return len;
+	}
+
         int cnt = len;
 
         while(len > 0) {
@@ -142,6 +183,148 @@ int WRITE_SSL(h_handle_t & hh, const char *wherefrom, int len)
         return cnt;
 }
 
+// as WRITE_SSL() but gathers the buffers: one writev() for plain sockets.
+// For TLS the small buffers around the largest one (e.g. the headers
+// before a JPEG) are copied together with at most a TLS record of the
+// largest, so that they don't become records of their own; the rest of
+// the largest is written as is.
+int WRITEV_SSL(h_handle_t & hh, const struct iovec *const iov, const int iovcnt)
+{
+	size_t total = 0;
+
+	for(int i=0; i<iovcnt; i++)
+		total += iov[i].iov_len;
+
+	// queued for the I/O thread
+	if (hh.conn) {
+		for(int i=0; i<iovcnt; i++)
+			WRITE_SSL(hh, reinterpret_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+
+		return total;
+	}
+
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+		int largest = 0;
+
+		for(int i=1; i<iovcnt; i++) {
+			if (iov[i].iov_len > iov[largest].iov_len)
+				largest = i;
+		}
+
+		const char *const big = iovcnt > 0 ? reinterpret_cast<const char *>(iov[largest].iov_base) : nullptr;
+		const size_t big_len = iovcnt > 0 ? iov[largest].iov_len : 0;
+
+		std::string before, after;
+
+		for(int i=0; i<iovcnt; i++) {
+			if (i < largest)
+				before.append(reinterpret_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+			else if (i > largest)
+				after.append(reinterpret_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+		}
+
+		// fill the first and the last record
+		size_t n_head = 0, n_tail = 0;
+
+		if (!before.empty()) {
+			n_head = std::min(big_len, before.size() < TLS_RECORD_SIZE ? TLS_RECORD_SIZE - before.size() : 0);
+			before.append(big, n_head);
+		}
+
+		if (!after.empty()) {
+			n_tail = std::min(big_len - n_head, after.size() < TLS_RECORD_SIZE ? TLS_RECORD_SIZE - after.size() : 0);
+			after.insert(0, big + big_len - n_tail, n_tail);
+		}
+
+		if (!before.empty() && WRITE_SSL(hh, before.data(), before.size()) <= 0)
+			return -1;
+
+		if (big_len - n_head - n_tail > 0 && WRITE_SSL(hh, big + n_head, big_len - n_head - n_tail) <= 0)
+			return -1;
+
+		if (!after.empty() && WRITE_SSL(hh, after.data(), after.size()) <= 0)
+			return -1;
+
+		return total;
+	}
+#endif
+
+	std::vector<struct iovec> todo(iov, iov + iovcnt);
+	size_t idx = 0;
+
+	while(idx < todo.size()) {
+		ssize_t rc = writev(hh.fd, &todo[idx], todo.size() - idx);
+
+		if (rc == -1 && errno == EINTR)
+			continue;
+
+		if (rc <= 0)
+			return rc;
+
+		// skip what has been sent
+		while(rc > 0) {
+			if (size_t(rc) >= todo[idx].iov_len) {
+				rc -= todo[idx].iov_len;
+				idx++;
+			}
+			else {
+				todo[idx].iov_base = reinterpret_cast<uint8_t *>(todo[idx].iov_base) + rc;
+				todo[idx].iov_len -= rc;
+				rc = 0;
+			}
+		}
+
+		// e.g. empty buffers at the end
+		while(idx < todo.size() && todo[idx].iov_len == 0)
+			idx++;
+	}
+
+	return total;
+}
+
+// whether SENDFILE_SSL() can be used: always for plain sockets, for TLS
+// only when the kernel does the encryption (kTLS)
+bool CAN_SENDFILE_SSL(h_handle_t & hh)
+{
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+#if defined(SSL_OP_ENABLE_KTLS)
+		return BIO_get_ktls_send(SSL_get_wbio(hh.sh));
+#else
+		return false;
+#endif
+	}
+#endif
+
+	return true;
+}
+
+// sends 'count' bytes from 'fd' at 'offset' without copying them to user
+// space; like sendfile(2) it can send less than requested
+ssize_t SENDFILE_SSL(h_handle_t & hh, const int fd, off_t *const offset, const size_t count)
+{
+#if HAVE_OPENSSL == 1
+	if (hh.sh) {
+#if defined(SSL_OP_ENABLE_KTLS)
+		ossl_ssize_t rc = SSL_sendfile(hh.sh, fd, *offset, count, 0);
+
+		if (rc > 0) {
+			*offset += rc;
+
+			return rc;
+		}
+
+		log(LL_WARNING, "SSL (sendfile) error: %s", ERR_error_string(ERR_get_error(), NULL));
+#endif
+
+		return -1;
+	}
+#endif
+
+	return sendfile(hh.fd, fd, offset, count);
+}
+
 void ACCEPT_SSL(h_handle_t & hh)
 {
 #if HAVE_OPENSSL == 1
@@ -1,6 +1,8 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
 #include "config.h"
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #if HAVE_OPENSSL == 1
 SSL_CTX *create_context(const ssl_pars_t & sp);
@@ -9,4 +11,7 @@ void CLOSE_SSL(h_handle_t & hh);
 int AVAILABLE_SSL(h_handle_t & hh);
 int READ_SSL(h_handle_t & hh, char *whereto, int len);
 int WRITE_SSL(h_handle_t & hh, const char *wherefrom, int len);
+int WRITEV_SSL(h_handle_t & hh, const struct iovec *const iov, const int iovcnt);
+bool CAN_SENDFILE_SSL(h_handle_t & hh);
+ssize_t SENDFILE_SSL(h_handle_t & hh, const int fd, off_t *const offset, const size_t count);
 void ACCEPT_SSL(h_handle_t & hh);
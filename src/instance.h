@@ -13,4 +13,8 @@ public:
 
 	std::vector<interface *> interfaces;
 	std::string name, descr;
+
+	// in how many stripes frames are processed in parallel; 0 is the
+	// global default (see worker-stripes)
+	int stripes { 0 };
 };
@@ -76,6 +76,7 @@ public:
 	virtual double get_cpu_usage() const { return st->get_cpu_usage(); }
 	std::optional<double> get_fps() const { return st->get_fps(); }
 	virtual int get_bw() const { return st->get_bw(); }
+	std::vector<uint64_t> get_latency_percentiles(const frame_stage_t stage, const std::vector<double> & percentiles) const { return st->get_latency_percentiles(stage, percentiles); }
 
 	virtual void start();
 	bool is_running() const;
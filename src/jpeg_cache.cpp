@@ -0,0 +1,45 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include "jpeg_cache.h"
+
+jpeg_cache::jpeg_cache()
+{
+}
+
+jpeg_cache::~jpeg_cache()
+{
+}
+
+frame_data_t jpeg_cache::get(const uint64_t ts, const int quality, const int w, const int h, const uintptr_t variant, const std::function<frame_data_t()> & encode)
+{
+	std::unique_lock<std::mutex> lck(lock);
+
+	auto & e = entries[{ quality, w, h, variant }];
+
+	if (!e)
+		e = std::make_shared<entry_t>();
+
+	auto entry = e;
+
+	lck.unlock();
+
+	// concurrent requests for the same frame wait here for the one
+	// that encodes it
+	const std::lock_guard<std::mutex> elck(entry->lock);
+
+	if (entry->ts == ts && entry->data.first) {
+		hits++;
+
+		return entry->data;
+	}
+
+	misses++;
+
+	frame_data_t data = encode();
+
+	if (data.first) {
+		entry->ts   = ts;
+		entry->data = data;
+	}
+
+	return data;
+}
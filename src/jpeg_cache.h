@@ -0,0 +1,43 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <tuple>
+
+#include "gen.h"
+
+// Per source cache of the latest JPEG encoding of a frame. All consumers
+// (MJPEG streams, snapshots, JPEG/RTSP targets) of a source get the
+// same frame; the first one that needs a JPEG of it encodes, the others
+// wait for that and reuse the result.
+class jpeg_cache
+{
+private:
+	typedef struct {
+		std::mutex lock;
+		uint64_t   ts { 0 };
+		frame_data_t data;
+	} entry_t;
+
+	// key: quality, width, height, variant (e.g. the resizer used)
+	typedef std::tuple<int, int, int, uintptr_t> key_t;
+
+	std::mutex lock;
+	std::map<key_t, std::shared_ptr<entry_t> > entries;
+
+	std::atomic_uint64_t hits { 0 }, misses { 0 };
+
+public:
+	jpeg_cache();
+	virtual ~jpeg_cache();
+
+	// 'encode' is invoked when there's no JPEG for this frame (ts) yet
+	frame_data_t get(const uint64_t ts, const int quality, const int w, const int h, const uintptr_t variant, const std::function<frame_data_t()> & encode);
+
+	uint64_t get_hits() const { return hits; }
+	uint64_t get_misses() const { return misses; }
+};
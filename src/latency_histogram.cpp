@@ -0,0 +1,108 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <cstring>
+
+#include "latency_histogram.h"
+
+std::string frame_stage_name(const frame_stage_t stage)
+{
+	switch(stage) {
+		case FS_CAPTURED:
+			return "captured";
+		case FS_DECODED:
+			return "decoded";
+		case FS_FILTERED:
+			return "filtered";
+		case FS_ENCODED:
+			return "encoded";
+		case FS_WRITTEN:
+			return "written";
+		case FS_N:
+			break;
+	}
+
+	return "?";
+}
+
+latency_histogram::latency_histogram()
+{
+}
+
+latency_histogram::~latency_histogram()
+{
+}
+
+int latency_histogram::get_bucket(const uint64_t us)
+{
+	if (us < (1 << sub_bits))
+		return us;
+
+	const int msb = 63 - __builtin_clzll(us);
+
+	int bucket = ((msb - sub_bits + 1) << sub_bits) + ((us >> (msb - sub_bits)) & ((1 << sub_bits) - 1));
+
+	return bucket < n_buckets ? bucket : n_buckets - 1;
+}
+
+// center of the bucket
+uint64_t latency_histogram::get_bucket_value(const int bucket)
+{
+	if (bucket < (1 << sub_bits))
+		return bucket;
+
+	const int shift = (bucket >> sub_bits) - 1;
+	const uint64_t mantissa = (1 << sub_bits) + (bucket & ((1 << sub_bits) - 1));
+
+	return (mantissa << shift) + (uint64_t(1) << shift) / 2;
+}
+
+void latency_histogram::add(const uint64_t us)
+{
+	const int bucket = get_bucket(us);
+
+	const std::lock_guard<std::mutex> lck(lock);
+
+	counts[cur][bucket]++;
+	n[cur]++;
+}
+
+// forget the measurements of the previous period
+void latency_histogram::age()
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	cur ^= 1;
+
+	memset(counts[cur], 0x00, sizeof counts[cur]);
+	n[cur] = 0;
+}
+
+std::vector<uint64_t> latency_histogram::get_percentiles(const std::vector<double> & percentiles) const
+{
+	const std::lock_guard<std::mutex> lck(lock);
+
+	const uint64_t total = n[0] + n[1];
+
+	if (total == 0)
+		return { };
+
+	std::vector<uint64_t> out;
+
+	for(double p : percentiles) {
+		const uint64_t want = std::max(uint64_t(1), uint64_t(total * p / 100.));
+
+		uint64_t seen = 0;
+		int bucket = 0;
+
+		for(; bucket<n_buckets - 1; bucket++) {
+			seen += counts[0][bucket] + counts[1][bucket];
+
+			if (seen >= want)
+				break;
+		}
+
+		out.push_back(get_bucket_value(bucket));
+	}
+
+	return out;
+}
@@ -0,0 +1,39 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// the stages a frame goes through, from camera to network/disk
+typedef enum { FS_CAPTURED = 0, FS_DECODED, FS_FILTERED, FS_ENCODED, FS_WRITTEN, FS_N } frame_stage_t;
+
+std::string frame_stage_name(const frame_stage_t stage);
+
+// Distribution of latencies (in microseconds) over the last 30-60 seconds.
+// Buckets are 1/8th of a power of 2 wide, percentiles are thus accurate
+// to about 6%.
+class latency_histogram
+{
+private:
+	static constexpr int sub_bits = 3;
+	static constexpr int n_buckets = 40 << sub_bits;
+
+	mutable std::mutex lock;
+	uint32_t counts[2][n_buckets] { };
+	uint64_t n[2] { };
+	int cur { 0 };
+
+	static int get_bucket(const uint64_t us);
+	static uint64_t get_bucket_value(const int bucket);
+
+public:
+	latency_histogram();
+	virtual ~latency_histogram();
+
+	void add(const uint64_t us);
+	void age();
+
+	// empty when there are no measurements
+	std::vector<uint64_t> get_percentiles(const std::vector<double> & percentiles) const;
+};
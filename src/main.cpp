@@ -75,6 +75,7 @@
 #include "instance.h"
 #include "utils.h"
 #include "source_libcamera.h"
+#include "worker_pool.h"
 
 std::atomic_bool terminate { false };
 
@@ -687,6 +688,8 @@ int main(int argc, char *argv[])
 		delete i;
 	}
 
+	uninit_worker_pool();
+
 	delete cfg->r;
 
 	delete cfg->clnr;
@@ -0,0 +1,186 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+
+#include "morphology.h"
+
+template <typename T, bool is_max>
+static inline T op(const T a, const T b)
+{
+	return is_max ? std::max(a, b) : std::min(a, b);
+}
+
+// value that does not change the result of op()
+template <typename T, bool is_max>
+static constexpr T identity()
+{
+	return is_max ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+}
+
+// the loops over a full row below have no dependencies between the
+// elements so that the compiler can vectorize them
+template <typename T, bool is_max>
+static void op_rows(const T *const a, const T *const b, const int n, T *const out)
+{
+	for(int i=0; i<n; i++)
+		out[i] = op<T, is_max>(a[i], b[i]);
+}
+
+morphology::morphology()
+{
+}
+
+morphology::~morphology()
+{
+}
+
+template <typename T>
+T *morphology::get_buffer(std::vector<uint8_t> & b, const size_t n)
+{
+	if (b.size() < n * sizeof(T))
+		b.resize(n * sizeof(T));
+
+	return reinterpret_cast<T *>(b.data());
+}
+
+// The line is split in blocks of k elements. For each element the
+// maximum from the start of its block (g) and up to the end of its
+// block (h) is determined. A window of k elements then covers the end
+// of one block and the start of the next: its maximum is max(h[start],
+// g[end]).
+template <typename T, bool is_max>
+void morphology::filter_rows(const T *const in, const int w, const int h, const int k, T *const out)
+{
+	const int r = k / 2;
+	const int n = (w + 2 * r + k - 1) / k * k;
+
+	T *const g = get_buffer<T>(line_g, n);
+	T *const hh = get_buffer<T>(line_h, n);
+
+	for(int y=0; y<h; y++) {
+		// (padded) input
+		std::fill(&g[0], &g[r], identity<T, is_max>());
+		memcpy(&g[r], &in[size_t(y) * w], w * sizeof(T));
+		std::fill(&g[r + w], &g[n], identity<T, is_max>());
+
+		for(int b=0; b<n; b += k) {
+			hh[b + k - 1] = g[b + k - 1];
+
+			for(int i=b + k - 2; i>=b; i--)
+				hh[i] = op<T, is_max>(hh[i + 1], g[i]);
+
+			for(int i=b + 1; i<b + k; i++)
+				g[i] = op<T, is_max>(g[i - 1], g[i]);
+		}
+
+		op_rows<T, is_max>(hh, &g[2 * r], w, &out[size_t(y) * w]);
+	}
+}
+
+// Same as filter_rows but vertically and on complete rows at once. Only
+// the g/h rows of two blocks are kept.
+template <typename T, bool is_max>
+void morphology::filter_columns(const T *const in, const int w, const int h, const int k, T *const out)
+{
+	const int r = k / 2;
+	const int last_block = (h - 1 + 2 * r) / k;
+
+	const size_t block_elements = size_t(k) * w;
+
+	T *const buffers = get_buffer<T>(blocks, block_elements * 4);
+	T *g[2] = { buffers, buffers + block_elements };
+	T *hh[2] = { buffers + block_elements * 2, buffers + block_elements * 3 };
+
+	T *const empty_row = get_buffer<T>(empty, w);
+	std::fill(empty_row, empty_row + w, identity<T, is_max>());
+
+	auto padded_row = [in, w, h, r, empty_row](const int i) {
+		const int y = i - r;
+
+		return y >= 0 && y < h ? &in[size_t(y) * w] : empty_row;
+	};
+
+	auto emit_block = [out, w, h, k, r, &g, &hh](const int j) {
+		for(int y=j * k; y<std::min((j + 1) * k, h); y++) {
+			const int end = y + 2 * r;
+			const int end_block = end / k;
+
+			op_rows<T, is_max>(&hh[j & 1][size_t(y - j * k) * w], &g[end_block & 1][size_t(end - end_block * k) * w], w, &out[size_t(y) * w]);
+		}
+	};
+
+	for(int j=0; j<=last_block; j++) {
+		T *const cur_g = g[j & 1];
+		T *const cur_h = hh[j & 1];
+
+		const int b = j * k;
+
+		memcpy(&cur_h[size_t(k - 1) * w], padded_row(b + k - 1), w * sizeof(T));
+
+		for(int i=k - 2; i>=0; i--)
+			op_rows<T, is_max>(&cur_h[size_t(i + 1) * w], padded_row(b + i), w, &cur_h[size_t(i) * w]);
+
+		memcpy(cur_g, padded_row(b), w * sizeof(T));
+
+		for(int i=1; i<k; i++)
+			op_rows<T, is_max>(&cur_g[size_t(i - 1) * w], padded_row(b + i), w, &cur_g[size_t(i) * w]);
+
+		if (j > 0)
+			emit_block(j - 1);
+	}
+
+	emit_block(last_block);
+}
+
+template <typename T, bool is_max>
+void morphology::filter(const T *const in, const int w, const int h, const int k, T *const out)
+{
+	if (w <= 0 || h <= 0)
+		return;
+
+	T *const t = get_buffer<T>(temp, size_t(w) * h);
+
+	filter_rows<T, is_max>(in, w, h, k, t);
+
+	filter_columns<T, is_max>(t, w, h, k, out);
+}
+
+void morphology::dilate(const uint8_t *const in, const int w, const int h, const int k, uint8_t *const out)
+{
+	filter<uint8_t, true>(in, w, h, k, out);
+}
+
+void morphology::erode(const uint8_t *const in, const int w, const int h, const int k, uint8_t *const out)
+{
+	filter<uint8_t, false>(in, w, h, k, out);
+}
+
+void morphology::dilate(const uint32_t *const in, const int w, const int h, const int k, uint32_t *const out)
+{
+	filter<uint32_t, true>(in, w, h, k, out);
+}
+
+void morphology::erode(const uint32_t *const in, const int w, const int h, const int k, uint32_t *const out)
+{
+	filter<uint32_t, false>(in, w, h, k, out);
+}
+
+template <typename T>
+void morphology::apply_pattern(T *const in_out, const int w, const int h, const std::string & pattern)
+{
+	for(auto c : pattern) {
+		if (c == 'd')
+			dilate(in_out, w, h, 5, in_out);
+		else if (c == 'e')
+			erode(in_out, w, h, 5, in_out);
+		else if (c == 'D')
+			dilate(in_out, w, h, 9, in_out);
+		else if (c == 'E')
+			erode(in_out, w, h, 9, in_out);
+	}
+}
+
+template void morphology::apply_pattern<uint8_t>(uint8_t *const in_out, const int w, const int h, const std::string & pattern);
+template void morphology::apply_pattern<uint32_t>(uint32_t *const in_out, const int w, const int h, const std::string & pattern);
@@ -0,0 +1,36 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Dilation (maximum) and erosion (minimum) over a square window, done
+// separably with the van Herk/Gil-Werman algorithm: ~3 comparisons per
+// pixel per direction, regardless of the window size. The scratch
+// buffers are kept between invocations.
+// Outside the image is ignored (not counted as black/white).
+class morphology
+{
+private:
+	std::vector<uint8_t> line_g, line_h, temp, blocks, empty;
+
+	template <typename T> T *get_buffer(std::vector<uint8_t> & b, const size_t n);
+
+	template <typename T, bool is_max> void filter_rows(const T *const in, const int w, const int h, const int k, T *const out);
+	template <typename T, bool is_max> void filter_columns(const T *const in, const int w, const int h, const int k, T *const out);
+	template <typename T, bool is_max> void filter(const T *const in, const int w, const int h, const int k, T *const out);
+
+public:
+	morphology();
+	virtual ~morphology();
+
+	// 'k' is the width/height of the window and must be odd; 'in' and
+	// 'out' may be the same
+	void dilate(const uint8_t *const in, const int w, const int h, const int k, uint8_t *const out);
+	void erode(const uint8_t *const in, const int w, const int h, const int k, uint8_t *const out);
+	void dilate(const uint32_t *const in, const int w, const int h, const int k, uint32_t *const out);
+	void erode(const uint32_t *const in, const int w, const int h, const int k, uint32_t *const out);
+
+	// pattern: d/e = dilate/erode with a 5x5 window, D/E 9x9
+	template <typename T> void apply_pattern(T *const in_out, const int w, const int h, const std::string & pattern);
+};
@@ -0,0 +1,63 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <stdint.h>
+
+#include "motion_background.h"
+
+motion_background::motion_background()
+{
+}
+
+motion_background::~motion_background()
+{
+}
+
+bool motion_background::update(const uint8_t *const gray, const int w, const int h, const int noise_level, const int learn_shift, const int sigma, uint8_t *const fg)
+{
+	const int n = w * h;
+
+	if (w != this->w || h != this->h) {
+		this->w = w;
+		this->h = h;
+
+		mean.resize(n);
+		var.assign(n, 0);
+
+		for(int i=0; i<n; i++)
+			mean[i] = gray[i] << 8;
+
+		std::fill(fg, fg + n, 0);
+
+		return false;
+	}
+
+	uint16_t *const m = mean.data();
+	uint16_t *const v = var.data();
+
+	const int shift = std::max(0, std::min(learn_shift, 12));
+	// foreground is learned slower so that e.g. someone standing still
+	// takes a while to become background
+	const int fg_shift = shift + 2;
+	const int sigma2 = sigma * sigma;
+	const int noise2 = noise_level * noise_level;
+
+	// no branches so that the compiler can vectorize this loop
+	for(int i=0; i<n; i++) {
+		const int x = gray[i] << 8;
+		const int delta = x - m[i];  // 8.8
+		const int d = (delta + 128) >> 8;
+		const int d2 = d * d;
+
+		const bool is_fg = d2 >= noise2 && d2 > sigma2 * v[i];
+
+		fg[i] = is_fg ? 255 : 0;
+
+		m[i] += delta >> (is_fg ? fg_shift : shift);
+
+		// the variance of the background only
+		const int new_v = v[i] + ((d2 - v[i]) >> shift);
+		v[i] = is_fg ? v[i] : new_v;
+	}
+
+	return true;
+}
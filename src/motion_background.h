@@ -0,0 +1,29 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Background subtraction: a running mean and variance of the luma of
+// each pixel is maintained (in fixed point). A pixel is foreground when
+// it differs at least 'noise_level' from its mean and more than 'sigma'
+// times its standard deviation. Unlike comparing with the previous
+// frame, this also finds slow movement and it learns to ignore e.g.
+// flickering lights.
+class motion_background
+{
+private:
+	int w { 0 }, h { 0 };
+
+	std::vector<uint16_t> mean;  // 8.8 fixed point
+	std::vector<uint16_t> var;
+
+public:
+	motion_background();
+	virtual ~motion_background();
+
+	// Writes the foreground mask (255 = foreground) to 'fg' (w x h
+	// bytes) and learns the frame. 'learn_shift' selects the speed of
+	// learning: the model adapts with 1/2^learn_shift per frame.
+	// Returns false when the model was (re-)initialized.
+	bool update(const uint8_t *const gray, const int w, const int h, const int noise_level, const int learn_shift, const int sigma, uint8_t *const fg);
+};
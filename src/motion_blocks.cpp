@@ -0,0 +1,298 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "motion_blocks.h"
+
+// sum of absolute differences of each group of 8 pixels; n must be a
+// multiple of 16
+static void sad8_row(const uint8_t *const a, const uint8_t *const b, const int n, uint32_t *const out)
+{
+#if defined(__SSE2__)
+	for(int i=0; i<n; i += 16) {
+		const __m128i s = _mm_sad_epu8(_mm_loadu_si128((const __m128i *)&a[i]), _mm_loadu_si128((const __m128i *)&b[i]));
+
+		out[i / 8 + 0] = _mm_cvtsi128_si32(s);
+		out[i / 8 + 1] = _mm_extract_epi16(s, 4);
+	}
+#elif defined(__aarch64__)
+	for(int i=0; i<n; i += 16) {
+		const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vabdq_u8(vld1q_u8(&a[i]), vld1q_u8(&b[i])))));
+
+		out[i / 8 + 0] = vgetq_lane_u64(s, 0);
+		out[i / 8 + 1] = vgetq_lane_u64(s, 1);
+	}
+#else
+	for(int i=0; i<n; i += 8) {
+		uint32_t s = 0;
+
+		for(int k=0; k<8; k++)
+			s += abs(a[i + k] - b[i + k]);
+
+		out[i / 8] = s;
+	}
+#endif
+}
+
+template <int shift>
+static void sum_horizontally(const uint16_t *const in, const int sw, uint8_t *const out)
+{
+	constexpr int f = 1 << shift;
+	constexpr int round = 1 << (shift * 2 - 1);
+
+	for(int x=0; x<sw; x++) {
+		const uint16_t *const p = &in[x * f];
+		uint32_t sum = 0;
+
+		for(int k=0; k<f; k++)
+			sum += p[k];
+
+		out[x] = (sum + round) >> (shift * 2);
+	}
+}
+
+motion_blocks::motion_blocks(const int downscale, const int block_size) : scale_shift(downscale >= 8 ? 3 : 2), block_size(std::max(8, (block_size + 7) / 8 * 8))
+{
+}
+
+motion_blocks::~motion_blocks()
+{
+}
+
+void motion_blocks::setup(const int new_w, const int new_h)
+{
+	w = new_w;
+	h = new_h;
+
+	sw = w >> scale_shift;
+	sh = h >> scale_shift;
+
+	bw = (sw + block_size - 1) / block_size;
+	bh = (sh + block_size - 1) / block_size;
+
+	// padding is 0 in both images and thus never differs
+	stride = (bw * block_size + 15) / 16 * 16;
+
+	cur.assign(size_t(stride) * sh, 0);
+	prev.assign(size_t(stride) * sh, 0);
+	has_prev = false;
+
+	acc.resize(sw << scale_shift);
+	sums8.resize(stride / 8);
+	sad.resize(size_t(bw) * bh);
+	changed.resize(size_t(bw) * bh);
+
+	mask_of = nullptr;
+	block_mask.clear();
+}
+
+void motion_blocks::downscale(const uint8_t *const in)
+{
+	const int f = 1 << scale_shift;
+	const int n = sw << scale_shift;
+
+	uint16_t *const a = acc.data();
+
+	for(int y=0; y<sh; y++) {
+		const uint8_t *src = &in[size_t(y << scale_shift) * w];
+
+		for(int i=0; i<n; i++)
+			a[i] = src[i];
+
+		for(int k=1; k<f; k++) {
+			src += w;
+
+			for(int i=0; i<n; i++)
+				a[i] += src[i];
+		}
+
+		if (scale_shift == 3)
+			sum_horizontally<3>(a, sw, &cur[size_t(y) * stride]);
+		else
+			sum_horizontally<2>(a, sw, &cur[size_t(y) * stride]);
+	}
+}
+
+// a block is looked at when most of its pixels are selected
+void motion_blocks::calc_block_mask(const uint8_t *const psb)
+{
+	mask_of = psb;
+
+	block_mask.assign(size_t(bw) * bh, 1);
+	n_selected = bw * bh;
+
+	if (!psb)
+		return;
+
+	n_selected = 0;
+
+	const int f = 1 << scale_shift;
+
+	for(int by=0; by<bh; by++) {
+		for(int bx=0; bx<bw; bx++) {
+			int n = 0, n_set = 0;
+
+			const int y_end = std::min((by + 1) * block_size, sh) << scale_shift;
+			const int x_end = std::min((bx + 1) * block_size, sw) << scale_shift;
+
+			// one sample per pixel of the downscaled image
+			for(int y=(by * block_size) << scale_shift; y<y_end; y += f) {
+				for(int x=(bx * block_size) << scale_shift; x<x_end; x += f) {
+					n++;
+					n_set += psb[y * w + x] != 0;
+				}
+			}
+
+			const bool selected = n_set * 2 >= n;
+
+			block_mask[by * bw + bx] = selected;
+			n_selected += selected;
+		}
+	}
+}
+
+void motion_blocks::find_boxes(motion_blocks_result_t *const r)
+{
+	std::vector<uint8_t> seen(changed.size());
+	std::vector<int> todo;
+
+	const int bs = block_size << scale_shift;
+
+	for(int i=0; i<bw * bh; i++) {
+		if (!changed[i] || seen[i])
+			continue;
+
+		int x0 = bw, y0 = bh, x1 = -1, y1 = -1;
+
+		seen[i] = 1;
+		todo.push_back(i);
+
+		while(!todo.empty()) {
+			const int cur_i = todo.back();
+			todo.pop_back();
+
+			const int bx = cur_i % bw, by = cur_i / bw;
+
+			x0 = std::min(x0, bx);
+			y0 = std::min(y0, by);
+			x1 = std::max(x1, bx);
+			y1 = std::max(y1, by);
+
+			for(int ny=std::max(0, by - 1); ny<=std::min(bh - 1, by + 1); ny++) {
+				for(int nx=std::max(0, bx - 1); nx<=std::min(bw - 1, bx + 1); nx++) {
+					const int ni = ny * bw + nx;
+
+					if (changed[ni] && !seen[ni]) {
+						seen[ni] = 1;
+						todo.push_back(ni);
+					}
+				}
+			}
+		}
+
+		motion_box_t box;
+		box.x = x0 * bs;
+		box.y = y0 * bs;
+		box.w = std::min((x1 + 1) * bs, w) - box.x;
+		box.h = std::min((y1 + 1) * bs, h) - box.y;
+
+		r->boxes.push_back(box);
+	}
+}
+
+bool motion_blocks::detect(const uint8_t *const gray, const int w, const int h, const uint8_t *const psb, const int noise_level, motion_blocks_result_t *const r)
+{
+	r->changed_percentage = 0.;
+	r->cx = r->cy = r->dx = r->dy = 0;
+	r->boxes.clear();
+
+	if (w != this->w || h != this->h)
+		setup(w, h);
+
+	if (bw == 0 || bh == 0)
+		return false;
+
+	if (psb != mask_of || block_mask.empty())
+		calc_block_mask(psb);
+
+	downscale(gray);
+
+	if (!has_prev) {
+		std::swap(cur, prev);
+		has_prev = true;
+
+		return false;
+	}
+
+	std::fill(sad.begin(), sad.end(), 0);
+
+	const int groups_per_block = block_size / 8;
+
+	for(int y=0; y<sh; y++) {
+		sad8_row(&cur[size_t(y) * stride], &prev[size_t(y) * stride], stride, sums8.data());
+
+		uint32_t *const sad_row = &sad[(y / block_size) * bw];
+
+		for(int bx=0, g=0; bx<bw; bx++) {
+			uint32_t s = 0;
+
+			for(int k=0; k<groups_per_block; k++)
+				s += sums8[g++];
+
+			sad_row[bx] += s;
+		}
+	}
+
+	const int bs = block_size << scale_shift;
+
+	int n_changed = 0;
+	long long sum_x = 0, sum_y = 0;
+
+	for(int by=0, i=0; by<bh; by++) {
+		const int n_rows = std::min(block_size, sh - by * block_size);
+
+		for(int bx=0; bx<bw; bx++, i++) {
+			const int n_pixels = n_rows * std::min(block_size, sw - bx * block_size);
+
+			changed[i] = block_mask[i] && sad[i] >= uint32_t(noise_level * n_pixels);
+
+			if (changed[i]) {
+				n_changed++;
+				sum_x += bx * bs + bs / 2;
+				sum_y += by * bs + bs / 2;
+			}
+		}
+	}
+
+	if (n_changed) {
+		r->changed_percentage = n_changed * 100.0 / n_selected;
+
+		r->cx = sum_x / n_changed;
+		r->cy = sum_y / n_changed;
+
+		long long dx = 0, dy = 0;
+
+		for(int i=0; i<bw * bh; i++) {
+			if (changed[i]) {
+				dx += abs(r->cx - ((i % bw) * bs + bs / 2));
+				dy += abs(r->cy - ((i / bw) * bs + bs / 2));
+			}
+		}
+
+		r->dx = dx / n_changed;
+		r->dy = dy / n_changed;
+
+		find_boxes(r);
+	}
+
+	std::swap(cur, prev);
+
+	return true;
+}
@@ -0,0 +1,58 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+typedef struct {
+	int x, y, w, h;
+} motion_box_t;
+
+typedef struct {
+	double changed_percentage;  // of the blocks that are selected
+	int cx, cy;  // center of the changed blocks
+	int dx, dy;  // average distance of the changed blocks to the center
+	std::vector<motion_box_t> boxes;  // groups of adjacent changed blocks
+} motion_blocks_result_t;
+
+// Motion detection on blocks of a (1/4 or 1/8) downscaled luma image:
+// the sum of absolute differences (SAD) of each block with the previous
+// frame is compared to a threshold. Much cheaper than comparing every
+// pixel of e.g. 4K frames. All coordinates are in pixels of the frame
+// (not of the downscaled image).
+class motion_blocks
+{
+private:
+	const int scale_shift;  // 2: 1/4, 3: 1/8
+	const int block_size;   // in pixels of the downscaled image, a multiple of 8
+
+	int w { 0 }, h { 0 };
+	int sw { 0 }, sh { 0 }, stride { 0 };  // downscaled image
+	int bw { 0 }, bh { 0 };  // number of blocks
+
+	std::vector<uint8_t> cur, prev;
+	bool has_prev { false };
+
+	std::vector<uint16_t> acc;     // one row, vertically summed
+	std::vector<uint32_t> sums8;   // SAD per 8 pixels of one row
+	std::vector<uint32_t> sad;     // per block
+	std::vector<uint8_t> changed;  // per block
+
+	const uint8_t *mask_of { nullptr };
+	std::vector<uint8_t> block_mask;
+	int n_selected { 0 };
+
+	void setup(const int new_w, const int new_h);
+	void downscale(const uint8_t *const in);
+	void calc_block_mask(const uint8_t *const psb);
+	void find_boxes(motion_blocks_result_t *const r);
+
+public:
+	motion_blocks(const int downscale, const int block_size);
+	virtual ~motion_blocks();
+
+	// 'gray' is the luma of the frame, 'psb' the (optional) selection
+	// mask of w x h pixels. 'noise_level' is the minimum average
+	// difference of the pixels of a block for it to be counted as
+	// changed. Returns false when there's no previous frame (yet).
+	bool detect(const uint8_t *const gray, const int w, const int h, const uint8_t *const psb, const int noise_level, motion_blocks_result_t *const r);
+};
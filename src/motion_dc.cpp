@@ -0,0 +1,121 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+#include <stdlib.h>
+
+#include "motion_dc.h"
+#include "picio.h"
+#include "video_frame.h"
+
+motion_dc::motion_dc()
+{
+}
+
+motion_dc::~motion_dc()
+{
+}
+
+void motion_dc::average(const uint8_t *const gray)
+{
+	const int mw = get_map_w(w), mh = get_map_h(h);
+
+	std::vector<uint32_t> sums(mw);
+
+	for(int my=0; my<mh; my++) {
+		std::fill(sums.begin(), sums.end(), 0);
+
+		const int y_end = std::min(my * 8 + 8, h);
+
+		for(int y=my * 8; y<y_end; y++) {
+			const uint8_t *const row = &gray[size_t(y) * w];
+
+			for(int x=0; x<w; x++)
+				sums[x / 8] += row[x];
+		}
+
+		for(int mx=0; mx<mw; mx++) {
+			const int n = (y_end - my * 8) * (std::min(mx * 8 + 8, w) - mx * 8);
+
+			cur[my * mw + mx] = (sums[mx] + n / 2) / n;
+		}
+	}
+}
+
+bool motion_dc::detect(video_frame *const vf, const uint8_t *const psb, const int noise_level, motion_blocks_result_t *const r)
+{
+	r->changed_percentage = 0.;
+	r->cx = r->cy = r->dx = r->dy = 0;
+	r->boxes.clear();
+
+	if (vf->get_w() != w || vf->get_h() != h) {
+		w = vf->get_w();
+		h = vf->get_h();
+
+		cur.resize(size_t(get_map_w(w)) * get_map_h(h));
+		prev.resize(cur.size());
+
+		has_prev = false;
+	}
+
+	if (cur.empty())
+		return false;
+
+	bool ok = false;
+
+	if (vf->has_encoding(E_JPEG)) {
+		auto jpeg = vf->get_data_and_len(E_JPEG);
+
+		ok = my_jpeg.read_JPEG_memory_dc(std::get<0>(jpeg), std::get<1>(jpeg), w, h, cur.data());
+	}
+
+	if (!ok)
+		average(vf->get_data(E_GRAY));
+
+	if (!has_prev) {
+		std::swap(cur, prev);
+		has_prev = true;
+
+		return false;
+	}
+
+	const int mw = get_map_w(w);
+	const int n = int(cur.size());
+
+	int n_changed = 0, n_selected = 0;
+	long long sum_x = 0, sum_y = 0;
+
+	for(int i=0; i<n; i++) {
+		if (psb && !psb[i])
+			continue;
+
+		n_selected++;
+
+		if (abs(cur[i] - prev[i]) >= noise_level) {
+			n_changed++;
+			sum_x += (i % mw) * 8 + 4;
+			sum_y += (i / mw) * 8 + 4;
+		}
+	}
+
+	if (n_changed) {
+		r->changed_percentage = n_changed * 100.0 / n_selected;
+
+		r->cx = sum_x / n_changed;
+		r->cy = sum_y / n_changed;
+
+		long long dx = 0, dy = 0;
+
+		for(int i=0; i<n; i++) {
+			if ((!psb || psb[i]) && abs(cur[i] - prev[i]) >= noise_level) {
+				dx += abs(r->cx - ((i % mw) * 8 + 4));
+				dy += abs(r->cy - ((i / mw) * 8 + 4));
+			}
+		}
+
+		r->dx = dx / n_changed;
+		r->dy = dy / n_changed;
+	}
+
+	std::swap(cur, prev);
+
+	return true;
+}
@@ -0,0 +1,35 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "motion_blocks.h"
+
+class video_frame;
+
+// Motion detection on the average brightness of each 8x8 pixels. For
+// JPEG frames (e.g. from MJPEG cameras) that's the DC coefficient of the
+// luma: obtaining it skips the IDCT and the whole decoding of the
+// chroma. Other frames are averaged from their luma (E_GRAY).
+class motion_dc
+{
+private:
+	int w { 0 }, h { 0 };
+	std::vector<uint8_t> cur, prev;
+	bool has_prev { false };
+
+	void average(const uint8_t *const gray);
+
+public:
+	motion_dc();
+	virtual ~motion_dc();
+
+	// size of the map (and thus of the selection mask for detect())
+	static int get_map_w(const int w) { return (w + 7) / 8; }
+	static int get_map_h(const int h) { return (h + 7) / 8; }
+
+	// 'psb' is the (optional) selection mask of the size of the map,
+	// 'noise_level' the difference at which a block counts as changed.
+	// Returns false when there's no previous frame (yet).
+	bool detect(video_frame *const vf, const uint8_t *const psb, const int noise_level, motion_blocks_result_t *const r);
+};
@@ -6,6 +6,7 @@
 #include <jansson.h>
 #endif
 #include <map>
+#include <memory>
 #include <shared_mutex>
 #include <string>
 #include <vector>
@@ -19,6 +20,13 @@ class selection_mask;
 class source;
 class target;
 
+// the pixels (!= 0) that the motion detection considers to be part of
+// the foreground in the latest frame
+typedef struct {
+	int w, h;
+	std::vector<uint8_t> mask;
+} foreground_mask_t;
+
 class motion_trigger : public interface
 {
 protected:
@@ -35,6 +43,8 @@ public:
 	virtual ~motion_trigger();
 
 	virtual bool check_motion() { return false; }
+	// nullptr when the detection method does not produce one
+	virtual std::shared_ptr<const foreground_mask_t> get_foreground_mask() { return nullptr; }
 
 #if HAVE_JANSSON == 1
 	json_t * get_rest_parameters();
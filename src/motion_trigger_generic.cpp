@@ -17,112 +17,21 @@
 #include "source.h"
 #include "utils.h"
 #include "picio.h"
+#include "prerecord_buffer.h"
 #include "target.h"
 #include "filter.h"
 #include "log.h"
 #include "exec.h"
 #include "db.h"
+#include "morphology.h"
+#include "motion_background.h"
+#include "motion_blocks.h"
+#include "motion_dc.h"
 #include "motion_trigger_generic.h"
 #include "parameters.h"
 #include "selection_mask.h"
 #include "schedule.h"
 
-void dilation(const uint8_t *const in, const int w, const int h, const int kernel_size, uint8_t *const out)
-{
-	int half_kernel = kernel_size / 2;
-
-	for(int y=half_kernel; y<h-half_kernel; y++) {
-		for(int x=half_kernel; x<w-half_kernel; x++) {
-			int best = -1;
-
-			for(int ky=y-half_kernel; ky<y+half_kernel; ky++) {
-				int offset = ky * w + x - half_kernel;
-
-				for(int k=0; k<kernel_size; k++)
-					best = std::max(int(in[offset++]), best);
-			}
-
-			out[y * w + x] = best;
-		}
-	}
-}
-
-void erode(const uint8_t *const in, const int w, const int h, const int kernel_size, uint8_t *const out)
-{
-	int half_kernel = kernel_size / 2;
-
-	for(int y=half_kernel; y<h-half_kernel; y++) {
-		for(int x=half_kernel; x<w-half_kernel; x++) {
-			int worst = 256;
-
-			for(int ky=y-half_kernel; ky<y+half_kernel; ky++) {
-				int offset = ky * w + x - half_kernel;
-
-				for(int k=0; k<kernel_size; k++)
-					worst = std::min(int(in[offset++]), worst);
-			}
-
-			out[y * w + x] = worst;
-		}
-	}
-}
-
-void despeckle(uint8_t *const in, const int w, const int h, const std::string & pattern)
-{
-	size_t n = IMS(w, h, 1);
-	uint8_t *temp1 = (uint8_t *)duplicate(in, n);
-	uint8_t *temp2 = (uint8_t *)malloc(n);
-
-	for(auto c : pattern) {
-		if (c == 'd')
-			dilation(temp1, w, h, 5, temp2);
-		else if (c == 'e')
-			erode(temp1, w, h, 5, temp2);
-		else if (c == 'D')
-			dilation(temp1, w, h, 9, temp2);
-		else if (c == 'E')
-			erode(temp1, w, h, 9, temp2);
-
-		uint8_t *temp = temp1;
-		temp1 = temp2;
-		temp2 = temp;
-	}
-
-	memcpy(in, temp1, n);
-
-	int half_kernel = 9 / 2;
-
-	for(int x=0; x<w; x++) {
-		for(int y=0; y<half_kernel; y++) 
-			in[y * w + x] = 0;
-
-		for(int y=h-half_kernel; y<h; y++)
-			in[y * w + x] = 0;
-	}
-
-	for(int y=0; y<h; y++) {
-		for(int x=0; x<half_kernel; x++)
-			in[y * w + x] = 0;
-
-		for(int x=w-half_kernel; x<w; x++)
-			in[y * w + x] = 0;
-	}
-
-	free(temp2);
-	free(temp1);
-}
-
-static void to_gray(const uint8_t *const rgb_in, const int n_pixels, uint8_t *const gray_out)
-{
-	for(int i=0, o=0; o<n_pixels;) {
-		int r = rgb_in[i++];
-		int g = rgb_in[i++];
-		int b = rgb_in[i++];
-
-		gray_out[o++] = (r + g + b) / 3;
-	}
-}
-
 void calc_diff(uint8_t *const dest, const int n_pixels, const uint8_t *const a, const uint8_t *const b)
 {
 	for(int i=0; i<n_pixels; i++)
@@ -168,6 +77,13 @@ motion_trigger_generic::~motion_trigger_generic()
 	free_filters(filters);
 }
 
+std::shared_ptr<const foreground_mask_t> motion_trigger_generic::get_foreground_mask()
+{
+	const std::lock_guard<std::mutex> lck(fg_lock);
+
+	return fg_mask;
+}
+
 void motion_trigger_generic::operator()()
 {
 	set_thread_name("motion_trigger_generic");
@@ -176,7 +92,7 @@ void motion_trigger_generic::operator()()
 
 	int stopping = 0, mute = 0, w = -1, h = -1;
 
-	std::vector<video_frame *> prerecord;
+	prerecord_buffer prerecord;
 
 	motion_triggered = false;
 
@@ -213,10 +129,15 @@ void motion_trigger_generic::operator()()
 	if (!despeckle_filter.empty())
 		log(id, LL_INFO, "Despeckle filter enabled (%s)", despeckle_filter.c_str());
 
-	uint8_t *gray_cur  = (uint8_t *)malloc(n_pixels);
-	uint8_t *gray_prev = (uint8_t *)calloc(1, n_pixels);
 	uint8_t *scratch   = (uint8_t *)malloc(n_pixels);
 
+	morphology despeckler;
+
+	motion_blocks *mb = nullptr;
+	motion_dc *md = nullptr;
+	motion_background *mbg = nullptr;
+	int mb_downscale = 0, mb_block_size = 0;
+
 	unsigned long event_nr = -1;
 	int count_frames_changed = 0;
 	for(;!local_stop_flag;) {
@@ -242,15 +163,36 @@ void motion_trigger_generic::operator()()
 			pvf = temp;
 		}
 
-		pvf->keep_only_format(E_RGB);
-
 		int cnt = 0, cx = 0, cy = 0;
+		double changed_perc = 0.;
 		double pan_factor = 1, tilt_factor = 1;
 		bool triggered = false;
 
 		bool pan_tilt = parameter::get_value_bool(parameters, "pan-tilt");
 
-		uint8_t *psb = pixel_select_bitmap ? pixel_select_bitmap -> get_mask(w, h) : nullptr;
+		const std::string detection_method = parameter::get_value_string(parameters, "detection-method");
+		const bool use_blocks = !et && detection_method == "blocks";
+		const bool use_dc = !et && detection_method == "jpeg-dc";
+		const bool use_bg = !et && detection_method == "background";
+
+		// jpeg-dc works on (and thus selects) blocks of 8x8 pixels
+		uint8_t *psb = nullptr;
+		if (pixel_select_bitmap)
+			psb = use_dc ? pixel_select_bitmap -> get_block_mask(w, h, 8) : pixel_select_bitmap -> get_mask(w, h);
+
+		// this one only needs the luma (E_GRAY) which is shared with
+		// other consumers of the frame and, for JPEG frames, does not
+		// require the chroma to be decoded
+		const bool use_gray = !et && (use_blocks || use_bg || psb || pan_tilt || !despeckle_filter.empty());
+
+		// detection-method can be changed via the REST interface
+		if (!use_bg && mbg) {
+			delete mbg;
+			mbg = nullptr;
+
+			const std::lock_guard<std::mutex> lck(fg_lock);
+			fg_mask = nullptr;
+		}
 
 		const int nl = parameter::get_value_int(parameters, "noise-factor");
 		const int nl3 = nl * 3;
@@ -271,25 +213,101 @@ void motion_trigger_generic::operator()()
 
 			prev_frame = pvf->duplicate(E_RGB);
 		}
-		else if (psb || pan_tilt || !despeckle_filter.empty()) {
-			to_gray(pvf->get_data(E_RGB), n_pixels, gray_cur);
-			calc_diff(scratch, n_pixels, gray_cur, gray_prev);
+		else if (use_blocks || use_dc) {
+			motion_blocks_result_t result;
+			bool have_result = false;
+
+			if (use_dc) {
+				if (!md)
+					md = new motion_dc();
+
+				have_result = md->detect(pvf, psb, nl, &result);
+			}
+			else {
+				const int downscale = parameter::get_value_int(parameters, "block-downscale");
+				const int block_size = parameter::get_value_int(parameters, "block-size");
+
+				// these can be changed via the REST interface
+				if (!mb || downscale != mb_downscale || block_size != mb_block_size) {
+					delete mb;
+					mb = new motion_blocks(downscale, block_size);
+
+					mb_downscale = downscale;
+					mb_block_size = block_size;
+				}
+
+				have_result = mb->detect(pvf->get_data(E_GRAY), w, h, psb, parameter::get_value_int(parameters, "block-noise-factor"), &result);
+			}
+
+			if (have_result) {
+				changed_perc = result.changed_percentage;
+
+				triggered = changed_perc > parameter::get_value_double(parameters, "min-pixels-changed-percentage") && changed_perc < parameter::get_value_double(parameters, "max-pixels-changed-percentage");
+
+				if (use_blocks) {
+					std::string boxes;
+
+					for(auto & b : result.boxes) {
+						if (!boxes.empty())
+							boxes += " ";
+
+						boxes += myformat("%d,%d,%d,%d", b.x, b.y, b.w, b.h);
+					}
+
+					get_meta() -> set_string("$motion-boxes$", std::pair<uint64_t, std::string>(0, boxes));
+				}
+
+				if (triggered && pan_tilt) {
+					cx = result.cx;
+					cy = result.cy;
+
+					pan_factor = (cx - result.dx) * 2. / w;
+					tilt_factor = (cy - result.dy) * 2. / h;
+				}
+			}
+		}
+		else if (use_gray && (prev_frame || use_bg)) {
+			// scratch is either the difference with the previous frame
+			// or the foreground mask (0 or 255)
+			if (use_bg) {
+				if (!mbg)
+					mbg = new motion_background();
+
+				mbg->update(pvf->get_data(E_GRAY), w, h, nl, parameter::get_value_int(parameters, "background-learn-shift"), parameter::get_value_int(parameters, "background-sigma"), scratch);
+			}
+			else {
+				calc_diff(scratch, n_pixels, pvf->get_data(E_GRAY), prev_frame->get_data(E_GRAY));
+			}
 
 			if (!despeckle_filter.empty())
-				despeckle(scratch, w, h, despeckle_filter);
+				despeckler.apply_pattern(scratch, w, h, despeckle_filter);
+
+			if (use_bg) {
+				auto mask = std::make_shared<foreground_mask_t>();
+				mask->w = w;
+				mask->h = h;
+				mask->mask.assign(scratch, scratch + n_pixels);
+
+				const std::lock_guard<std::mutex> lck(fg_lock);
+				fg_mask = mask;
+			}
+
+			const int threshold = use_bg ? 128 : nl;
 
 			for(int i=0; i<n_pixels; i++) {
 				if (psb && !psb[i])
 					continue;
 
-				if (scratch[i] >= nl) {
+				if (scratch[i] >= threshold) {
 					cnt++;
 					cx += i % w;
 					cy += i / w;
 				}
 			}
 
-			double temp = cnt * 100.0 / n_pixels;
+			changed_perc = cnt * 100.0 / n_pixels;
+
+			double temp = changed_perc;
 			triggered = temp > parameter::get_value_double(parameters, "min-pixels-changed-percentage") && temp < parameter::get_value_double(parameters, "max-pixels-changed-percentage");
 
 			if (triggered && pan_tilt) {
@@ -300,7 +318,7 @@ void motion_trigger_generic::operator()()
 
 				for(int y=0, o=0; y<h; y++) {
 					for(int x=0; x<w; x++) {
-						if (scratch[o++] >= nl) {
+						if (scratch[o++] >= threshold) {
 							dx += abs(cx - x);
 							dy += abs(cy - y);
 						}
@@ -317,13 +335,14 @@ void motion_trigger_generic::operator()()
 		else {
 			if (prev_frame) {
 				cnt = count_over_threshold(pvf->get_data(E_RGB), prev_frame->get_data(E_RGB), n_pixels * 3, nl);
+				changed_perc = cnt * 100.0 / n_pixels;
 
 				double temp = cnt * 100.0 / (n_pixels * 3);
 				triggered = temp > parameter::get_value_double(parameters, "min-pixels-changed-percentage") && temp < parameter::get_value_double(parameters, "max-pixels-changed-percentage");
 			}
 		}
 
-		get_meta() -> set_double("$pixels-changed$", std::pair<uint64_t, double>(0, cnt * 100.0 / n_pixels));
+		get_meta() -> set_double("$pixels-changed$", std::pair<uint64_t, double>(0, changed_perc));
 
 		bool triggered_by_audio = cv_event_notified.exchange(false);
 
@@ -340,7 +359,7 @@ void motion_trigger_generic::operator()()
 			count_frames_changed++;
 
 			if (count_frames_changed >= min_n_frames || et) {
-				log(id, LL_INFO, "motion detected (%f%% of the pixels changed)", cnt * 100.0 / n_pixels);
+				log(id, LL_INFO, "motion detected (%f%% of the pixels changed)", changed_perc);
 
 				for(auto ec : event_clients)
 					ec->notify_thread_of_event(s->get_id());
@@ -366,8 +385,10 @@ void motion_trigger_generic::operator()()
 							tm.tm_hour, tm.tm_min, tm.tm_sec);
 					get_meta()->set_string("$motion-timestamp$", std::pair<uint64_t, std::string>(get_us(), buffer));
 
+					std::vector<video_frame *> pre_frames = prerecord.take();
+
 					if (targets -> empty()) {
-						for(auto r : prerecord)
+						for(auto r : pre_frames)
 							delete r;
 					}
 					else {
@@ -376,12 +397,10 @@ void motion_trigger_generic::operator()()
 						for(size_t i=0; i<targets -> size(); i++) {
 							targets -> at(i) -> set_on_demand(true);
 
-							targets -> at(i) -> start(i == 0 ? prerecord : empty, event_nr);
+							targets -> at(i) -> start(i == 0 ? pre_frames : empty, event_nr);
 						}
 					}
 
-					prerecord.clear();
-
 					// no pan/tilt if ONLY triggered by audio
 					if (pan_tilt && triggered) {
 						const int hw = w / 2, hh = h / 2;
@@ -405,13 +424,14 @@ void motion_trigger_generic::operator()()
 
 					if (!remember_trigger.empty()) {
 						video_frame *copy = pvf->duplicate({ });
+						copy->own_data();
 
 						get_meta()->set_bitmap(remember_trigger, std::pair<uint64_t, video_frame *>(0, copy));
 					}
 				}
 			}
 			else {
-				log(id, LL_INFO, "%d/%d motion detected (%f%% of the pixels changed)", count_frames_changed, min_n_frames, cnt * 100.0 / n_pixels);
+				log(id, LL_INFO, "%d/%d motion detected (%f%% of the pixels changed)", count_frames_changed, min_n_frames, changed_perc);
 			}
 
 			stopping = 0;
@@ -443,24 +463,24 @@ void motion_trigger_generic::operator()()
 		}
 
 		size_t pre_duration = parameter::get_value_int(parameters, "pre-motion-record-duration");
+		size_t pre_bytes    = parameter::get_value_int(parameters, "pre-motion-record-bytes");
+
+		prerecord.set_limits(pre_duration, pre_bytes);
 
 		delete prev_frame;
 		if (pre_duration > 0) {
-			if (prerecord.size() >= pre_duration) {
-				delete prerecord.at(0);
-
-				prerecord.erase(prerecord.begin() + 0);
-			}
-
-			prerecord.push_back(pvf);
+			prev_frame = use_gray ? pvf->duplicate({ }) : pvf->duplicate(E_RGB);
 
-			prev_frame = pvf->duplicate(E_RGB);
+			// stored as JPEG
+			prerecord.add(pvf);
 		}
 		else {
 			prev_frame = pvf;
 		}
 
-		std::swap(gray_cur, gray_prev);
+		// kept until the next frame (which can take a while with a low
+		// max-fps): not in a zero-copy capture buffer
+		prev_frame->own_data();
 
 		st->track_cpu_usage();
 
@@ -469,17 +489,13 @@ void motion_trigger_generic::operator()()
 			mysleep(1000000 / fps_temp, &local_stop_flag, s);
 	}
 
-	free(gray_prev);
-	free(gray_cur);
+	delete mbg;
+	delete md;
+	delete mb;
+
 	free(scratch);
 	delete prev_frame;
 
-	while(!prerecord.empty()) {
-		delete prerecord.at(0);
-
-		prerecord.erase(prerecord.begin() + 0);
-	}
-
 	join_thread(&exec_start_th, id, "exec start");
 
 	join_thread(&exec_end_th, id, "exec end");
@@ -1,6 +1,7 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
 #include <atomic>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
 
@@ -46,11 +47,15 @@ private:
 
 	instance *const inst;
 
+	std::mutex fg_lock;
+	std::shared_ptr<const foreground_mask_t> fg_mask;
+
 public:
 	motion_trigger_generic(const std::string & id, const std::string & descr, source *const s, const int camera_warm_up, const std::vector<filter *> *const filters, std::vector<target *> *const targets, selection_mask *const pixel_select_bitmap, ext_trigger_t *const et, const std::string & e_start, const std::string & e_end, instance *const inst, const std::map<std::string, parameter *> & detection_parameters, schedule *const sched);
 	virtual ~motion_trigger_generic();
 
 	bool check_motion() override { return motion_triggered; }
+	std::shared_ptr<const foreground_mask_t> get_foreground_mask() override;
 
 	void operator()() override;
 };
@@ -12,6 +12,7 @@
 #include "source.h"
 #include "utils.h"
 #include "picio.h"
+#include "prerecord_buffer.h"
 #include "target.h"
 #include "filter.h"
 #include "log.h"
@@ -49,7 +50,7 @@ void motion_trigger_other_source::operator()()
 
 	bool recording = false;
 
-	std::vector<video_frame *> prerecord;
+	prerecord_buffer prerecord;
 
 	uint64_t prev_ts = get_us();
 
@@ -57,6 +58,9 @@ void motion_trigger_other_source::operator()()
 		bool allow_trigger = sched == nullptr || (sched && sched->is_on());
 
 		size_t pre_duration = parameter::get_value_int(parameters, "pre-motion-record-duration");
+		size_t pre_bytes    = parameter::get_value_int(parameters, "pre-motion-record-bytes");
+
+		prerecord.set_limits(pre_duration, pre_bytes);
 
 		st->track_fps();
 
@@ -65,30 +69,29 @@ void motion_trigger_other_source::operator()()
 			if (!f)
 				continue;
 
-			if (prerecord.size() >= pre_duration) {
-				delete prerecord.at(0);
-
-				prerecord.erase(prerecord.begin() + 0);
-			}
-
-			prerecord.push_back(f);
+			// stored as JPEG
+			prerecord.add(f);
 
 			if (cv_event_notified.exchange(false) && !recording && allow_trigger) {
 				recording = true;
 
-				log(id, LL_INFO, "starting (%zu pre-record frames)", prerecord.size());
+				log(id, LL_INFO, "starting (%zu pre-record frames, %zu bytes)", prerecord.size(), prerecord.get_bytes());
 
+				std::vector<video_frame *> pre_frames = prerecord.take();
 				std::vector<video_frame *> empty;
 
 				for(size_t i=0; i<targets -> size(); i++) {
 					targets -> at(i) -> set_on_demand(true);
 
-					targets -> at(i) -> start(i == 0 ? prerecord : empty, -1);
+					targets -> at(i) -> start(i == 0 ? pre_frames : empty, -1);
 				}
 
-				recording = true;
+				if (targets -> empty()) {
+					for(auto r : pre_frames)
+						delete r;
+				}
 
-				prerecord.clear();
+				recording = true;
 			}
 		}
 		// when not recording any frames before the motion starts, we can just sit idle and
@@ -137,11 +140,5 @@ void motion_trigger_other_source::operator()()
 
 	hr_s -> stop();
 
-	while(!prerecord.empty()) {
-		delete prerecord.at(0);
-
-		prerecord.erase(prerecord.begin() + 0);
-	}
-
 	register_thread_end("motion_trigger_other_source");
 }
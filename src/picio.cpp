@@ -197,10 +197,12 @@ myjpeg::myjpeg()
 {
 	jpegCompressor   = tjInitCompress();
 	jpegDecompressor = tjInitDecompress();
+	jpegTransformer  = tjInitTransform();
 }
 
 myjpeg::~myjpeg()
 {
+	tjDestroy(jpegTransformer);
 	tjDestroy(jpegDecompressor);
 	tjDestroy(jpegCompressor);
 }
@@ -275,7 +277,7 @@ bool myjpeg::write_JPEG_memory(const meta *const m, const int ncols, const int n
 	return true;
 }
 
-bool myjpeg::read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h, unsigned char **pixels)
+bool myjpeg::read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h, unsigned char **pixels, const int hint_w, const int hint_h)
 {
 	bool ok = true;
 
@@ -285,6 +287,30 @@ bool myjpeg::read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h,
 		return false;
 	}
 
+	if (hint_w > 0 && hint_h > 0) {
+		int n_factors = 0;
+		const tjscalingfactor *factors = tjGetScalingFactors(&n_factors);
+
+		int best_w = *w, best_h = *h;
+
+		for(int i=0; i<n_factors; i++) {
+			// 3/8 etc. are not much cheaper than a full decode
+			if (factors[i].num != 1)
+				continue;
+
+			const int scaled_w = TJSCALED(*w, factors[i]);
+			const int scaled_h = TJSCALED(*h, factors[i]);
+
+			if (scaled_w >= hint_w && scaled_h >= hint_h && scaled_w < best_w) {
+				best_w = scaled_w;
+				best_h = scaled_h;
+			}
+		}
+
+		*w = best_w;
+		*h = best_h;
+	}
+
 	*pixels = (unsigned char *)malloc(IMS(*w, *h, 3));
 	if (tjDecompress2(jpegDecompressor, in, n_bytes_in, *pixels, *w, 0/*pitch*/, *h, TJPF_RGB, TJFLAG_FASTDCT) == -1) {
 		log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
@@ -296,6 +322,203 @@ bool myjpeg::read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h,
 	return ok;
 }
 
+bool myjpeg::read_JPEG_memory(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const pixels)
+{
+	int jpeg_subsamp = 0, dw = -1, dh = -1;
+	if (tjDecompressHeader2(jpegDecompressor, (unsigned char *)in, n_bytes_in, &dw, &dh, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		return false;
+	}
+
+	if (dw != w || dh != h) {
+		log(LL_ERR, "JPEG has unexpected dimensions (%dx%d instead of %dx%d)", dw, dh, w, h);
+		return false;
+	}
+
+	if (tjDecompress2(jpegDecompressor, in, n_bytes_in, pixels, w, 0/*pitch*/, h, TJPF_RGB, TJFLAG_FASTDCT) == -1) {
+		log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
+		return false;
+	}
+
+	return true;
+}
+
+bool myjpeg::read_JPEG_memory_gray(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out)
+{
+	int jpeg_subsamp = 0, dw = -1, dh = -1;
+	if (tjDecompressHeader2(jpegDecompressor, (unsigned char *)in, n_bytes_in, &dw, &dh, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		return false;
+	}
+
+	if (dw != w || dh != h) {
+		log(LL_ERR, "JPEG has unexpected dimensions (%dx%d instead of %dx%d)", dw, dh, w, h);
+		return false;
+	}
+
+	if (tjDecompress2(jpegDecompressor, in, n_bytes_in, out, w, 0/*pitch*/, h, TJPF_GRAY, TJFLAG_FASTDCT) == -1) {
+		log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
+		return false;
+	}
+
+	return true;
+}
+
+bool myjpeg::read_JPEG_memory_dc(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out)
+{
+	int jpeg_subsamp = 0, dw = -1, dh = -1;
+	if (tjDecompressHeader2(jpegDecompressor, (unsigned char *)in, n_bytes_in, &dw, &dh, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		return false;
+	}
+
+	if (dw != w || dh != h) {
+		log(LL_ERR, "JPEG has unexpected dimensions (%dx%d instead of %dx%d)", dw, dh, w, h);
+		return false;
+	}
+
+	// at 1/8 scale the 'IDCT' of a block is just its DC coefficient
+	const tjscalingfactor eighth { 1, 8 };
+
+	if (tjDecompress2(jpegDecompressor, in, n_bytes_in, out, TJSCALED(w, eighth), 0/*pitch*/, TJSCALED(h, eighth), TJPF_GRAY, TJFLAG_FASTDCT) == -1) {
+		log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
+		return false;
+	}
+
+	return true;
+}
+
+bool myjpeg::read_JPEG_memory_i420(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out)
+{
+	int jpeg_subsamp = 0, dw = -1, dh = -1;
+	if (tjDecompressHeader2(jpegDecompressor, (unsigned char *)in, n_bytes_in, &dw, &dh, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		return false;
+	}
+
+	if (dw != w || dh != h) {
+		log(LL_ERR, "JPEG has unexpected dimensions (%dx%d instead of %dx%d)", dw, dh, w, h);
+		return false;
+	}
+
+	if (jpeg_subsamp != TJSAMP_420 && jpeg_subsamp != TJSAMP_422)
+		return false;
+
+	const int cw = (w + 1) / 2;
+	const int ch = (h + 1) / 2;
+
+	uint8_t *const y_ptr = out;
+	uint8_t *const u_ptr = out + w * h;
+	uint8_t *const v_ptr = u_ptr + cw * ch;
+
+	if (jpeg_subsamp == TJSAMP_420) {
+		uint8_t *dstPlanes[] = { y_ptr, u_ptr, v_ptr };
+
+		if (tjDecompressToYUVPlanes(jpegDecompressor, in, n_bytes_in, dstPlanes, w, nullptr, h, TJFLAG_FASTDCT) == -1) {
+			log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
+			return false;
+		}
+
+		return true;
+	}
+
+	// 4:2:2 (what most webcams produce): full height chroma, average two lines
+	uint8_t *temp = (uint8_t *)malloc(cw * h * 2);
+	uint8_t *dstPlanes[] = { y_ptr, temp, temp + cw * h };
+
+	if (tjDecompressToYUVPlanes(jpegDecompressor, in, n_bytes_in, dstPlanes, w, nullptr, h, TJFLAG_FASTDCT) == -1) {
+		log(LL_ERR, "Failed decompressing frame: %s", tjGetErrorStr());
+		free(temp);
+		return false;
+	}
+
+	for(int plane=0; plane<2; plane++) {
+		const uint8_t *const in_plane = dstPlanes[1 + plane];
+		uint8_t *out_plane = plane == 0 ? u_ptr : v_ptr;
+
+		for(int y=0; y<ch; y++) {
+			const uint8_t *line1 = &in_plane[y * 2 * cw];
+			const uint8_t *line2 = y * 2 + 1 < h ? line1 + cw : line1;
+
+			for(int x=0; x<cw; x++)
+				*out_plane++ = (line1[x] + line2[x] + 1) / 2;
+		}
+	}
+
+	free(temp);
+
+	return true;
+}
+
+bool myjpeg::encode_i420(const uint8_t *const rgb, const int w, const int h, uint8_t *const out)
+{
+	const int cw = (w + 1) / 2;
+	const int ch = (h + 1) / 2;
+
+	uint8_t *dstPlanes[] = { out, out + w * h, out + w * h + cw * ch };
+
+	if (tjEncodeYUVPlanes(jpegCompressor, rgb, w, 0, h, TJPF_RGB, dstPlanes, nullptr, TJSAMP_420, 0) == -1) {
+		log(LL_ERR, "Failed converting frame to YUV: %s", tjGetErrorStr());
+		return false;
+	}
+
+	return true;
+}
+
+bool myjpeg::transform_JPEG_memory(const uint8_t *const in, const size_t n_bytes_in, const int op, const int crop_x, const int crop_y, const int crop_w, const int crop_h, uint8_t **out, size_t *out_len, int *out_w, int *out_h)
+{
+	int jpeg_subsamp = 0, dw = -1, dh = -1;
+	if (tjDecompressHeader2(jpegDecompressor, (unsigned char *)in, n_bytes_in, &dw, &dh, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		return false;
+	}
+
+	// e.g. TJSAMP_UNKNOWN for unusual sampling factors: the caller then
+	// uses the RGB path
+	if (jpeg_subsamp < 0 || jpeg_subsamp >= TJ_NUMSAMP)
+		return false;
+
+	tjtransform xform;
+	memset(&xform, 0x00, sizeof xform);
+
+	xform.op      = op;
+	xform.options = TJXOPT_PERFECT;
+
+	if (crop_w > 0) {
+		if (crop_x % tjMCUWidth[jpeg_subsamp] || crop_y % tjMCUHeight[jpeg_subsamp])
+			return false;
+
+		if (crop_x + crop_w > dw || crop_y + crop_h > dh)
+			return false;
+
+		xform.options |= TJXOPT_CROP;
+		xform.r.x = crop_x;
+		xform.r.y = crop_y;
+		xform.r.w = crop_w;
+		xform.r.h = crop_h;
+	}
+
+	unsigned char *temp = nullptr;
+	unsigned long len = 0;
+
+	if (tjTransform(jpegTransformer, in, n_bytes_in, 1, &temp, &len, &xform, 0) == -1) {
+		// e.g. not "perfect" because of partial MCUs at the edges
+		log(LL_DEBUG, "Cannot transform JPEG losslessly: %s", tjGetErrorStr());
+		return false;
+	}
+
+	if (tjDecompressHeader2(jpegDecompressor, temp, len, out_w, out_h, &jpeg_subsamp) == -1) {
+		log(LL_ERR, "Failed decompressing frame(-header): %s", tjGetErrorStr());
+		tjFree(temp);
+		return false;
+	}
+
+	*out     = temp;
+	*out_len = len;
+
+	return true;
+}
+
 void myjpeg::rgb_to_i420(tjhandle t, const uint8_t *const in, const int width, const int height, uint8_t **const out, uint8_t **const y, uint8_t **const u, uint8_t **const v, const bool swap_rgb)
 {
 	*out = (uint8_t *)malloc(width * height + width * height / 2);
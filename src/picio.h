@@ -17,14 +17,37 @@ void load_PBM_file(FILE *const fh, int *const w, int *const h, uint8_t **out);
 class myjpeg
 {
 private:
-	tjhandle jpegDecompressor, jpegCompressor;
+	tjhandle jpegDecompressor, jpegCompressor, jpegTransformer;
 
 public:
 	myjpeg();
 	virtual ~myjpeg();
 
 	bool write_JPEG_memory(const meta *const m, const int ncols, const int nrows, const int quality, const uint8_t *const pixels, uint8_t **out, size_t *out_len);
-	bool read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h, unsigned char **pixels);
+	// With a size hint (e.g. resize-width/-height) the JPEG is decoded at the
+	// smallest of 1/1, 1/2, 1/4 and 1/8 scale that is still at least
+	// hint_w x hint_h; that's done while decoding (in the DCT domain) and
+	// thus costs almost nothing. *w and *h are set to the decoded size.
+	bool read_JPEG_memory(unsigned char *in, int n_bytes_in, int *w, int *h, unsigned char **pixels, const int hint_w = -1, const int hint_h = -1);
+	// decodes into 'pixels' (IMS(w, h, 3) bytes), fails when the JPEG is not w x h
+	bool read_JPEG_memory(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const pixels);
+	// decodes into an E_I420 buffer without going through RGB; only for
+	// 4:2:0 and 4:2:2 JPEGs, returns false for other subsamplings
+	bool read_JPEG_memory_i420(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out);
+	// decodes only the luma into an E_GRAY buffer: the chroma is not
+	// transformed nor upsampled
+	bool read_JPEG_memory_gray(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out);
+	// only the DC coefficients of the luma: one value (the average) per
+	// 8x8 pixels, 'out' must be ((w + 7) / 8) x ((h + 7) / 8) bytes
+	bool read_JPEG_memory_dc(const uint8_t *const in, const size_t n_bytes_in, const int w, const int h, uint8_t *const out);
+	// E_RGB -> E_I420
+	bool encode_i420(const uint8_t *const rgb, const int w, const int h, uint8_t *const out);
+
+	// Lossless transformation (TJXOP_...) and/or crop (when crop_w > 0) of
+	// a JPEG: the DCT coefficients are rearranged, nothing is decoded.
+	// Fails when it can't be done exactly, e.g. for a crop that does not
+	// start on an MCU boundary.
+	bool transform_JPEG_memory(const uint8_t *const in, const size_t n_bytes_in, const int op, const int crop_x, const int crop_y, const int crop_w, const int crop_h, uint8_t **out, size_t *out_len, int *out_w, int *out_h);
 
 	static void rgb_to_i420(transformer_t t, const uint8_t *const in, const int width, const int height, uint8_t **const out, uint8_t **const y = nullptr, uint8_t **const u = nullptr, uint8_t **const v = nullptr, const bool swap_rgb = false);
 	static void i420_to_rgb(transformer_t t, const uint8_t *const in, const int width, const int height, uint8_t **const out);
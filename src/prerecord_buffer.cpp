@@ -0,0 +1,102 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <tuple>
+
+#include "prerecord_buffer.h"
+#include "video_frame.h"
+
+prerecord_buffer::prerecord_buffer()
+{
+}
+
+prerecord_buffer::~prerecord_buffer()
+{
+	clear();
+}
+
+void prerecord_buffer::drop_oldest()
+{
+	delete ring.at(head);
+	ring.at(head) = nullptr;
+
+	bytes -= sizes.at(head);
+
+	head = (head + 1) % ring.size();
+	n--;
+}
+
+void prerecord_buffer::set_limits(const size_t max_frames, const size_t max_bytes)
+{
+	this->max_bytes = max_bytes;
+
+	if (max_frames == ring.size()) {
+		while(n > 0 && max_bytes > 0 && bytes > max_bytes)
+			drop_oldest();
+
+		return;
+	}
+
+	std::vector<video_frame *> frames = take();
+
+	ring.assign(max_frames, nullptr);
+	sizes.assign(max_frames, 0);
+
+	for(auto vf : frames)
+		add(vf);
+}
+
+void prerecord_buffer::add(video_frame *const vf)
+{
+	if (ring.empty()) {
+		delete vf;
+		return;
+	}
+
+	// only the JPEG is kept (it is shared with the frame when the source
+	// produced one); a zero-copy capture buffer is copied as it must go
+	// back to the driver
+	video_frame *jpeg = vf->duplicate(E_JPEG);
+	delete vf;
+
+	jpeg->own_data();
+
+	const size_t len = std::get<1>(jpeg->get_data_and_len(E_JPEG));
+
+	if (n == ring.size())
+		drop_oldest();
+
+	while(n > 0 && max_bytes > 0 && bytes + len > max_bytes)
+		drop_oldest();
+
+	const size_t tail = (head + n) % ring.size();
+
+	ring.at(tail) = jpeg;
+	sizes.at(tail) = len;
+
+	bytes += len;
+	n++;
+}
+
+std::vector<video_frame *> prerecord_buffer::take()
+{
+	std::vector<video_frame *> out;
+	out.reserve(n);
+
+	for(size_t i=0; i<n; i++) {
+		const size_t idx = (head + i) % ring.size();
+
+		out.push_back(ring.at(idx));
+		ring.at(idx) = nullptr;
+	}
+
+	head = n = bytes = 0;
+
+	return out;
+}
+
+void prerecord_buffer::clear()
+{
+	while(n > 0)
+		drop_oldest();
+
+	head = 0;
+}
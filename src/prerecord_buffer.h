@@ -0,0 +1,45 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+class video_frame;
+
+// Frames from before a motion event. These are stored as JPEG: a couple
+// of seconds of raw 1080p frames would take gigabytes. They're decoded
+// again by the targets, when there's an event. A zero-copy capture
+// buffer is copied, so that it is not kept out of the driver.
+// This is a ring of at most max_frames frames and max_bytes bytes (0 for
+// no limit); the oldest frames are dropped when either is reached.
+class prerecord_buffer
+{
+private:
+	std::vector<video_frame *> ring;
+	std::vector<size_t> sizes;
+	size_t head { 0 }, n { 0 };
+	size_t bytes { 0 };
+
+	size_t max_bytes { 0 };
+
+	void drop_oldest();
+
+public:
+	prerecord_buffer();
+	virtual ~prerecord_buffer();
+
+	// max_frames of 0 drops all frames; changing the limits keeps the
+	// newest frames that fit
+	void set_limits(const size_t max_frames, const size_t max_bytes);
+
+	// takes ownership of 'vf'
+	void add(video_frame *const vf);
+
+	// the frames, oldest first; the buffer is empty afterwards and the
+	// caller owns the frames
+	std::vector<video_frame *> take();
+
+	void clear();
+
+	size_t size() const { return n; }
+	size_t get_bytes() const { return bytes; }
+};
@@ -7,6 +7,7 @@
 #include "log.h"
 #include "utils.h"
 #include "pos.h"
+#include "worker_pool.h"
 
 void picture_in_picture(uint8_t *const tgt, const int tgt_w, const int tgt_h, const uint8_t *const in, const int win, const int hin, const pos_t pos)
 {
@@ -26,16 +27,18 @@ void picture_in_picture(uint8_t *const tgt, const int tgt_w, const int tgt_h, co
 				tx = 0;
 			}
 
-			for(int y=0; y<hin; y++) {
-				int yo = y + ty;
+			run_stripes(hin, 0, [&](const int y_start, const int y_end) {
+				for(int y=y_start; y<y_end; y++) {
+					int yo = y + ty;
 
-				if (yo < 0)
-					continue;
-				if (yo >= tgt_h)
-					break;
+					if (yo < 0)
+						continue;
+					if (yo >= tgt_h)
+						break;
 
-				memcpy(&tgt[yo * tgt_w * 3 + tx * 3], &in[y * win * 3 + x_offset * 3], (width - x_offset) * 3);
-			}
+					memcpy(&tgt[yo * tgt_w * 3 + tx * 3], &in[y * win * 3 + x_offset * 3], (width - x_offset) * 3);
+				}
+			});
 		}
 	}
 }
@@ -66,6 +69,11 @@ void resize::do_resize(const int win, const int hin, const uint8_t *const in, co
 {
 	*out = (uint8_t *)malloc(IMS(wout, hout, 3));
 
+	do_resize(win, hin, in, wout, hout, *out);
+}
+
+void resize::do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out)
+{
 	const double maxw = std::max(win, wout);
 	const double maxh = std::max(hin, hout);
 
@@ -74,23 +82,31 @@ void resize::do_resize(const int win, const int hin, const uint8_t *const in, co
 	const double houts = hout / maxh;
 	const double wouts = wout / maxw;
 
-	for(int y=0; y<maxh; y++) {
-		const int out_scaled_y = y * houts;
-		if (out_scaled_y >= hout)
-			break;
+	run_stripes(int(maxh), 0, [&](const int y_start, const int y_end) {
+		for(int y=y_start; y<y_end; y++) {
+			const int out_scaled_y = y * houts;
+			if (out_scaled_y >= hout)
+				break;
 
-		const int out_scaled_o = out_scaled_y * wout * 3;
+			// when downscaling, only the last input row that maps
+			// to an output row ends up in it; skipping the others
+			// also keeps stripes from writing the same row
+			if (y + 1 < maxh && int((y + 1) * houts) == out_scaled_y)
+				continue;
 
-		const int in_scaled_y = y * hins;
-		const int in_scaled_o = in_scaled_y * win * 3;
+			const int out_scaled_o = out_scaled_y * wout * 3;
 
-		for(int x=0; x<maxw; x++) {
-			int ino = in_scaled_o + int(x * wins) * 3;
-			int outo = out_scaled_o + int(x * wouts) * 3;
+			const int in_scaled_y = y * hins;
+			const int in_scaled_o = in_scaled_y * win * 3;
 
-			(*out)[outo + 0] = in[ino + 0];
-			(*out)[outo + 1] = in[ino + 1];
-			(*out)[outo + 2] = in[ino + 2];
+			for(int x=0; x<maxw; x++) {
+				int ino = in_scaled_o + int(x * wins) * 3;
+				int outo = out_scaled_o + int(x * wouts) * 3;
+
+				out[outo + 0] = in[ino + 0];
+				out[outo + 1] = in[ino + 1];
+				out[outo + 2] = in[ino + 2];
+			}
 		}
-	}
+	});
 }
@@ -12,7 +12,10 @@ public:
 	resize();
 	virtual ~resize();
 
-	virtual void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t **out);
+	// allocates *out (malloc)
+	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t **out);
+	// 'out' must be at least IMS(wout, hout, 3) bytes in size
+	virtual void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out);
 };
 
 void picture_in_picture(resize *const r, uint8_t *const tgt, const int tgt_w, const int tgt_h, const uint8_t *const in, const int win, const int hin, const int perc, const pos_t pos);
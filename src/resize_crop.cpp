@@ -18,11 +18,11 @@ resize_crop::~resize_crop()
 {
 }
 
-void resize_crop::do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t **out)
+void resize_crop::do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out)
 {
 	size_t out_size = IMS(wout, hout, 3);
 
-	*out = (uint8_t *)allocate_0x00(out_size);
+	memset(out, 0x00, out_size);
 
 	if (fill_max) {
 		// resize
@@ -43,8 +43,8 @@ void resize_crop::do_resize(const int win, const int hin, const uint8_t *const i
 			temp_h = hout;
 		}
 
-		uint8_t *temp = nullptr;
-		resize::do_resize(win, hin, in, temp_w, temp_h, &temp);
+		uint8_t *temp = (uint8_t *)malloc(IMS(temp_w, temp_h, 3));
+		resize::do_resize(win, hin, in, temp_w, temp_h, temp);
 
 		// crop
 		int xoffset = resize_crop_center && wout > temp_w ? (wout - temp_w) / 2 : 0;
@@ -53,7 +53,7 @@ void resize_crop::do_resize(const int win, const int hin, const uint8_t *const i
 		int new_width = std::min(temp_w, wout);
 
 		for(int y=0; y<std::min(temp_h, hout); y++)
-			memcpy(&(*out)[(y + yoffset) * wout * 3 + xoffset * 3], &temp[y * temp_w * 3], new_width * 3);
+			memcpy(&out[(y + yoffset) * wout * 3 + xoffset * 3], &temp[y * temp_w * 3], new_width * 3);
 
 		free(temp);
 	}
@@ -64,6 +64,6 @@ void resize_crop::do_resize(const int win, const int hin, const uint8_t *const i
 		int new_width = std::min(win, wout);
 
 		for(int y=0; y<std::min(hin, hout); y++)
-			memcpy(&(*out)[(y + yoffset) * wout * 3 + xoffset * 3], &in[y * win * 3], new_width * 3);
+			memcpy(&out[(y + yoffset) * wout * 3 + xoffset * 3], &in[y * win * 3], new_width * 3);
 	}
 }
@@ -15,5 +15,6 @@ public:
 	resize_crop(const bool resize_crop_center, const bool fill_max);
 	virtual ~resize_crop();
 
-	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t **out) override;
+	using resize::do_resize;
+	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out) override;
 };
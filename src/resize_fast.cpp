@@ -0,0 +1,239 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include "config.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "resize_fast.h"
+#include "log.h"
+#include "worker_pool.h"
+
+constexpr int weight_bits = 14;
+// the vertical pass keeps 8 bits of fraction
+constexpr int vert_shift = weight_bits - 8;
+constexpr int out_shift = weight_bits + 8;
+
+// tables for sizes that are no longer used are dropped at some point
+constexpr size_t max_tables = 64;
+
+resize_fast::resize_fast(const resize_fast_mode_t mode) : mode(mode)
+{
+	log(LL_INFO, "resize_fast (%s) instantiated", mode == resize_fast_area ? "area" : "bilinear");
+}
+
+resize_fast::~resize_fast()
+{
+}
+
+resize_fast::axis_table_t *resize_fast::calc_table(const int n_in, const int n_out) const
+{
+	const double scale = n_in / double(n_out);
+
+	std::vector<std::vector<std::pair<int, double> > > contributions(n_out);
+
+	for(int o=0; o<n_out; o++) {
+		auto & c = contributions.at(o);
+
+		if (mode == resize_fast_area) {
+			// the input pixels covered by this output pixel, weighted
+			// by how much of them is covered
+			const double begin = o * scale, end = begin + scale;
+
+			for(int i=int(begin); i<std::min(int(std::ceil(end)), n_in); i++) {
+				const double covered = std::min(end, i + 1.) - std::max(begin, double(i));
+
+				if (covered > 0.)
+					c.push_back({ i, covered });
+			}
+		}
+		else {
+			const double center = std::max(0., std::min(n_in - 1., (o + 0.5) * scale - 0.5));
+			const int i = std::min(int(center), n_in - 1);
+			const double frac = center - i;
+
+			c.push_back({ i, 1. - frac });
+
+			if (frac > 0. && i + 1 < n_in)
+				c.push_back({ i + 1, frac });
+		}
+	}
+
+	axis_table_t *t = new axis_table_t;
+
+	t->n_taps = 1;
+
+	for(auto & c : contributions)
+		t->n_taps = std::max(t->n_taps, int(c.size()));
+
+	t->start.resize(n_out);
+	t->weights.resize(size_t(n_out) * t->n_taps);
+
+	for(int o=0; o<n_out; o++) {
+		auto & c = contributions.at(o);
+
+		double total = 0.;
+		for(auto & e : c)
+			total += e.second;
+
+		// always n_taps input pixels are read; near the right/bottom
+		// edge the window is moved to the left (with zero weights)
+		int start = c.empty() ? 0 : c.front().first;
+		int pad = std::max(0, start + t->n_taps - n_in);
+		start -= pad;
+
+		t->start.at(o) = start;
+
+		int16_t *w = &t->weights.at(size_t(o) * t->n_taps);
+
+		int sum = 0, biggest = pad;
+
+		for(int k=0; k<int(c.size()); k++) {
+			w[pad + k] = std::lround(c.at(k).second / total * (1 << weight_bits));
+
+			sum += w[pad + k];
+
+			if (w[pad + k] > w[biggest])
+				biggest = pad + k;
+		}
+
+		// rounding: the weights must add up to exactly 1.0
+		w[biggest] += (1 << weight_bits) - sum;
+	}
+
+	return t;
+}
+
+std::shared_ptr<const resize_fast::axis_table_t> resize_fast::get_table(const int n_in, const int n_out)
+{
+	const std::lock_guard<std::mutex> lck(tables_lock);
+
+	auto it = tables.find({ n_in, n_out });
+
+	if (it != tables.end())
+		return it->second;
+
+	if (tables.size() >= max_tables)
+		tables.clear();
+
+	std::shared_ptr<const axis_table_t> t(calc_table(n_in, n_out));
+
+	tables.insert({ { n_in, n_out }, t });
+
+	return t;
+}
+
+// horizontal pass of one row of the vertically resized data (which has 8
+// bits of fraction)
+template <int n_taps>
+static void resize_row(const uint16_t *const __restrict in, const int wout, const int *const __restrict start, const int16_t *const __restrict weights, uint8_t *const __restrict out)
+{
+	for(int x=0; x<wout; x++) {
+		const uint16_t *const p = &in[start[x] * 3];
+		const int16_t *const w = &weights[x * n_taps];
+
+		uint32_t r = 1 << (out_shift - 1), g = r, b = r;
+
+		for(int k=0; k<n_taps; k++) {
+			r += w[k] * p[k * 3 + 0];
+			g += w[k] * p[k * 3 + 1];
+			b += w[k] * p[k * 3 + 2];
+		}
+
+		out[x * 3 + 0] = r >> out_shift;
+		out[x * 3 + 1] = g >> out_shift;
+		out[x * 3 + 2] = b >> out_shift;
+	}
+}
+
+// the number of taps is a compile time constant in the common cases so
+// that the inner loop is unrolled
+static void resize_row(const uint16_t *const in, const int wout, const int n_taps, const int *const start, const int16_t *const weights, uint8_t *const out)
+{
+	switch(n_taps) {
+		case 1:
+			resize_row<1>(in, wout, start, weights, out);
+			break;
+		case 2:
+			resize_row<2>(in, wout, start, weights, out);
+			break;
+		case 3:
+			resize_row<3>(in, wout, start, weights, out);
+			break;
+		case 4:
+			resize_row<4>(in, wout, start, weights, out);
+			break;
+		case 5:
+			resize_row<5>(in, wout, start, weights, out);
+			break;
+		default:
+			for(int x=0; x<wout; x++) {
+				const uint16_t *const p = &in[start[x] * 3];
+				const int16_t *const w = &weights[x * n_taps];
+
+				uint32_t r = 1 << (out_shift - 1), g = r, b = r;
+
+				for(int k=0; k<n_taps; k++) {
+					r += w[k] * p[k * 3 + 0];
+					g += w[k] * p[k * 3 + 1];
+					b += w[k] * p[k * 3 + 2];
+				}
+
+				out[x * 3 + 0] = r >> out_shift;
+				out[x * 3 + 1] = g >> out_shift;
+				out[x * 3 + 2] = b >> out_shift;
+			}
+			break;
+	}
+}
+
+void resize_fast::do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out)
+{
+	if (win == wout && hin == hout) {
+		memcpy(out, in, IMS(win, hin, 3));
+		return;
+	}
+
+	auto tx = get_table(win, wout);
+	auto ty = get_table(hin, hout);
+
+	const int in_stride = win * 3;
+	const int ny = ty->n_taps;
+
+	run_stripes(hout, 0, [&](const int y_start, const int y_end) {
+		// one vertically resized row; kept per thread as this is invoked
+		// for every frame
+		thread_local std::vector<uint32_t> acc;
+		thread_local std::vector<uint16_t> temp;
+
+		acc.resize(in_stride);
+		temp.resize(in_stride);
+
+		uint32_t *const a = acc.data();
+		uint16_t *const t = temp.data();
+
+		for(int y=y_start; y<y_end; y++) {
+			const int start = ty->start[y];
+			const int16_t *const w = &ty->weights[size_t(y) * ny];
+
+			// vertically first: these loops go linearly through (the
+			// full width of) the input rows which lets the compiler
+			// emit SIMD code for them
+			for(int i=0; i<in_stride; i++)
+				a[i] = 1 << (vert_shift - 1);
+
+			for(int k=0; k<ny; k++) {
+				const uint32_t cur_w = w[k];
+				const uint8_t *const src = &in[size_t(start + k) * in_stride];
+
+				for(int i=0; i<in_stride; i++)
+					a[i] += cur_w * src[i];
+			}
+
+			for(int i=0; i<in_stride; i++)
+				t[i] = a[i] >> vert_shift;
+
+			// then horizontally, only for the output rows
+			resize_row(t, wout, tx->n_taps, tx->start.data(), tx->weights.data(), &out[size_t(y) * wout * 3]);
+		}
+	});
+}
@@ -0,0 +1,41 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "resize.h"
+
+typedef enum { resize_fast_area, resize_fast_bilinear } resize_fast_mode_t;
+
+// Separable resizer: first vertically, then horizontally, in fixed
+// point. Which input pixels contribute (and how much) to each output
+// pixel is computed once per (input size, output size) pair and cached.
+class resize_fast : public resize
+{
+private:
+	// for one axis
+	typedef struct {
+		int n_taps;                    // input pixels per output pixel
+		std::vector<int> start;        // first input pixel, per output pixel
+		std::vector<int16_t> weights;  // n_taps per output pixel, sum is 1 << 14
+	} axis_table_t;
+
+	const resize_fast_mode_t mode;
+
+	std::mutex tables_lock;
+	std::map<std::pair<int, int>, std::shared_ptr<const axis_table_t> > tables;
+
+	std::shared_ptr<const axis_table_t> get_table(const int n_in, const int n_out);
+	axis_table_t *calc_table(const int n_in, const int n_out) const;
+
+public:
+	resize_fast(const resize_fast_mode_t mode);
+	virtual ~resize_fast();
+
+	using resize::do_resize;
+	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out) override;
+};
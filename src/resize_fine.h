@@ -10,5 +10,6 @@ public:
 	resize_fine();
 	virtual ~resize_fine();
 
-	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t **out) override;
+	using resize::do_resize;
+	void do_resize(const int win, const int hin, const uint8_t *const in, const int wout, const int hout, uint8_t *const out) override;
 };
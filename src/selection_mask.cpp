@@ -1,5 +1,6 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #include "config.h"
+#include <algorithm>
 #include <stddef.h>
 #include <stdio.h>
 
@@ -7,12 +8,11 @@
 #include "error.h"
 #include "picio.h"
 #include "utils.h"
-#include "resize.h"
 
-selection_mask::selection_mask(resize *const r, const std::string & selection_bitmap) : r(r)
+selection_mask::selection_mask(const std::string & selection_bitmap)
 {
-	cache = pixels = NULL;
-	cw = ch = w = h = -1;
+	block_cache = cache = pixels = NULL;
+	bcw = bch = bc_size = cw = ch = w = h = -1;
 
 #if HAVE_NETPBM == 1
 	std::string ext = "pbm";
@@ -55,6 +55,7 @@ selection_mask::selection_mask(resize *const r, const std::string & selection_bi
 
 selection_mask::~selection_mask()
 {
+	free(block_cache);
 	free(cache);
 	free(pixels);
 }
@@ -69,10 +70,56 @@ uint8_t *selection_mask::get_mask(const int rw, const int rh)
 
 	free(cache);
 
-	r -> do_resize(w, h, pixels, rw, rh, &cache);
+	// nearest neighbour: the mask has one byte per pixel
+	cache = (uint8_t *)malloc(IMS(rw, rh, 1));
+
+	for(int y=0; y<rh; y++) {
+		const uint8_t *const line = &pixels[size_t(y) * h / rh * w];
+
+		for(int x=0; x<rw; x++)
+			cache[y * rw + x] = line[size_t(x) * w / rw];
+	}
 
 	cw = rw;
 	ch = rh;
 
 	return cache;
 }
+
+uint8_t *selection_mask::get_block_mask(const int rw, const int rh, const int block_size)
+{
+	if (rw == bcw && rh == bch && block_size == bc_size)
+		return block_cache;
+
+	const uint8_t *const mask = get_mask(rw, rh);
+
+	const int bw = (rw + block_size - 1) / block_size;
+	const int bh = (rh + block_size - 1) / block_size;
+
+	free(block_cache);
+	block_cache = (uint8_t *)malloc(IMS(bw, bh, 1));
+
+	for(int by=0; by<bh; by++) {
+		for(int bx=0; bx<bw; bx++) {
+			int n = 0, n_set = 0;
+
+			const int y_end = std::min((by + 1) * block_size, rh);
+			const int x_end = std::min((bx + 1) * block_size, rw);
+
+			for(int y=by * block_size; y<y_end; y++) {
+				for(int x=bx * block_size; x<x_end; x++) {
+					n++;
+					n_set += mask[y * rw + x] != 0;
+				}
+			}
+
+			block_cache[by * bw + bx] = n_set * 2 >= n;
+		}
+	}
+
+	bcw = rw;
+	bch = rh;
+	bc_size = block_size;
+
+	return block_cache;
+}
@@ -4,22 +4,25 @@
 #include <stdint.h>
 #include <string>
 
-class resize;
-
 class selection_mask
 {
 private:
-	resize *const r;
-
 	uint8_t *pixels;
 	int w, h;
 
 	uint8_t *cache;
 	int cw, ch;
 
+	uint8_t *block_cache;
+	int bcw, bch, bc_size;
+
 public:
-	selection_mask(resize *const r, const std::string & file);
+	selection_mask(const std::string & file);
 	virtual ~selection_mask();
 
+	// one byte per pixel (0 or 1), scaled to rw x rh
 	uint8_t *get_mask(const int rw, const int rh);
+	// one byte per block of block_size x block_size pixels of the mask at
+	// rw x rh: set when at least half of its pixels are
+	uint8_t *get_block_mask(const int rw, const int rh, const int block_size);
 };
@@ -14,6 +14,8 @@
 #include "log.h"
 #include "utils.h"
 #include "exec.h"
+#include "frame_pool.h"
+#include "jpeg_cache.h"
 #include "draw.h"
 #include "draw_text.h"
 #include "filter_add_text.h"
@@ -47,8 +49,6 @@ source::source(const std::string & id, const std::string & descr, const std::str
 
 source::~source()
 {
-	delete vf;
-
 	free_filters(filters);
 
 	free(failure_bitmap);
@@ -64,10 +64,12 @@ source::~source()
 
 void source::init()
 {
-	vf = nullptr;
 	user_count = 0;
 	ct = CT_SOURCE;
 
+	pool = std::make_shared<frame_pool>();
+	jcache = std::make_shared<jpeg_cache>();
+
 	font = new draw_text("", 32);
 
 	if (!failure.bg_bitmap.empty()) {
@@ -109,29 +111,45 @@ void source::do_exec_failure()
 // frame did not change but trigger an event nevertheless
 void source::fake_frame()
 {
-	std::unique_lock<std::mutex> lck(lock);
-	if (vf)
-		vf->update_ts();
-        cond.notify_all();
-        lck.unlock();
+	auto cur = slot.get();
+
+	if (cur) {
+		// consumers may be using the current frame: publish a copy
+		// (shares the pixels) with a new timestamp
+		video_frame *copy = cur->duplicate({ });
+		copy->update_ts();
+
+		slot.publish(copy);
+	}
 }
 
 void source::set_frame(const encoding_t pe, const uint8_t *const data, const size_t size, const bool do_duplicate)
 {
-	uint64_t use_ts = get_us();
+	std::shared_ptr<uint8_t> copy;
 
-	st->track_fps();
+	if (do_duplicate) {
+		copy = pool->allocate(size);
+		memcpy(copy.get(), data, size);
+	}
+	else {
+		copy = std::shared_ptr<uint8_t>((uint8_t *)data, free);
+	}
 
-	uint8_t *copy = (uint8_t *)(do_duplicate ? duplicate(data, size) : data);
+	set_frame(pe, copy, size);
+}
 
-	std::unique_lock<std::mutex> lck(lock);
+void source::set_frame(const encoding_t pe, const std::shared_ptr<uint8_t> & data, const size_t size, const bool lent)
+{
+	uint64_t use_ts = get_us();
 
-	delete vf;
-	vf = new video_frame(get_meta(), jpeg_quality, use_ts, width, height, copy, size, pe);
+	st->track_fps();
 
-	cond.notify_all();
+	video_frame *vf = new video_frame(get_meta(), jpeg_quality, use_ts, width, height, data, size, pe, pool, jcache);
 
-	lck.unlock();
+	if (lent)
+		vf->set_lent(pe);
+
+	publish_frame(vf);
 }
 
 void source::set_scaled_frame(const uint8_t *const in, const int sourcew, const int sourceh, const bool keep_aspectratio)
@@ -141,189 +159,142 @@ void source::set_scaled_frame(const uint8_t *const in, const int sourcew, const
         int target_w = resize_w != -1 ? resize_w : sourcew;
         int target_h = resize_h != -1 ? resize_h : sourceh;
 
-        uint8_t *out = nullptr;
+	const size_t n_bytes = IMS(target_w, target_h, 3);
+
+	auto out = pool->allocate(n_bytes);
 
 	if (keep_aspectratio) {
-		out = reinterpret_cast<uint8_t *>(malloc(target_w * target_h * 3));
+		// buffers are recycled: clear the borders
+		memset(out.get(), 0x00, n_bytes);
 
 		int perc = std::min(sourcew * 100 / resize_w, sourceh * 100 / resize_h);
 
 		pos_t pos { center_center, 0, 0 };
 
-		picture_in_picture(r, out, target_w, target_h, in, sourcew, sourceh, perc, pos);
+		picture_in_picture(r, out.get(), target_w, target_h, in, sourcew, sourceh, perc, pos);
 	}
 	else {
-		r -> do_resize(sourcew, sourceh, in, target_w, target_h, &out);
+		r -> do_resize(sourcew, sourceh, in, target_w, target_h, out.get());
 	}
 
-	std::unique_lock<std::mutex> lck(lock);
-
-	delete vf;
-	vf = new video_frame(get_meta(), jpeg_quality, use_ts, target_w, target_h, out, IMS(target_w, target_h, 3), E_RGB);
-
-	lck.unlock();
-
-	cond.notify_all();
+	publish_frame(new video_frame(get_meta(), jpeg_quality, use_ts, target_w, target_h, out, n_bytes, E_RGB, pool, jcache));
 }
 
-video_frame * source::get_frame(const bool handle_failure, const uint64_t after)
+void source::publish_frame(video_frame *const new_vf)
 {
-	bool err = false;
+	const uint64_t now = new_vf->get_ts();
+	const uint64_t captured = capture_ts.exchange(0);
 
-	std::unique_lock<std::mutex> lck(lock);
-
-	uint64_t stop_at = get_us() + timeout * 1000000;
-	int64_t to = 0;
+	new_vf->set_stage_ts(FS_CAPTURED, captured ? captured : now);
 
-	while(!vf || vf->get_ts() <= after) {
-		to = stop_at - get_us();
+	// JPEGs are decoded when (and if) a consumer needs the pixels
+	if (!new_vf->has_only(E_JPEG))
+		new_vf->set_stage_ts(FS_DECODED, now);
 
-		if (to <= 0) {
-			err = true;
-			break;
-		}
+	// run the filters once here instead of for each consumer in get_frame()
+	if (filter_on_capture && filtering_required()) {
+		filter_frame(new_vf);
 
-		if (cond.wait_for(lck, std::chrono::microseconds(to)) == std::cv_status::timeout) {
-			err = true;
-			break;
-		}
+		// the filtered frame is what all consumers get so its
+		// JPEG can be shared again
+		new_vf->set_jpeg_cache(jcache);
 	}
 
-	if (err) {
-fail:
-		uint64_t use_ts = vf ? vf->get_ts() : 0;
-
-		lck.unlock();
-
-		log(id, LL_DEBUG, "v-frame fail err %d pvf %p | to % " PRId64 ", ts %" PRIu64 " reqts %" PRIu64 " > tdiff %" PRId64 " | timeout %f", err, vf, to, use_ts, after, use_ts - after, timeout);
-
-		do_exec_failure();
-
-		if (handle_failure && failure.fm != F_NOTHING)
-			return get_failure_frame();
+	new_vf->report_latency(st);
 
-		return nullptr;
-	}
+	slot.publish(new_vf);
+}
 
+bool source::filtering_required()
+{
 	std::shared_lock clck(controls_lock);
 	bool need_controls_apply = c && c->requires_apply();
 	clck.unlock();
 
-	bool need_filters = filters && !filters->empty();
-
-	if (need_controls_apply || need_filters) {
-		uint8_t *work = vf->get_data(E_RGB);
-		uint64_t vf_ts = vf->get_ts();
-
-		size_t n_bytes = IMS(vf->get_w(), vf->get_h(), 3);
-
-		uint8_t *copy = (uint8_t *)duplicate(work, n_bytes);
+	return need_controls_apply || (filters && !filters->empty());
+}
 
-		lck.unlock();
+// applies the filters and controls of this source to 'f' (in-place)
+void source::filter_frame(video_frame *const f)
+{
+	// copy-on-write: this is where the pixels get copied (if shared)
+	uint8_t *work = f->get_data_writable(E_RGB);
+	if (!work) {
+		log(id, LL_WARNING, "no pixels to filter");
+		return;
+	}
 
-		if (need_filters) {
-			std::lock_guard<std::mutex> pflck(prev_frame_rgb_lock);
+	auto [ w, h ] = f->get_wh();
+	size_t n_bytes = IMS(w, h, 3);
 
-			apply_filters(nullptr, this, filters, prev_frame_rgb, copy, vf_ts, vf->get_w(), vf->get_h());
+	if (filters && !filters->empty()) {
+		std::lock_guard<std::mutex> pflck(prev_frame_rgb_lock);
 
-			if (!prev_frame_rgb)
-				prev_frame_rgb = (uint8_t *)malloc(n_bytes);
+		apply_filters(nullptr, this, filters, prev_frame_rgb, work, f->get_ts(), w, h);
 
-			memcpy(prev_frame_rgb, copy, n_bytes);
-		}
+		if (!prev_frame_rgb)
+			prev_frame_rgb = (uint8_t *)malloc(n_bytes);
 
-		if (need_controls_apply) {
-			std::shared_lock clck(controls_lock);
+		memcpy(prev_frame_rgb, work, n_bytes);
+	}
 
-			c->apply(copy, vf->get_w(), vf->get_h());
-		}
+	std::shared_lock clck(controls_lock);
 
-		return new video_frame(get_meta(), jpeg_quality, vf->get_ts(), vf->get_w(), vf->get_h(), copy, n_bytes, E_RGB);
-	}
+	if (c && c->requires_apply())
+		c->apply(work, w, h);
 
-	return vf->duplicate({ });
+	f->set_stage_ts(FS_FILTERED, get_us());
 }
 
-video_frame * source::get_frame_to(const bool handle_failure, const uint64_t after, const uint64_t us)
+video_frame * source::get_frame(const bool handle_failure, const uint64_t after)
 {
-	std::unique_lock<std::mutex> lck(lock);
+	auto cur = slot.wait_for(after, timeout * 1000000);
 
-	bool     no_frame = false;
+	if (!cur) {
+		uint64_t use_ts = slot.get_ts();
 
-	uint64_t stop_at = get_us() + us;
-	int64_t  to = 0;
+		log(id, LL_DEBUG, "v-frame fail | ts %" PRIu64 " reqts %" PRIu64 " > tdiff %" PRId64 " | timeout %f", use_ts, after, use_ts - after, timeout);
 
-	while(!vf || vf->get_ts() <= after) {
-		to = stop_at - get_us();
+		do_exec_failure();
 
-		if (to <= 0 || cond.wait_for(lck, std::chrono::microseconds(to)) == std::cv_status::timeout) {
-			no_frame = true;
-			break;
-		}
-	}
+		if (handle_failure && failure.fm != F_NOTHING)
+			return get_failure_frame();
 
-	if (no_frame)
 		return nullptr;
+	}
 
-	std::shared_lock clck(controls_lock);
-	bool need_controls_apply = c && c->requires_apply();
-	clck.unlock();
-
-	bool need_filters = filters && !filters->empty();
-
-	if (need_controls_apply || need_filters) {
-		uint8_t *work = vf->get_data(E_RGB);
-		uint64_t vf_ts = vf->get_ts();
-
-		size_t n_bytes = IMS(vf->get_w(), vf->get_h(), 3);
-
-		uint8_t *copy = (uint8_t *)duplicate(work, n_bytes);
-
-		lck.unlock();
-
-		if (need_filters) {
-			std::lock_guard<std::mutex> pflck(prev_frame_rgb_lock);
+	return consumer_frame(cur);
+}
 
-			apply_filters(nullptr, this, filters, prev_frame_rgb, copy, vf_ts, vf->get_w(), vf->get_h());
+video_frame * source::get_frame_to(const bool handle_failure, const uint64_t after, const uint64_t us)
+{
+	auto cur = slot.wait_for(after, us);
 
-			if (!prev_frame_rgb)
-				prev_frame_rgb = (uint8_t *)malloc(n_bytes);
+	if (!cur)
+		return nullptr;
 
-			memcpy(prev_frame_rgb, copy, n_bytes);
-		}
+	return consumer_frame(cur);
+}
 
-		if (need_controls_apply) {
-			std::shared_lock clck(controls_lock);
+// the published frame is shared by all consumers and never modified: they
+// get a (copy-on-write) duplicate of it
+video_frame * source::consumer_frame(const std::shared_ptr<video_frame> & cur)
+{
+	// when filtering on capture, cur is already filtered
+	if (!filter_on_capture && filtering_required()) {
+		video_frame *out = cur->duplicate(E_RGB);
 
-			c->apply(copy, vf->get_w(), vf->get_h());
-		}
+		filter_frame(out);
 
-		return new video_frame(get_meta(), jpeg_quality, vf->get_ts(), vf->get_w(), vf->get_h(), copy, n_bytes, E_RGB);
+		return out;
 	}
 
-	return vf->duplicate({ });
+	return cur->duplicate({ });
 }
 
 bool source::wait_for_meta()
 {
-	bool err = false;
-
-	std::unique_lock<std::mutex> lck(lock);
-
-	uint64_t stop_at = get_us() + timeout * 1000000;
-
-	while(!vf || vf->get_ts() == 0) {
-		int64_t to = stop_at - get_us();
-
-		if (to <= 0 || cond.wait_for(lck, std::chrono::microseconds(to)) == std::cv_status::timeout) {
-			err = true;
-			break;
-		}
-	}
-
-	// lck/lock is now locked but will be auto-unlocked
-
-	return !err;
+	return slot.wait_for_first(timeout * 1000000);
 }
 
 int btr(const int v, const int r)
@@ -474,9 +445,7 @@ video_frame * source::get_failure_frame()
 
 uint64_t source::get_current_ts() const
 {
-	const std::lock_guard<std::mutex> lck(lock);
-
-	return vf ? vf->get_ts() : 0;
+	return slot.get_ts();
 }
 
 void source::pan_tilt(const double abs_pan, const double abs_tilt)
@@ -513,9 +482,7 @@ void source::start_watchdog(const double restart_interval)
 				std::unique_lock<std::mutex> th_lck(th_lock);
 
 				if (th) {
-					std::unique_lock<std::mutex> vf_lck(lock);
-					uint64_t vf_ts = vf ? vf->get_ts() : 0;
-					vf_lck.unlock();
+					uint64_t vf_ts = slot.get_ts();
 
 					if (now - vf_ts > restart_interval * 1000000) {
 						th_lck.unlock();
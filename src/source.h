@@ -2,6 +2,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <optional>
 #include <shared_mutex>
 #include <stdint.h>
@@ -12,12 +13,15 @@
 #include "error.h"
 #include "gen.h"
 #include "failure.h"
+#include "frame_slot.h"
 #include "picio.h"
 
 class audio;
 class controls;
 class feed;
 class filter;
+class frame_pool;
+class jpeg_cache;
 class ptz;
 class resize;
 
@@ -34,16 +38,23 @@ protected:
 	const std::string exec_failure;
 	const int jpeg_quality;
 
-	std::condition_variable cond;
         mutable std::mutex lock;
 
-	video_frame *vf { nullptr };
+	frame_slot slot;
+
+	std::shared_ptr<frame_pool> pool;
+	std::shared_ptr<jpeg_cache> jcache;
 
 	mutable std::mutex prev_frame_rgb_lock;
 	uint8_t *prev_frame_rgb{ nullptr };
 
 	std::atomic_int user_count;
 
+	bool filter_on_capture { false };
+
+	// when the frame that is set next was received (0: when it is set)
+	std::atomic_uint64_t capture_ts { 0 };
+
 	failure_t failure;
 	uint8_t *failure_bitmap{ nullptr };
 	int f_w{ -1 }, f_h{ -1 };
@@ -71,6 +82,10 @@ protected:
 
 	void init();
 	bool need_scale() const;
+	void publish_frame(video_frame *const new_vf);
+	video_frame * consumer_frame(const std::shared_ptr<video_frame> & cur);
+	bool filtering_required();
+	void filter_frame(video_frame *const f);
 
 public:
 	source(const std::string & id, const std::string & descr, const std::string & exec_failure, const double max_fps, resize *const r, const int resize_w, const int resize_h, const int loglevel, const double timeout, std::vector<filter *> *const filters, const failure_t & failure, controls *const c, const int jpeg_quality, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio);
@@ -80,7 +95,11 @@ public:
 	virtual video_frame * get_frame_to(const bool handle_failure, const uint64_t after, const uint64_t us);
 	virtual video_frame * get_failure_frame();
 	void set_frame(const encoding_t pe, const uint8_t *const data, const size_t size, const bool do_duplicate = true);
+	// no copy; 'lent' when 'data' is a capture buffer that must go back to
+	// the driver (zero-copy), see video_frame::own_data()
+	void set_frame(const encoding_t pe, const std::shared_ptr<uint8_t> & data, const size_t size, const bool lent = false);
 	void set_scaled_frame(const uint8_t *const in, const int sourcew, const int sourceh, const bool keep_aspectratio);
+	void set_capture_ts(const uint64_t ts) { capture_ts = ts; }
 	void set_size(const int w, const int h);
 	void fake_frame();
 
@@ -100,6 +119,12 @@ public:
 
 	controls *get_controls() { return c; }
 
+	std::shared_ptr<frame_pool> get_frame_pool() const { return pool; }
+	std::shared_ptr<jpeg_cache> get_jpeg_cache() const { return jcache; }
+
+	// apply filters once per captured frame instead of per get_frame()
+	void set_filter_on_capture(const bool v) { filter_on_capture = v; }
+
 	void set_audio(audio *a) { this->a = a; }
 	audio *get_audio() { return a; }
 
@@ -36,6 +36,9 @@ void source_delay::operator()()
 		video_frame *f = s -> get_frame(true, start_ts);
 
 		if (f) {
+			// kept for the length of the delay
+			f->own_data();
+
 			std::lock_guard lck(frames_lock);
 
 			while(frames.size() >= n_frames) {
@@ -94,7 +97,7 @@ video_frame * source_delay::get_frame(const bool handle_failure, const uint64_t
 		lck.unlock();
 
 		if (c != nullptr && c->requires_apply()) {
-			c->apply(vf->get_data(E_RGB), vf->get_w(), vf->get_h());
+			c->apply(vf->get_data_writable(E_RGB), vf->get_w(), vf->get_h());
 			vf->keep_only_format(E_RGB);
 		}
 	}
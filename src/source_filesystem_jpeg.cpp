@@ -95,7 +95,7 @@ void source_filesystem_jpeg::operator()()
 				unsigned char *temp = NULL;
 				int dw = -1, dh = -1;
 				if (first || resize) {
-					if (!my_jpeg.read_JPEG_memory(work, work_len, &dw, &dh, &temp)) {
+					if (!my_jpeg.read_JPEG_memory(work, work_len, &dw, &dh, &temp, resize_w, resize_h)) {
 						// this may happen if the file is still being copied
 						// should look into 'inotify' to prevent this from
 						// happening
@@ -56,13 +56,15 @@ void source_http_jpeg::operator()()
 
 			st->track_bw(work_len);
 
+			set_capture_ts(get_us());
+
 			backoff = 101000;
 
 			if (!is_paused()) {
 				unsigned char *temp = NULL;
 				int dw = -1, dh = -1;
 				if (first || resize) {
-					if (!my_jpeg.read_JPEG_memory(work, work_len, &dw, &dh, &temp)) {
+					if (!my_jpeg.read_JPEG_memory(work, work_len, &dw, &dh, &temp, resize_w, resize_h)) {
 						set_error("JPEG decode error", false);
 						continue;
 					}
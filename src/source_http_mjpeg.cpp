@@ -235,11 +235,13 @@ process:
 		}
 
 		if (w -> s -> work_required() && do_get && !w -> s -> is_paused()) {
+			w -> s -> set_capture_ts(now_ts);
+
 			if (w -> resize_w != -1 || w -> resize_h != -1) {
 				int dw, dh;
 				unsigned char *temp = NULL;
 				if (w->headers->content_type == "image/jpeg") {
-					if (w -> j -> read_JPEG_memory(w -> data, w -> req_len, &dw, &dh, &temp))
+					if (w -> j -> read_JPEG_memory(w -> data, w -> req_len, &dw, &dh, &temp, w -> resize_w, w -> resize_h))
 						w -> s -> set_scaled_frame(temp, dw, dh, w->keep_aspectratio);
 				}
 				else {
@@ -16,15 +16,17 @@
 
 void source_other::crop(video_frame *const in, video_frame **const out, const cut_t & cut)
 {
-	auto data = in->get_data_and_len(E_RGB);
+	*out = in->do_crop(cut.x, cut.y, cut.w, cut.h);
+}
 
-	size_t bytes = cut.w * cut.h * 3;
-	uint8_t *temp = (uint8_t *)malloc(bytes);
+// frames that are (still) only a JPEG are passed on as such
+void source_other::forward(video_frame *const f)
+{
+	const encoding_t e = f->has_only(E_JPEG) ? E_JPEG : E_RGB;
 
-	for(int y=0; y<cut.h; y++)
-		memcpy(&temp[y * cut.w * 3], &std::get<0>(data)[y * in->get_w() * 3 + cut.x * 3], cut.w * 3);
+	auto data = f->get_data_and_len(e);
 
-	*out = new video_frame(get_meta(), jpeg_quality, in->get_ts(), cut.w, cut.h, temp, bytes, E_RGB);
+	set_frame(e, std::get<0>(data), std::get<1>(data));
 }
 
 source_other::source_other(const std::string & id, const std::string & descr, source *const other, const std::string & exec_failure, const int loglevel, std::vector<filter *> *const filters, const failure_t & failure, controls *const c, const int jpeg_quality, resize *const r, const int resize_w, const int resize_h, const std::optional<cut_t> & cut, const int angle, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio) : source(id, descr, exec_failure, -1, r, resize_w, resize_h, loglevel, 86400, filters, failure, c, jpeg_quality, text_feeds, keep_aspectratio), other(other), cut(cut), rotation_angle(angle)
@@ -74,21 +76,17 @@ void source_other::operator()()
 
 					set_size(vf_new->get_w(), vf_new->get_h());
 
-					auto data = vf_new->get_data_and_len(E_RGB);
-
-					set_frame(E_RGB, std::get<0>(data), std::get<1>(data));
+					forward(vf_new);
 
 					delete vf_new;
 				}
 				else {
-					auto data = vf->get_data_and_len(E_RGB);
-
 					set_size(vf->get_w(), vf->get_h());
 
 					if (resize_w != -1 && resize_h != -1)
-						set_scaled_frame(std::get<0>(data), vf->get_w(), vf->get_h(), keep_aspectratio);
+						set_scaled_frame(vf->get_data(E_RGB), vf->get_w(), vf->get_h(), keep_aspectratio);
 					else
-						set_frame(E_RGB, std::get<0>(data), std::get<1>(data));
+						forward(vf);
 				}
 			}
 
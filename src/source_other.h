@@ -21,6 +21,7 @@ private:
 	const int                  rotation_angle;
 
 	void crop(video_frame *const in, video_frame **const out, const cut_t & cut);
+	void forward(video_frame *const f);
 
 public:
 	source_other(const std::string & id, const std::string & descr, source *const other, const std::string & exec_failure, const int loglevel, std::vector<filter *> *const filters, const failure_t & failure, controls *const c, const int jpeg_quality, resize *const r, const int resize_w, const int resize_h, const std::optional<cut_t> & cut, const int rotate, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio);
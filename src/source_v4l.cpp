@@ -2,6 +2,7 @@
 // some code from https://01.org/linuxgraphics/gfx-docs/drm/media/uapi/v4l/v4l2grab.c.html
 #include "config.h"
 #if HAVE_LIBV4L2 == 1
+#include <algorithm>
 #include <fcntl.h>
 #include <libv4l2.h>
 #include <math.h>
@@ -13,6 +14,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 
+#include "encoding.h"
 #include "error.h"
 #include "source.h"
 #include "source_v4l.h"
@@ -38,7 +40,7 @@ static bool xioctl(int fh, long unsigned int request, void *arg, const char *con
 	return true;
 }
 
-source_v4l::source_v4l(const std::string & id, const std::string & descr, const std::string & exec_failure, const std::string & dev, const int jpeg_quality, const double max_fps, const int w_override, const int h_override, resize *const r, const int resize_w, const int resize_h, const int loglevel, const double timeout, std::vector<filter *> *const filters, const failure_t & failure, const bool prefer_jpeg, const bool use_controls, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio) : source(id, descr, exec_failure, max_fps, r, resize_w, resize_h, loglevel, timeout, filters, failure, nullptr, jpeg_quality, text_feeds, keep_aspectratio), dev(dev), prefer_jpeg(prefer_jpeg), w_override(w_override), h_override(h_override), use_controls(use_controls)
+source_v4l::source_v4l(const std::string & id, const std::string & descr, const std::string & exec_failure, const std::string & dev, const int jpeg_quality, const double max_fps, const int w_override, const int h_override, resize *const r, const int resize_w, const int resize_h, const int loglevel, const double timeout, std::vector<filter *> *const filters, const failure_t & failure, const bool prefer_jpeg, const std::string & pixel_format, const int n_buffers_requested, const bool zero_copy, const bool use_controls, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio) : source(id, descr, exec_failure, max_fps, r, resize_w, resize_h, loglevel, timeout, filters, failure, nullptr, jpeg_quality, text_feeds, keep_aspectratio), dev(dev), prefer_jpeg(prefer_jpeg), pixel_format(pixel_format), n_buffers_requested(n_buffers_requested), zero_copy(zero_copy), w_override(w_override), h_override(h_override), use_controls(use_controls)
 {
 	fd = -1;
 	vw = vh = -1;
@@ -51,6 +53,75 @@ source_v4l::~source_v4l()
 	stop();
 }
 
+// zero-copy: a video_frame is only given a buffer when at least this
+// many stay queued at the driver, else the data is copied
+constexpr int min_queued = 2;
+
+void source_v4l::requeue_returned()
+{
+	std::vector<int> indexes;
+
+	std::unique_lock<std::mutex> lck(ring->lock);
+	indexes.swap(ring->returned);
+	lck.unlock();
+
+	for(int index : indexes) {
+		struct v4l2_buffer buf { 0 };
+		buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index  = index;
+
+		if (v4l2_ioctl(fd, VIDIOC_QBUF, &buf) == -1)
+			log(id, LL_WARNING, "ioctl(VIDIOC_QBUF) for returned buffer %d failed: %s", index, strerror(errno));
+	}
+}
+
+// publishes the mmap buffer itself instead of a copy; it is queued again
+// (by the capture thread) when the last video_frame using it is gone
+bool source_v4l::hand_off(const int index, const encoding_t e, const size_t n)
+{
+	std::unique_lock<std::mutex> lck(ring->lock);
+
+	if (n_buffers - ring->n_out - 1 < min_queued)
+		return false;
+
+	ring->out[index] = true;
+	ring->n_out++;
+
+	lck.unlock();
+
+	auto r = ring;
+
+	std::shared_ptr<uint8_t> data(static_cast<uint8_t *>(buffers[index].start), [r, index](uint8_t *) {
+			const std::lock_guard<std::mutex> lck(r->lock);
+
+			r->out[index] = false;
+			r->n_out--;
+
+			r->returned.push_back(index);
+		});
+
+	set_frame(e, data, n, true);
+
+	last_hand_off = { index, e, n };
+
+	return true;
+}
+
+// a format that libv4l converts to: its buffers are those of libv4l
+static bool is_emulated(const int fd, const unsigned int pixelformat)
+{
+	struct v4l2_fmtdesc fmtdesc { 0 };
+	fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	for(; v4l2_ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc) == 0; fmtdesc.index++) {
+		if (fmtdesc.pixelformat == pixelformat)
+			return fmtdesc.flags & V4L2_FMT_FLAG_EMULATED;
+	}
+
+	return false;
+}
+
 bool try_format(int fd, struct v4l2_format *const fmt, int codec)
 {
 	fmt->fmt.pix.pixelformat = codec;
@@ -83,18 +154,21 @@ void source_v4l::operator()()
         fmt.fmt.pix.width       = w_override;
         fmt.fmt.pix.height      = h_override;
 
-	if (prefer_jpeg) {
-		if (try_format(fd, &fmt, V4L2_PIX_FMT_JPEG))
-			log(id, LL_INFO, "JPEG codec chosen");
-		else if (try_format(fd, &fmt, V4L2_PIX_FMT_MJPEG))
-			log(id, LL_INFO, "MJPEG codec chosen");
-		else {
-			log(id, LL_INFO, "Cannot use (M)JPEG mode, using RGB24 instead");
-			fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB24;
-			xioctl(fd, VIDIOC_S_FMT, &fmt, "VIDIOC_S_FMT");
-		}
-	}
+	// YUYV and NV12 are what most cameras produce natively; RGB24 is
+	// converted by libv4l
+	const unsigned int native_format = pixel_format == "YUYV" ? V4L2_PIX_FMT_YUYV : (pixel_format == "NV12" ? V4L2_PIX_FMT_NV12 : 0);
+
+	if (prefer_jpeg && try_format(fd, &fmt, V4L2_PIX_FMT_JPEG))
+		log(id, LL_INFO, "JPEG codec chosen");
+	else if (prefer_jpeg && try_format(fd, &fmt, V4L2_PIX_FMT_MJPEG))
+		log(id, LL_INFO, "MJPEG codec chosen");
+	// the chroma of YUYV/NV12 is per 2 pixels: odd widths are not supported
+	else if (native_format && try_format(fd, &fmt, native_format) && fmt.fmt.pix.width % 2 == 0)
+		log(id, LL_INFO, "%s pixel format chosen", pixel_format.c_str());
 	else {
+		if (prefer_jpeg || native_format)
+			log(id, LL_INFO, "Cannot use %s mode, using RGB24 instead", prefer_jpeg ? "(M)JPEG" : pixel_format.c_str());
+
 		fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB24;
 		xioctl(fd, VIDIOC_S_FMT, &fmt, "VIDIOC_S_FMT");
 	}
@@ -111,11 +185,32 @@ void source_v4l::operator()()
 
 	pixelformat = fmt.fmt.pix.pixelformat;
 
+	const int bytes_per_line = fmt.fmt.pix.bytesperline;
+
+	// libv4l frees its conversion buffers in v4l2_close(), frames may
+	// still use them then
+	bool use_zero_copy = zero_copy;
+
+	if (use_zero_copy && is_emulated(fd, pixelformat)) {
+		log(id, LL_INFO, "zero-copy is not used for a pixel format converted by libv4l");
+		use_zero_copy = false;
+	}
+	// the UV plane of NV12 follows the Y plane, which may have padding lines
+	// (e.g. a height rounded up to a multiple of 16): then sizeimage is
+	// 1.5 times that height
+	size_t uv_offset = size_t(bytes_per_line) * height;
+	if (pixelformat == V4L2_PIX_FMT_NV12 && bytes_per_line > 0 && fmt.fmt.pix.sizeimage % bytes_per_line == 0) {
+		const size_t n_lines = fmt.fmt.pix.sizeimage / bytes_per_line;
+
+		if (n_lines % 3 == 0 && n_lines / 3 * 2 > size_t(height))
+			uv_offset = n_lines / 3 * 2 * bytes_per_line;
+	}
+
 	v4l2_jpegcompression ctrl{ jpeg_quality };
         ioctl(fd, VIDIOC_G_JPEGCOMP, &ctrl);
 
 	memset(&req, 0x00, sizeof req);
-        req.count = 2;
+        req.count = n_buffers_requested;
         req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         req.memory = V4L2_MEMORY_MMAP;
         xioctl(fd, VIDIOC_REQBUFS, &req, "VIDIOC_REQBUFS");
@@ -143,6 +238,14 @@ void source_v4l::operator()()
         }
 
 	log(id, LL_INFO, "v4l: n_buffers: %d", n_buffers);
+
+	ring = std::make_shared<mmap_ring>();
+	ring->out.resize(n_buffers);
+
+	last_hand_off = { -1, E_RGB, 0 };
+
+	if (use_zero_copy && n_buffers <= min_queued)
+		log(id, LL_WARNING, "zero-copy requires more than %d buffers (buffer-count), frames will be copied", min_queued);
         for (int i = 0; !fail && i < n_buffers; ++i) {
                 memset(&buf, 0x00, sizeof(buf));
                 buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -173,8 +276,10 @@ void source_v4l::operator()()
 		this->c = new controls_v4l(fd);
 	controls_lock.unlock();
 
-	int bytes = vw * vh * 3;
-	unsigned char *conv_buffer = static_cast<unsigned char *>(malloc(bytes));
+	// for YUYV/NV12 frames with padding at the end of the lines
+	unsigned char *conv_buffer = static_cast<unsigned char *>(malloc(std::max(size_t(vw) * vh * 2, yuv420_size(vw, vh))));
+	// NV12 to RGB (for scaling)
+	unsigned char *rgb_buffer = nullptr;
 
 	const uint64_t interval = max_fps > 0.0 ? 1.0 / max_fps * 1000.0 * 1000.0 : 0;
 
@@ -183,6 +288,8 @@ void source_v4l::operator()()
 	for(;!fail && !local_stop_flag;) {
 		uint64_t start_ts = get_us();
 
+		requeue_returned();
+
 		fds[0].revents = 0;
 		if (poll(fds, 1, 100) == 0)
 			continue;
@@ -197,6 +304,10 @@ void source_v4l::operator()()
 			break;
 		}
 
+		set_capture_ts(get_us());
+
+		bool handed_off = false;
+
 		if (work_required() && !is_paused()) {
 			unsigned char *io_buffer = (unsigned char *)buffers[buf.index].start;
 
@@ -206,29 +317,82 @@ void source_v4l::operator()()
 				if (resize_h != -1 || resize_w != -1) {
 					int dw = -1, dh = -1;
 					unsigned char *temp = NULL;
-					if (my_jpeg.read_JPEG_memory(io_buffer, cur_n_bytes, &dw, &dh, &temp))
+					if (my_jpeg.read_JPEG_memory(io_buffer, cur_n_bytes, &dw, &dh, &temp, resize_w, resize_h))
 						set_scaled_frame(temp, dw, dh, keep_aspectratio);
 					free(temp);
 				}
+				else if (use_zero_copy && hand_off(buf.index, E_JPEG, cur_n_bytes)) {
+					handed_off = true;
+				}
 				else {
 					set_frame(E_JPEG, io_buffer, cur_n_bytes);
 				}
 			}
+			else if (pixelformat == V4L2_PIX_FMT_YUYV || pixelformat == V4L2_PIX_FMT_NV12) {
+				const bool is_yuyv = pixelformat == V4L2_PIX_FMT_YUYV;
+				const int line_bytes = is_yuyv ? vw * 2 : vw;
+				const size_t n = is_yuyv ? size_t(vw) * vh * 2 : yuv420_size(vw, vh);
+
+				const unsigned char *frame = io_buffer;
+
+				if (bytes_per_line > line_bytes || (!is_yuyv && uv_offset != size_t(vw) * vh)) {
+					for(int y=0; y<vh; y++)
+						memcpy(&conv_buffer[size_t(y) * line_bytes], &io_buffer[size_t(y) * bytes_per_line], line_bytes);
+
+					// the UV plane has half the lines, of the same width
+					// as a Y line (the width is even)
+					if (!is_yuyv) {
+						for(int y=0; y<(vh + 1) / 2; y++)
+							memcpy(&conv_buffer[size_t(vw) * vh + size_t(y) * vw], &io_buffer[uv_offset + size_t(y) * bytes_per_line], vw);
+					}
+
+					frame = conv_buffer;
+				}
+
+				if (need_scale()) {
+					if (is_yuyv) {
+						unsigned char *rgb = nullptr;
+						yuy2_to_rgb(frame, vw, vh, &rgb);
+
+						set_scaled_frame(rgb, vw, vh, keep_aspectratio);
+
+						free(rgb);
+					}
+					else {
+						if (!rgb_buffer)
+							rgb_buffer = static_cast<unsigned char *>(malloc(IMS(vw, vh, 3)));
+
+						nv12_to_rgb(frame, vw, vh, rgb_buffer);
+
+						set_scaled_frame(rgb_buffer, vw, vh, keep_aspectratio);
+					}
+				}
+				else {
+					const encoding_t e = is_yuyv ? E_YUYV : E_NV12;
+
+					// converted when a consumer wants something else
+					if (use_zero_copy && frame == io_buffer && hand_off(buf.index, e, n))
+						handed_off = true;
+					else
+						set_frame(e, frame, n);
+				}
+			}
 			else {
 				const size_t n = IMS(vw, vh, 3);
 
-				memcpy(conv_buffer, io_buffer, n);
-
+				// the mmap buffer stays valid until it is queued again
 				if (need_scale())
-					set_scaled_frame(conv_buffer, vw, vh, keep_aspectratio);
+					set_scaled_frame(io_buffer, vw, vh, keep_aspectratio);
+				else if (use_zero_copy && hand_off(buf.index, E_RGB, n))
+					handed_off = true;
 				else
-					set_frame(E_RGB, conv_buffer, n);
+					set_frame(E_RGB, io_buffer, n);
 			}
 
 			clear_error();
 		}
 
-		if (v4l2_ioctl(fd, VIDIOC_QBUF, &buf) == -1) {
+		if (!handed_off && v4l2_ioctl(fd, VIDIOC_QBUF, &buf) == -1) {
 			set_error("ioctl(VIDIOC_QBUF) failed", true);
 			do_exec_failure();
 			break;
@@ -245,6 +409,7 @@ void source_v4l::operator()()
 			myusleep(left);
 	}
 
+	free(rgb_buffer);
 	free(conv_buffer);
 
 	controls_lock.lock();
@@ -252,11 +417,44 @@ void source_v4l::operator()()
 	c = nullptr;
 	controls_lock.unlock();
 
+	// the last frame published may still be a buffer: replace it by a
+	// copy and give the consumers some time to release theirs
+	const int last_index = std::get<0>(last_hand_off);
+
+	std::unique_lock<std::mutex> rlck(ring->lock);
+	const bool last_is_out = last_index != -1 && ring->out[last_index];
+	rlck.unlock();
+
+	if (last_is_out)
+		set_frame(std::get<1>(last_hand_off), static_cast<const uint8_t *>(buffers[last_index].start), std::get<2>(last_hand_off));
+
+	for(int i=0; i<100; i++) {
+		rlck.lock();
+		const int n_out = ring->n_out;
+		rlck.unlock();
+
+		if (n_out == 0)
+			break;
+
+		myusleep(20000);
+	}
+
 	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         xioctl(fd, VIDIOC_STREAMOFF, &type, "VIDIOC_STREAMOFF");
 
-        for(int i = 0; i < n_buffers; ++i)
-                v4l2_munmap(buffers[i].start, buffers[i].length);
+	rlck.lock();
+
+        for(int i = 0; i < n_buffers; ++i) {
+		// still referenced: rather leak the mapping than crash; it stays
+		// valid after v4l2_close() as it's not a buffer of libv4l (see
+		// is_emulated())
+		if (ring->out[i])
+			log(id, LL_WARNING, "v4l buffer %d still in use, not unmapped", i);
+		else
+			v4l2_munmap(buffers[i].start, buffers[i].length);
+	}
+
+	rlck.unlock();
 
 	v4l2_close(fd);
 
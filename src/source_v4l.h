@@ -3,8 +3,12 @@
 #include "config.h"
 #if HAVE_LIBV4L2 == 1
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include "source.h"
 
@@ -26,9 +30,28 @@ protected:
 	int n_buffers;
 
 	const bool prefer_jpeg { false };
+	const std::string pixel_format;  // when not (M)JPEG: RGB24, YUYV or NV12
+	const int n_buffers_requested;
+	const bool zero_copy;
+
+	// zero-copy: buffers referenced by video_frames come back here when
+	// the last reference is gone. Shared with those references as they
+	// may outlive the capture thread.
+	struct mmap_ring {
+		std::mutex        lock;
+		std::vector<int>  returned;
+		std::vector<bool> out;
+		int               n_out { 0 };
+	};
+	std::shared_ptr<mmap_ring> ring;
+	// index, encoding, size of what was handed off last
+	std::tuple<int, encoding_t, size_t> last_hand_off { -1, E_RGB, 0 };
+
+	void requeue_returned();
+	bool hand_off(const int index, const encoding_t e, const size_t n);
 
 public:
-	source_v4l(const std::string & id, const std::string & descr, const std::string & exec_failure, const std::string & dev, const int jpeg_quality, const double max_fps, const int w_override, const int h_override, resize *const r, const int resize_w, const int resize_h, const int loglevel, const double timeout, std::vector<filter *> *const filters, const failure_t & failure, const bool prefer_jpeg, const bool use_controls, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio);
+	source_v4l(const std::string & id, const std::string & descr, const std::string & exec_failure, const std::string & dev, const int jpeg_quality, const double max_fps, const int w_override, const int h_override, resize *const r, const int resize_w, const int resize_h, const int loglevel, const double timeout, std::vector<filter *> *const filters, const failure_t & failure, const bool prefer_jpeg, const std::string & pixel_format, const int n_buffers_requested, const bool zero_copy, const bool use_controls, const std::map<std::string, feed *> & text_feeds, const bool keep_aspectratio);
 	virtual ~source_v4l();
 
 	virtual void pan_tilt(const double abs_pan, const double abs_tilt) override;
@@ -44,40 +44,59 @@ void stats_tracker::operator()()
 		if (cv_stop_notify)
 			break;
 
-		uint64_t now = get_us();
-		int slot_base = now / 1000000;
-		int slot = slot_base % 5;
+		tick_locked();
+	}
+}
+
+void stats_tracker::tick()
+{
+	std::unique_lock<std::mutex> lock(m);
 
-		if (latest_ru_ts != 0 && latest_ru_ts != prev_ru_ts) {
-			if (prev_ru_ts) {
-				if (prev_slot_ru != slot) {
-					cpu_stats[slot] = 0;
-					prev_slot_ru = slot;
-				}
+	tick_locked();
+}
 
-				struct timeval total_time_used { 0, 0 };
-				timeradd(&latest_ru.ru_utime, &latest_ru.ru_stime, &total_time_used);
+void stats_tracker::tick_locked()
+{
+	uint64_t now = get_us();
+	int slot_base = now / 1000000;
+	int slot = slot_base % 5;
+
+	if (latest_ru_ts != 0 && latest_ru_ts != prev_ru_ts) {
+		if (prev_ru_ts) {
+			if (prev_slot_ru != slot) {
+				cpu_stats[slot] = 0;
+				prev_slot_ru = slot;
+			}
 
-				struct timeval prev_time_used { 0, 0 };
-				timeradd(&prev_ru.ru_utime, &prev_ru.ru_stime, &prev_time_used);
+			struct timeval total_time_used { 0, 0 };
+			timeradd(&latest_ru.ru_utime, &latest_ru.ru_stime, &total_time_used);
 
-				struct timeval diff_time_used { 0, 0 };
-				timersub(&total_time_used, &prev_time_used, &diff_time_used);
+			struct timeval prev_time_used { 0, 0 };
+			timeradd(&prev_ru.ru_utime, &prev_ru.ru_stime, &prev_time_used);
 
-				double period = (latest_ru_ts - prev_ru_ts) / 1000000.0;
+			struct timeval diff_time_used { 0, 0 };
+			timersub(&total_time_used, &prev_time_used, &diff_time_used);
 
-				cpu_stats[slot] += diff_time_used.tv_sec + diff_time_used.tv_usec / 1000000.0 * period;
-			}
+			double period = (latest_ru_ts - prev_ru_ts) / 1000000.0;
 
-			prev_ru_ts = latest_ru_ts;
-			prev_ru = latest_ru;
+			cpu_stats[slot] += diff_time_used.tv_sec + diff_time_used.tv_usec / 1000000.0 * period;
 		}
 
-		bw_counts[slot] = 0;
+		prev_ru_ts = latest_ru_ts;
+		prev_ru = latest_ru;
+	}
+
+	bw_counts[slot] = 0;
+
+	cc_counts[slot] = 0;
 
-		cc_counts[slot] = 0;
+	fps_counts[slot] = 0;
 
-		fps_counts[slot] = 0;
+	if (++latency_age_count >= 30) {
+		latency_age_count = 0;
+
+		for(auto & l : latencies)
+			l.age();
 	}
 }
 
@@ -204,3 +223,13 @@ double stats_tracker::get_cc() const
 
 	return total / 5.0;
 }
+
+void stats_tracker::track_latency(const frame_stage_t stage, const uint64_t us)
+{
+	latencies[stage].add(us);
+}
+
+std::vector<uint64_t> stats_tracker::get_latency_percentiles(const frame_stage_t stage, const std::vector<double> & percentiles) const
+{
+	return latencies[stage].get_percentiles(percentiles);
+}
@@ -5,9 +5,12 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 #include <sys/resource.h>
 #include <sys/time.h>
 
+#include "latency_histogram.h"
+
 class stats_tracker
 {
 private:
@@ -25,18 +28,27 @@ private:
 	int bw_counts[5]{ 0 }, last_bw_count_sec{ 0 };
 	int cc_counts[5]{ 0 }, last_cc_count_sec{ 0 };
 
+	// time since capture, per stage
+	latency_histogram latencies[FS_N];
+	int latency_age_count { 0 };
+
 	std::thread *th { nullptr };
 
 	std::condition_variable cv_stop;
 	mutable std::mutex m;
 	bool cv_stop_notify { false };
 
+	void tick_locked();
+
 public:
 	stats_tracker(const std::string & id, const bool is_global);
 	virtual ~stats_tracker();
 
 	void start();
 	void operator()();
+	// for trackers without a thread of their own (see start()): call
+	// this once per second
+	void tick();
 
 	void track_cpu_usage();
 	double get_cpu_usage() const;
@@ -50,4 +62,7 @@ public:
 
 	void track_cc(const int count);
 	virtual double get_cc() const;
+
+	void track_latency(const frame_stage_t stage, const uint64_t us);
+	std::vector<uint64_t> get_latency_percentiles(const frame_stage_t stage, const std::vector<double> & percentiles) const;
 };
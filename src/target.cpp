@@ -12,6 +12,7 @@
 #include "filter.h"
 #include "db.h"
 #include "schedule.h"
+#include "video_frame.h"
 
 std::string default_fmt = "%p%Y-%m-%d_%H-%M-%S.%u_%q";
 
@@ -101,6 +102,14 @@ target::~target()
 	delete sched;
 }
 
+void queue_frame(std::deque<video_frame *> & pre_record, video_frame *const vf)
+{
+	if (!pre_record.empty())
+		vf->own_data();
+
+	pre_record.push_back(vf);
+}
+
 void target::register_file(const std::string & filename)
 {
 	log(id, LL_INFO, "Registered new file %s", filename.c_str());
@@ -110,7 +119,7 @@ void target::register_file(const std::string & filename)
 void target::start(std::vector<video_frame *> & pre_record, const unsigned long event_nr)
 {
 	log(id, LL_INFO, "Starting new target thread with event-nr %lu", event_nr);
-	this -> pre_record = pre_record;
+	this -> pre_record.assign(pre_record.begin(), pre_record.end());
 	this -> current_event_nr = event_nr;
 
 	local_stop_flag = false;
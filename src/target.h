@@ -1,6 +1,7 @@
 // (C) 2017-2026 by folkert van heusden, released under the MIT license
 #pragma once
 
+#include <deque>
 #include <string>
 #include <thread>
 #include <vector>
@@ -12,10 +13,14 @@ class filter;
 class schedule;
 class source;
 class target;
+class video_frame;
 
 extern std::string default_fmt;
 
 std::string gen_filename(source *const s, const std::string & fmt, const std::string & store_path, const std::string & prefix, const std::string & ext, const uint64_t ts, const unsigned f_nr);
+// New frames of a recording wait behind those of before the event: they
+// must not keep a zero-copy capture buffer for that long.
+void queue_frame(std::deque<video_frame *> & pre_record, video_frame *const vf);
 
 class target : public interface
 {
@@ -31,7 +36,7 @@ protected:
 	const bool is_view_proxy, handle_failure;
 	schedule *const sched;
 
-	std::vector<video_frame *> pre_record;
+	std::deque<video_frame *> pre_record;
 
 	unsigned long current_event_nr;
 
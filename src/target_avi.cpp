@@ -35,6 +35,9 @@ void target_avi::put_frame(GstAppSrc *const appsrc, video_frame *const f)
 
 	if (gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer) != GST_FLOW_OK)
 		log(id, LL_WARNING, "Problem queing frame");
+
+	f->set_stage_ts(FS_WRITTEN, get_us());
+	f->report_latency(st);
 }
 
 void target_avi::open_file(const std::string & base_pipeline, GstElement **const gpipeline, GstAppSrc **const appsrc)
@@ -190,11 +193,11 @@ void target_avi::operator()()
 				prev_frame = pvf->duplicate(E_RGB);
 			}
 
-			pre_record.push_back(pvf);
+			queue_frame(pre_record, pvf);
 
                         // get one
                         video_frame *put_f = pre_record.front();
-                        pre_record.erase(pre_record.begin());
+                        pre_record.pop_front();
 
 			time_t now = time(nullptr);
 			if ((now >= next_file && next_file != 0 && gpipeline) || allow_store == false) {
@@ -45,6 +45,9 @@ static void put_frame(transformer_t th, FILE *fh, const uint8_t *const in, const
 void target_extpipe::store_frame(video_frame *const put_f, FILE *const p_fd)
 {
 	put_frame(th, p_fd, put_f->get_data(E_RGB), put_f->get_w(), put_f->get_h());
+
+	put_f->set_stage_ts(FS_WRITTEN, get_us());
+	put_f->report_latency(st);
 }
 
 void target_extpipe::operator()()
@@ -145,11 +148,11 @@ void target_extpipe::operator()()
 			}
 
 			// put one
-			pre_record.push_back(pvf);
+			queue_frame(pre_record, pvf);
 
 			// get one
 			video_frame *put_f = pre_record.front();
-			pre_record.erase(pre_record.begin());
+			pre_record.pop_front();
 
 			if (allow_store)
 				store_frame(put_f, p_fd);
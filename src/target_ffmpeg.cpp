@@ -178,6 +178,7 @@ static bool add_stream(OutputStream *ost, AVFormatContext *oc, const AVCodec **c
 
 			c->gop_size      = std::max(fps / 2, 1); /* emit one intra frame every twelve frames at most */
 			c->pix_fmt       = STREAM_PIX_FMT;
+			c->color_range   = AVCOL_RANGE_MPEG;
 
 			if (c->codec_id == AV_CODEC_ID_MPEG2VIDEO) {
 				/* just for testing, we also add B-frames */
@@ -460,7 +461,7 @@ static bool open_video(AVFormatContext *oc, const AVCodec *codec, OutputStream *
 	return true;
 }
 
-static AVFrame *get_video_frame(OutputStream *ost, source *const s, uint64_t *const prev_ts, const std::vector<filter *> *const filters, video_frame **prev_frame, std::vector<video_frame *> & pre_record, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure)
+static AVFrame *get_video_frame(OutputStream *ost, source *const s, uint64_t *const prev_ts, const std::vector<filter *> *const filters, video_frame **prev_frame, std::deque<video_frame *> & pre_record, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure)
 {
 	AVCodecContext *c = ost->enc;
 
@@ -481,14 +482,14 @@ static AVFrame *get_video_frame(OutputStream *ost, source *const s, uint64_t *co
 		video_frame *pvf = s -> get_frame(handle_failure, *prev_ts);
 
 		if (pvf)
-			pre_record.push_back(pvf);
+			queue_frame(pre_record, pvf);
 	}
 
 	if (pre_record.empty())
 		return nullptr;
 
 	auto f = pre_record.front();
-	pre_record.erase(pre_record.begin());
+	pre_record.pop_front();
 
 	*prev_ts = f->get_ts();
 
@@ -501,20 +502,46 @@ static AVFrame *get_video_frame(OutputStream *ost, source *const s, uint64_t *co
 		f = temp;
 	}
 
-	/* as we only generate a YUV420P picture, we must convert it
-	 * to the codec pixel format if needed */
-	if (!ost->sws_ctx) {
-		ost->sws_ctx = sws_getContext(c->width, c->height, AV_PIX_FMT_RGB24, c->width, c->height, c->pix_fmt, SCALE_FLAGS, nullptr, nullptr, nullptr);
-		if (!ost->sws_ctx) {
+	if (c->pix_fmt == AV_PIX_FMT_YUV420P || c->pix_fmt == AV_PIX_FMT_NV12) {
+		/* the frame can deliver these directly (e.g. a JPEG
+		 * decoded to YUV), only the planes need to be copied;
+		 * they're limited range (like sws_scale would give) */
+		const bool is_nv12 = c->pix_fmt == AV_PIX_FMT_NV12;
+		const uint8_t *f_data = f->get_data(is_nv12 ? E_NV12 : E_I420);
+
+		if (!f_data) {
 			delete f;
-			log(LL_ERR, "Can't initialize the conversion context\n");
+			log(LL_ERR, "Can't obtain the YUV data of the frame");
 			return nullptr;
 		}
+
+		ost->frame->color_range = AVCOL_RANGE_MPEG;
+
+		const int cw = (c->width + 1) / 2;
+		const int ch = (c->height + 1) / 2;
+
+		const uint8_t *src_planes[3] { f_data, f_data + c->width * c->height, f_data + c->width * c->height + cw * ch };
+		const int src_linesize[3] { c->width, is_nv12 ? cw * 2 : cw, cw };
+		const int plane_height[3] { c->height, ch, ch };
+
+		for(int i=0; i<(is_nv12 ? 2 : 3); i++)
+			av_image_copy_plane(ost->frame->data[i], ost->frame->linesize[i], src_planes[i], src_linesize[i], src_linesize[i], plane_height[i]);
 	}
+	else {
+		/* other pixel formats are converted from RGB */
+		if (!ost->sws_ctx) {
+			ost->sws_ctx = sws_getContext(c->width, c->height, AV_PIX_FMT_RGB24, c->width, c->height, c->pix_fmt, SCALE_FLAGS, nullptr, nullptr, nullptr);
+			if (!ost->sws_ctx) {
+				delete f;
+				log(LL_ERR, "Can't initialize the conversion context\n");
+				return nullptr;
+			}
+		}
 
-	int line_size = c -> width * 3;
-	uint8_t *f_data = f->get_data(E_RGB);
-	sws_scale(ost->sws_ctx, &f_data, &line_size, 0, c->height, ost->frame->data, ost->frame->linesize);
+		int line_size = c -> width * 3;
+		uint8_t *f_data = f->get_data(E_RGB);
+		sws_scale(ost->sws_ctx, &f_data, &line_size, 0, c->height, ost->frame->data, ost->frame->linesize);
+	}
 
 	delete *prev_frame;
 	*prev_frame = f;
@@ -555,7 +582,7 @@ static void force_flush(AVFormatContext *oc, OutputStream *ost)
 	while(avio_tell(oc->pb) == pos);
 }
 
-static bool write_video_frame(AVFormatContext *oc, OutputStream *ost, source *const s, uint64_t *const prev_ts, const std::vector<filter *> *const filters, video_frame **prev_frame, std::vector<video_frame *> & pre_record, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, schedule *const sched)
+static bool write_video_frame(AVFormatContext *oc, OutputStream *ost, source *const s, uint64_t *const prev_ts, const std::vector<filter *> *const filters, video_frame **prev_frame, std::deque<video_frame *> & pre_record, configuration_t *const cfg, const bool is_view_proxy, const bool handle_failure, schedule *const sched)
 {
 	AVCodecContext *c = ost->enc;
 
@@ -742,6 +769,10 @@ void target_ffmpeg::operator()()
 			//		encode_audio = !write_audio_frame(oc, &audio_st);
 			//	}
 
+			// prev_frame is the frame that was just handed to the encoder
+			prev_frame->set_stage_ts(FS_WRITTEN, get_us());
+			prev_frame->report_latency(st);
+
 			st->track_cpu_usage();
 
 			if (finish)
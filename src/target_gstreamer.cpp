@@ -15,7 +15,7 @@
 #include "filter.h"
 #include "schedule.h"
 
-target_gstreamer::target_gstreamer(const std::string & id, const std::string & descr, source *const s, const std::string & pipeline, const double interval, const std::vector<filter *> *const filters, configuration_t *const cfg, schedule *const sched) : target(id, descr, s, "", "", "", -1, interval, filters, "", "", "", -1, cfg, false, false, sched), pipeline(pipeline)
+target_gstreamer::target_gstreamer(const std::string & id, const std::string & descr, source *const s, const std::string & pipeline, const encoding_t pixel_format, const double interval, const std::vector<filter *> *const filters, configuration_t *const cfg, schedule *const sched) : target(id, descr, s, "", "", "", -1, interval, filters, "", "", "", -1, cfg, false, false, sched), pipeline(pipeline), pixel_format(pixel_format)
 {
 }
 
@@ -24,8 +24,11 @@ target_gstreamer::~target_gstreamer()
 	stop();
 }
 
-void target_gstreamer::put_frame(GstAppSrc *const appsrc, const uint8_t *const work, const size_t n)
+void target_gstreamer::put_frame(GstAppSrc *const appsrc, video_frame *const f)
 {
+	const uint8_t *work = f->get_data(pixel_format);
+	const size_t n = pixel_format == E_I420 ? yuv420_size(f->get_w(), f->get_h()) : IMS(f->get_w(), f->get_h(), 3);
+
 	GstBuffer *buffer = gst_buffer_new_and_alloc(n);
 	gst_buffer_fill(buffer, 0, work, n);
 
@@ -84,7 +87,7 @@ void target_gstreamer::operator()()
 				pvf = temp;
 			}
 
-			pre_record.push_back(pvf);
+			queue_frame(pre_record, pvf);
 
 			if (first) {
 				first = false;
@@ -100,7 +103,7 @@ void target_gstreamer::operator()()
 						NULL);
 
 				GstCaps *video_caps = gst_caps_new_simple("video/x-raw",
-					 "format", G_TYPE_STRING, "RGB",
+					 "format", G_TYPE_STRING, pixel_format == E_I420 ? "I420" : "RGB",
                                          "width", G_TYPE_INT, pvf->get_w(),
                                          "height", G_TYPE_INT, pvf->get_h(),
 					 "block", G_TYPE_BOOLEAN, TRUE,
@@ -115,14 +118,14 @@ void target_gstreamer::operator()()
 
                         // get one
                         video_frame *put_f = pre_record.front();
-                        pre_record.erase(pre_record.begin());
+                        pre_record.pop_front();
 
 			delete prev_frame;
 
 			const bool allow_store = sched == nullptr || (sched && sched->is_on());
 
 			if (allow_store)
-				put_frame(appsrc, put_f->get_data(E_RGB), IMS(put_f->get_w(), put_f->get_h(), 3));
+				put_frame(appsrc, put_f);
 		}
 
 		st->track_cpu_usage();
@@ -138,7 +141,7 @@ void target_gstreamer::operator()()
 
 	for(auto f : pre_record) {
 		if (allow_store)
-			put_frame(appsrc, f->get_data(E_RGB), IMS(f->get_w(), f->get_h(), 3));
+			put_frame(appsrc, f);
 
 		delete f;
 	}
@@ -1,5 +1,6 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
 #pragma once
+#include "encoding.h"
 #include "target.h"
 
 #if HAVE_GSTREAMER == 1
@@ -10,11 +11,12 @@ class target_gstreamer : public target
 {
 private:
 	const std::string pipeline;
+	const encoding_t  pixel_format;  // E_RGB or E_I420
 
-	void put_frame(GstAppSrc *const appsrc, const uint8_t *const work, const size_t n);
+	void put_frame(GstAppSrc *const appsrc, video_frame *const f);
 
 public:
-	target_gstreamer(const std::string & id, const std::string & descr, source *const s, const std::string & pipeline, const double interval, const std::vector<filter *> *const filters, configuration_t *const cfg, schedule *const sched);
+	target_gstreamer(const std::string & id, const std::string & descr, source *const s, const std::string & pipeline, const encoding_t pixel_format, const double interval, const std::vector<filter *> *const filters, configuration_t *const cfg, schedule *const sched);
 	virtual ~target_gstreamer();
 
 	void operator()() override;
@@ -28,6 +28,9 @@ void target_gwavi::put_frame(video_frame *const f)
 	auto frame = f->get_data_and_len(E_JPEG);
 
 	gwavi_add_frame(gwavi, (unsigned char *)std::get<0>(frame), std::get<1>(frame));
+
+	f->set_stage_ts(FS_WRITTEN, get_us());
+	f->report_latency(st);
 }
 
 void target_gwavi::open_file()
@@ -96,11 +99,11 @@ void target_gwavi::operator()()
 				prev_frame = pvf->duplicate(E_RGB);
 			}
 
-			pre_record.push_back(pvf);
+			queue_frame(pre_record, pvf);
 
                         // get one
                         video_frame *put_f = pre_record.front();
-                        pre_record.erase(pre_record.begin());
+                        pre_record.pop_front();
 
 			time_t now = time(nullptr);
 			if ((now >= next_file && next_file != 0 && gwavi) || allow_store == false) {
@@ -45,6 +45,9 @@ std::string target_jpeg::write_frame(video_frame *put_f)
 
 	fwrite(std::get<0>(img), std::get<1>(img), 1, fh);
 
+	put_f->set_stage_ts(FS_WRITTEN, get_us());
+	put_f->report_latency(st);
+
 	delete put_f;
 
 	fclose(fh);
@@ -80,21 +83,21 @@ void target_jpeg::operator()()
 			prev_ts = pvf->get_ts();
 
 			if (!filters || filters -> empty()) {
-				pre_record.push_back(pvf);
+				queue_frame(pre_record, pvf);
 			}
 			else {
 				source *cur_s = is_view_proxy ? ((view *)s) -> get_current_source() : s;
 				instance *inst = find_instance_by_interface(cfg, cur_s);
 
                                 video_frame *temp = pvf->apply_filtering(inst, cur_s, prev_frame, filters, nullptr);
-				pre_record.push_back(temp);
+				queue_frame(pre_record, temp);
 
 				delete prev_frame;
 				prev_frame = temp->duplicate({ });
 			}
 
 			video_frame * put_f = pre_record.front();
-			pre_record.erase(pre_record.begin());
+			pre_record.pop_front();
 
 			const bool allow_store = sched == nullptr || (sched && sched->is_on());
 
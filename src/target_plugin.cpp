@@ -99,7 +99,7 @@ void target_plugin::operator()()
 
 			// get
                         video_frame *put_f = pre_record.front();
-			pre_record.erase(pre_record.begin());
+			pre_record.pop_front();
 
 			const bool allow_store = sched == nullptr || (sched && sched->is_on());
 
@@ -29,8 +29,6 @@ v4l2_loopback::v4l2_loopback(const std::string & id, const std::string & descr,
 	local_stop_flag = false;
 	ct = CT_LOOPBACK;
 
-	th = myjpeg::allocate_transformer();
-
 	if (this -> descr == "")
 		this -> descr = dev;
 }
@@ -39,8 +37,6 @@ v4l2_loopback::~v4l2_loopback()
 {
 	stop();
 	free_filters(filters);
-
-	myjpeg::free_transformer(th);
 }
 
 void v4l2_loopback::operator()()
@@ -89,7 +85,11 @@ void v4l2_loopback::operator()()
 
 				if (pixel_format == "YUV420") {
 					v.fmt.pix.pixelformat = V4L2_PIX_FMT_YUV420;
-					enc_n = v.fmt.pix.width * v.fmt.pix.height + v.fmt.pix.width * v.fmt.pix.height / 2;
+					enc_n = yuv420_size(v.fmt.pix.width, v.fmt.pix.height);
+				}
+				else if (pixel_format == "NV12") {
+					v.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+					enc_n = yuv420_size(v.fmt.pix.width, v.fmt.pix.height);
 				}
 				else if (pixel_format == "BGR24" || pixel_format == "RGB24") {
 					v.fmt.pix.pixelformat = V4L2_PIX_FMT_BGR24;
@@ -116,22 +116,19 @@ void v4l2_loopback::operator()()
 				pvf = temp;
 			}
 
-			auto img = pvf->get_data_and_len(E_RGB);
+			if (pixel_format == "YUV420" || pixel_format == "NV12") {
+				// the frame may already have it (e.g. decoded from JPEG)
+				const uint8_t *yuv = pvf->get_data(pixel_format == "NV12" ? E_NV12 : E_I420);
 
-			if (pixel_format == "YUV420") {
-				uint8_t *temp { nullptr };
-				my_jpeg.rgb_to_i420(th, std::get<0>(img), pvf->get_w(), pvf->get_h(), &temp);
-
-				if (write(v4l2sink, temp, enc_n) == -1) {
+				if (write(v4l2sink, yuv, enc_n) == -1) {
 					set_error("write to video loopback failed", true);
-					free(temp);
 					delete pvf;
 					break;
 				}
-
-				free(temp);
 			}
 			else if (pixel_format == "YUYV") {
+				auto img = pvf->get_data_and_len(E_RGB);
+
 				uint8_t *temp { nullptr };
 				rgb_to_yuy2(std::get<0>(img), pvf->get_w(), pvf->get_h(), &temp);
 
@@ -145,6 +142,8 @@ void v4l2_loopback::operator()()
 				free(temp);
 			}
 			else {
+				auto img = pvf->get_data_and_len(E_RGB);
+
 				if (write(v4l2sink, std::get<0>(img), std::get<1>(img)) == -1) {
 					set_error("write to video loopback failed", true);
 					delete pvf;
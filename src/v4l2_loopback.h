@@ -20,7 +20,6 @@ private:
 	const std::string dev, pixel_format;
 	const std::vector<filter *> *const filters;
 	instance *const inst;
-	transformer_t th;
 
 public:
 	v4l2_loopback(const std::string & id, const std::string & descr, source *const s, const double fps, const std::string & dev, const std::string & pixel_format, const std::vector<filter *> *const filters, instance *const inst);
@@ -1,7 +1,10 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
 #include "gen.h"
+#include "frame_pool.h"
+#include "jpeg_cache.h"
 #include "utils.h"
 #include "resize.h"
 #include "picio.h"
@@ -11,20 +14,50 @@
 #include "source.h"
 #include "filter.h"
 #include "log.h"
+#include "stats_tracker.h"
 
-video_frame::video_frame(const meta *const m, const int jpeg_quality) : m_(m), jpeg_quality(jpeg_quality)
+std::atomic_uint64_t video_frame::bytes_copied { 0 };
+std::atomic_uint64_t video_frame::bytes_shared { 0 };
+
+video_frame::video_frame(const meta *const m, const int jpeg_quality, const std::shared_ptr<frame_pool> & pool) : m_(m), jpeg_quality(jpeg_quality), pool(pool)
 {
 }
 
 video_frame::video_frame(const meta *const m, const int jpeg_quality, const uint64_t ts, const int w, const int h, uint8_t *const data, const size_t len, const encoding_t e) : m_(m), jpeg_quality(jpeg_quality), ts(ts), w(w), h(h)
 {
-	this->data.insert({ e, { data, len } });
+	add_encoding(e, data, len);
+}
+
+video_frame::video_frame(const meta *const m, const int jpeg_quality, const uint64_t ts, const int w, const int h, const std::shared_ptr<uint8_t> & data, const size_t len, const encoding_t e, const std::shared_ptr<frame_pool> & pool, const std::shared_ptr<jpeg_cache> & jcache) : m_(m), jpeg_quality(jpeg_quality), ts(ts), w(w), h(h), pool(pool), jcache(jcache)
+{
+	add_encoding(e, data, len);
 }
 
 video_frame::~video_frame()
 {
-	for(auto it : data)
-		free(it.second.first);
+}
+
+// takes ownership of 'data' (must've been allocated with malloc)
+std::map<encoding_t, frame_data_t>::iterator video_frame::add_encoding(const encoding_t e, uint8_t *const data, const size_t len)
+{
+	return add_encoding(e, std::shared_ptr<uint8_t>(data, free), len);
+}
+
+std::map<encoding_t, frame_data_t>::iterator video_frame::add_encoding(const encoding_t e, const std::shared_ptr<uint8_t> & data, const size_t len)
+{
+	frame_data_t d { data, len };
+	auto rc = this->data.emplace(e, d);
+	assert(rc.second);
+
+	return rc.first;
+}
+
+std::shared_ptr<uint8_t> video_frame::allocate(const size_t len)
+{
+	if (pool)
+		return pool->allocate(len);
+
+	return std::shared_ptr<uint8_t>((uint8_t *)malloc(len), free);
 }
 
 void video_frame::set_ts(const uint64_t ts)
@@ -32,6 +65,17 @@ void video_frame::set_ts(const uint64_t ts)
 	const std::lock_guard<std::mutex> lock(m);
 
 	this->ts = ts;
+
+	// the cache is keyed by timestamp
+	jcache.reset();
+}
+
+void video_frame::set_jpeg_cache(const std::shared_ptr<jpeg_cache> & jcache)
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	this->jcache = jcache;
+	jcache_variant = 0;
 }
 
 void video_frame::set_wh(const int w, const int h)
@@ -46,16 +90,19 @@ void video_frame::put_data(const uint8_t *const data, const size_t len, const en
 {
 	const std::lock_guard<std::mutex> lock(m);
 
-	uint8_t *new_data = (uint8_t *)::duplicate(data, len);
+	auto copy = allocate(len);
+	memcpy(copy.get(), data, len);
 
-	std::pair<uint8_t *, size_t> d { new_data, len };
-	auto rc = this->data.emplace(e, d);
+	add_encoding(e, copy, len);
 
-	assert(rc.second);
+	bytes_copied += len;
 }
 
-std::map<encoding_t, std::pair<uint8_t *, size_t> >::iterator video_frame::gen_encoding(const encoding_t new_e)
+std::map<encoding_t, frame_data_t>::iterator video_frame::gen_encoding(const encoding_t new_e)
 {
+	if (new_e == E_GRAY)
+		return gen_gray();
+
 	auto it_rgb = data.find(E_RGB);
 
 	// TODO improve this. decoding jpeg may be faster for example (when also available).
@@ -63,77 +110,217 @@ std::map<encoding_t, std::pair<uint8_t *, size_t> >::iterator video_frame::gen_e
 		auto it_bgr = data.find(E_BGR);
 
 		if (it_bgr != data.end()) {
-			size_t n_bytes = w * h * 3;
-			uint8_t *frame_rgb = (uint8_t *)malloc(n_bytes);
+			size_t n_bytes = IMS(w, h, 3);
+			auto buffer = allocate(n_bytes);
+			uint8_t *frame_rgb = buffer.get();
 
-			for(int i=0; i<n_bytes; i += 3) {
-				frame_rgb[i + 0] = it_bgr->second.first[i + 2];
-				frame_rgb[i + 1] = it_bgr->second.first[i + 1];
-				frame_rgb[i + 2] = it_bgr->second.first[i + 0];
-			}
+			bgr_to_rgb(it_bgr->second.first.get(), size_t(w) * h, frame_rgb);
 
-			std::pair<uint8_t *, size_t> d { frame_rgb, n_bytes };
-			auto rc = data.emplace(E_RGB, d);
-			assert(rc.second);
+			auto rc = add_encoding(E_RGB, buffer, n_bytes);
 
 			if (new_e == E_RGB)
-				return rc.first;
+				return rc;
 		}
 
 		auto it_yuyv = data.find(E_YUYV);
 
 		if (it_yuyv != data.end()) {
 			uint8_t *frame_rgb { nullptr };
-			yuy2_to_rgb(it_yuyv->second.first, w, h, &frame_rgb);
+			yuy2_to_rgb(it_yuyv->second.first.get(), w, h, &frame_rgb);
+
+			auto rc = add_encoding(E_RGB, frame_rgb, IMS(w, h, 3));
 
-			std::pair<uint8_t *, size_t> d { frame_rgb, w * h * 3 };
-			auto rc = data.emplace(E_RGB, d);
-			assert(rc.second);
+			if (new_e == E_RGB)
+				return rc;
+		}
+		else if (data.find(E_I420) != data.end() || data.find(E_NV12) != data.end()) {
+			// limited range, like YUYV (not TurboJPEG which assumes JFIF)
+			auto it_i420 = data.find(E_I420);
+			auto it_nv12 = data.find(E_NV12);
+
+			const size_t n_bytes = IMS(w, h, 3);
+			auto buffer = allocate(n_bytes);
+
+			if (it_i420 != data.end())
+				i420_to_rgb(it_i420->second.first.get(), w, h, buffer.get());
+			else
+				nv12_to_rgb(it_nv12->second.first.get(), w, h, buffer.get());
+
+			auto rc = add_encoding(E_RGB, buffer, n_bytes);
 
 			if (new_e == E_RGB)
-				return rc.first;
+				return rc;
 		}
 	}
 
+	if (new_e == E_I420 || new_e == E_NV12)
+		return gen_yuv420(new_e);
+
 	if (new_e == E_JPEG) {
 		auto it = data.find(E_RGB);
 
-		uint8_t *frame_jpeg { nullptr };
-		size_t frame_jpeg_len = 0;
-		if (!my_jpeg.write_JPEG_memory(m_, w, h, jpeg_quality, it->second.first, &frame_jpeg, &frame_jpeg_len)) {
-			log(LL_ERR, "write_JPEG_memory failed");
+		if (it == data.end())
 			return data.end();
-		}
 
-		std::pair<uint8_t *, size_t> d { frame_jpeg, frame_jpeg_len };
-		auto rc = data.emplace(E_JPEG, d);
-		assert(rc.second);
+		auto encode = [&]() -> frame_data_t {
+			uint8_t *frame_jpeg { nullptr };
+			size_t frame_jpeg_len = 0;
+			if (!my_jpeg.write_JPEG_memory(m_, w, h, jpeg_quality, it->second.first.get(), &frame_jpeg, &frame_jpeg_len)) {
+				log(LL_ERR, "write_JPEG_memory failed");
+				return { };
+			}
+
+			return { std::shared_ptr<uint8_t>(frame_jpeg, free), frame_jpeg_len };
+		};
+
+		frame_data_t jpeg = jcache ? jcache->get(ts, jpeg_quality, w, h, jcache_variant, encode) : encode();
+
+		if (!jpeg.first)
+			return data.end();
 
-		return rc.first;
+		stage_ts[FS_ENCODED] = get_us();
+
+		return add_encoding(E_JPEG, jpeg.first, jpeg.second);
 	}
 
 	if (new_e == E_RGB) {
 		auto it = data.find(E_JPEG);
 
-		uint8_t *frame_rgb { nullptr };
-		int dw = -1, dh = -1;
+		if (it == data.end())
+			return data.end();
+
+		const size_t n_bytes = IMS(w, h, 3);
+		auto buffer = allocate(n_bytes);
+
 		// FIXME treat "dw != w || dh != h" really as an error?
-		if (!my_jpeg.read_JPEG_memory(it->second.first, it->second.second, &dw, &dh, &frame_rgb) || dw != w || dh != h) {
+		if (!my_jpeg.read_JPEG_memory(it->second.first.get(), it->second.second, w, h, buffer.get())) {
 			log(LL_ERR, "read_JPEG_memory failed");
-			free(frame_rgb);
 			return data.end();
 		}
 
-		std::pair<uint8_t *, size_t> d { frame_rgb, w * h * 3 };
-		auto rc = data.emplace(E_RGB, d);
-		assert(rc.second);
+		stage_ts[FS_DECODED] = get_us();
 
-		return rc.first;
+		return add_encoding(E_RGB, buffer, n_bytes);
 	}
 
 	return data.end();
 }
 
+// Codecs want planar YUV; get it from what is there with the least work:
+// a JPEG is decoded straight to YUV (no RGB step), YUYV only needs its
+// chroma to be averaged. TurboJPEG gives full range, that is scaled to
+// limited range like that of the cameras.
+std::map<encoding_t, frame_data_t>::iterator video_frame::gen_yuv420(const encoding_t new_e)
+{
+	const size_t n_bytes = yuv420_size(w, h);
+
+	if (new_e == E_NV12) {
+		auto it_i420 = data.find(E_I420);
+
+		if (it_i420 == data.end())
+			it_i420 = gen_yuv420(E_I420);
+
+		if (it_i420 == data.end())
+			return data.end();
+
+		auto buffer = allocate(n_bytes);
+		i420_to_nv12(it_i420->second.first.get(), w, h, buffer.get());
+
+		return add_encoding(E_NV12, buffer, n_bytes);
+	}
+
+	auto buffer = allocate(n_bytes);
+
+	auto it_nv12 = data.find(E_NV12);
+	if (it_nv12 != data.end()) {
+		nv12_to_i420(it_nv12->second.first.get(), w, h, buffer.get());
+
+		return add_encoding(E_I420, buffer, n_bytes);
+	}
+
+	auto it_yuyv = data.find(E_YUYV);
+	if (it_yuyv != data.end()) {
+		yuy2_to_i420(it_yuyv->second.first.get(), w, h, buffer.get());
+
+		return add_encoding(E_I420, buffer, n_bytes);
+	}
+
+	auto it_rgb = data.find(E_RGB);
+
+	if (it_rgb == data.end()) {
+		auto it_jpeg = data.find(E_JPEG);
+
+		if (it_jpeg != data.end() && my_jpeg.read_JPEG_memory_i420(it_jpeg->second.first.get(), it_jpeg->second.second, w, h, buffer.get())) {
+			stage_ts[FS_DECODED] = get_us();
+
+			i420_to_limited_range(buffer.get(), w, h);
+
+			return add_encoding(E_I420, buffer, n_bytes);
+		}
+
+		it_rgb = gen_encoding(E_RGB);
+
+		if (it_rgb == data.end())
+			return data.end();
+	}
+
+	if (!my_jpeg.encode_i420(it_rgb->second.first.get(), w, h, buffer.get()))
+		return data.end();
+
+	i420_to_limited_range(buffer.get(), w, h);
+
+	return add_encoding(E_I420, buffer, n_bytes);
+}
+
+// Luma for motion detection and the like; from YUV it's the Y plane
+// scaled to full range (like that of a JPEG or RGB), from a JPEG only the
+// Y component is decoded.
+std::map<encoding_t, frame_data_t>::iterator video_frame::gen_gray()
+{
+	const size_t n_bytes = size_t(w) * h;
+	auto buffer = allocate(n_bytes);
+
+	auto it_yuv420 = data.find(E_I420);
+
+	if (it_yuv420 == data.end())
+		it_yuv420 = data.find(E_NV12);
+
+	if (it_yuv420 != data.end()) {
+		luma_to_gray(it_yuv420->second.first.get(), n_bytes, buffer.get());
+
+		return add_encoding(E_GRAY, buffer, n_bytes);
+	}
+
+	auto it_yuyv = data.find(E_YUYV);
+
+	if (it_yuyv != data.end()) {
+		yuy2_to_gray(it_yuyv->second.first.get(), n_bytes, buffer.get());
+
+		return add_encoding(E_GRAY, buffer, n_bytes);
+	}
+
+	auto it_rgb = data.find(E_RGB);
+
+	if (it_rgb == data.end()) {
+		auto it_jpeg = data.find(E_JPEG);
+
+		if (it_jpeg != data.end() && my_jpeg.read_JPEG_memory_gray(it_jpeg->second.first.get(), it_jpeg->second.second, w, h, buffer.get())) {
+			stage_ts[FS_DECODED] = get_us();
+
+			return add_encoding(E_GRAY, buffer, n_bytes);
+		}
+
+		it_rgb = gen_encoding(E_RGB);
+
+		if (it_rgb == data.end())
+			return data.end();
+	}
+
+	rgb_to_gray(it_rgb->second.first.get(), n_bytes, buffer.get());
+
+	return add_encoding(E_GRAY, buffer, n_bytes);
+}
+
 uint8_t *video_frame::get_data(const encoding_t e)
 {
 	return std::get<0>(get_data_and_len(e));
@@ -151,30 +338,42 @@ std::tuple<uint8_t *, size_t> video_frame::get_data_and_len_internal(const encod
 			// this path is taken when e.g. a JPEG could not be decoded
 			log(LL_WARNING, "returning gray failure frame");
 
-			size_t n_pixels = w * h * 3;
-			uint8_t *gray = (uint8_t *)malloc(n_pixels);
+			// 0x80 is neutral gray for the YUV formats as well
+			size_t n_bytes = w * h * 3;
 
-			memset(gray, 0x80, n_pixels);
+			if (e == E_GRAY)
+				n_bytes = w * h;
+			else if (e == E_YUYV)
+				n_bytes = w * h * 2;
+			else if (e == E_I420 || e == E_NV12)
+				n_bytes = yuv420_size(w, h);
 
-			if (e == E_RGB) {
-				// takes ownership of the allocated memory
-				return std::make_tuple(gray, n_pixels);
-			}
+			uint8_t *gray = (uint8_t *)malloc(n_bytes);
 
-			uint8_t *frame_jpeg { nullptr };
-			size_t frame_jpeg_len = 0;
-			if (!my_jpeg.write_JPEG_memory(m_, w, h, jpeg_quality, gray, &frame_jpeg, &frame_jpeg_len)) {
-				log(LL_ERR, "write_JPEG_memory failed");
-				return std::make_tuple(nullptr, 0); // this will probably cause a crash
+			memset(gray, 0x80, n_bytes);
+
+			if (e != E_JPEG) {
+				// the frame takes ownership of the allocated memory
+				it = add_encoding(e, gray, n_bytes);
 			}
+			else {
+				uint8_t *frame_jpeg { nullptr };
+				size_t frame_jpeg_len = 0;
+				bool ok = my_jpeg.write_JPEG_memory(m_, w, h, jpeg_quality, gray, &frame_jpeg, &frame_jpeg_len);
 
-			free(gray);
+				free(gray);
 
-			return std::make_tuple(frame_jpeg, frame_jpeg_len);
+				if (!ok) {
+					log(LL_ERR, "write_JPEG_memory failed");
+					return std::make_tuple(nullptr, 0); // this will probably cause a crash
+				}
+
+				it = add_encoding(e, frame_jpeg, frame_jpeg_len);
+			}
 		}
 	}
 
-	return std::make_tuple(it->second.first, it->second.second);
+	return std::make_tuple(it->second.first.get(), it->second.second);
 }
 
 std::tuple<uint8_t *, size_t> video_frame::get_data_and_len(const encoding_t e)
@@ -184,6 +383,53 @@ std::tuple<uint8_t *, size_t> video_frame::get_data_and_len(const encoding_t e)
 	return get_data_and_len_internal(e);
 }
 
+// copy-on-write: the buffer may be shared with other frames (see
+// duplicate()), so make a private copy before handing it out for
+// modification
+uint8_t *video_frame::get_data_writable(const encoding_t e)
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	if (std::get<0>(get_data_and_len_internal(e)) == nullptr)
+		return nullptr;
+
+	auto it = data.find(e);
+
+	if (it == data.end())
+		return nullptr;
+
+	if (it->second.first.use_count() > 1) {
+		const size_t len = it->second.second;
+
+		auto copy = allocate(len);
+		memcpy(copy.get(), it->second.first.get(), len);
+
+		it->second.first = copy;
+
+		bytes_copied += len;
+
+		if (lent == e)
+			lent.reset();
+	}
+
+	// the pixels are about to change so this frame's JPEG can no
+	// longer be shared
+	jcache.reset();
+
+	// all other representations are stale after the write
+	for(auto other = data.begin(); other != data.end();) {
+		if (other->first == e)
+			other++;
+		else
+			other = data.erase(other);
+	}
+
+	if (lent != e)
+		lent.reset();
+
+	return it->second.first.get();
+}
+
 std::tuple<int, int> video_frame::get_wh() const
 {
 	const std::lock_guard<std::mutex> lock(m);
@@ -212,6 +458,8 @@ uint64_t video_frame::get_ts() const
 	return ts;
 }
 
+// The JPEG cache reference is kept: the cache is keyed by timestamp, so
+// the frame simply gets an entry of its own (shared by its duplicates).
 void video_frame::update_ts()
 {
 	const std::lock_guard<std::mutex> lock(m);
@@ -227,46 +475,105 @@ video_frame *video_frame::do_resize(resize *const r, const int new_w, const int
 
 	auto rc = get_data_and_len_internal(E_RGB);
 
-	uint8_t *resized { nullptr };
-	r->do_resize(w, h, std::get<0>(rc), new_w, new_h, &resized);
+	const size_t n_bytes = IMS(new_w, new_h, 3);
+	auto resized = allocate(n_bytes);
+	r->do_resize(w, h, std::get<0>(rc), new_w, new_h, resized.get());
+
+	// a resize of a resized frame is not cached, the key only has the
+	// last resizer
+	std::shared_ptr<jpeg_cache> resized_jcache = jcache_variant ? nullptr : jcache;
 
 	lock.unlock();
 
-	return new video_frame(m_, jpeg_quality, ts, new_w, new_h, resized, IMS(new_w, new_h, 3), E_RGB);
+	video_frame *out = inherit_stages(new video_frame(m_, jpeg_quality, ts, new_w, new_h, resized, n_bytes, E_RGB, pool, resized_jcache));
+	out->jcache_variant = uintptr_t(r);
+
+	return out;
 }
 
 video_frame *video_frame::duplicate(const std::optional<encoding_t> e)
 {
 	const std::lock_guard<std::mutex> lock(m);
 
-	video_frame *out = new video_frame(m_, jpeg_quality);
+	video_frame *out = new video_frame(m_, jpeg_quality, pool);
 
 	out->set_ts(ts);
 	out->set_wh(w, h);
 
+	inherit_stages(out);
+
+	out->jcache = jcache;
+	out->jcache_variant = jcache_variant;
+
+	// no copy of the pixel data is made, only the references
 	if (e.has_value()) {
 		auto type = e.value();
-		auto rc = get_data_and_len_internal(type);
 
-		out->put_data(std::get<0>(rc), std::get<1>(rc), type);
+		get_data_and_len_internal(type);
+
+		auto it = data.find(type);
+
+		out->data.emplace(type, it->second);
+
+		bytes_shared += it->second.second;
+
+		if (lent == type)
+			out->lent = lent;
 	}
 	else {
-		for(auto it : data)
-			out->put_data(it.second.first, it.second.second, it.first);
+		for(auto & it : data) {
+			out->data.emplace(it.first, it.second);
+
+			bytes_shared += it.second.second;
+		}
+
+		out->lent = lent;
 	}
 
 	return out;
 }
 
+void video_frame::set_lent(const encoding_t e)
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	lent = e;
+}
+
+void video_frame::own_data()
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	if (!lent.has_value())
+		return;
+
+	auto it = data.find(lent.value());
+
+	if (it != data.end()) {
+		const size_t len = it->second.second;
+
+		auto copy = allocate(len);
+		memcpy(copy.get(), it->second.first.get(), len);
+
+		it->second.first = copy;
+
+		bytes_copied += len;
+	}
+
+	lent.reset();
+}
+
 video_frame *video_frame::apply_filtering(instance *const inst, source *const s, video_frame *const prev, const std::vector<filter *> *const filters, controls *const c)
 {
 	video_frame *out = duplicate(E_RGB);
 
 	if (filters)
-		apply_filters(inst, s, filters, prev ? prev->get_data(E_RGB) : nullptr, out->get_data(E_RGB), out->get_ts(), out->get_w(), out->get_h());
+		apply_filters(inst, s, filters, prev ? prev->get_data(E_RGB) : nullptr, out->get_data_writable(E_RGB), out->get_ts(), out->get_w(), out->get_h());
 
 	if (c)
-		c->apply(out->get_data(E_RGB), out->get_w(), out->get_h());
+		c->apply(out->get_data_writable(E_RGB), out->get_w(), out->get_h());
+
+	out->set_stage_ts(FS_FILTERED, get_us());
 
 	return out;
 }
@@ -275,57 +582,180 @@ void video_frame::keep_only_format(const encoding_t ek)
 {
 	const std::lock_guard<std::mutex> lock(m);
 
+	// e.g. a JPEG-only frame: there's nothing it could be regenerated from
+	if (data.find(ek) == data.end())
+		return;
+
 	// TODO handle E_YUYV
 	auto it = data.find(ek == E_RGB ? E_JPEG : E_RGB);
 
-	if (it != data.end()) {
-		free(it->second.first);
+	if (it != data.end())
 		data.erase(it);
+
+	// planar YUV and luma can be regenerated from what is left
+	if (data.find(ek) != data.end()) {
+		if (ek != E_I420)
+			data.erase(E_I420);
+
+		if (ek != E_NV12)
+			data.erase(E_NV12);
+
+		if (ek != E_GRAY)
+			data.erase(E_GRAY);
+	}
+
+	if (lent.has_value() && data.find(lent.value()) == data.end())
+		lent.reset();
+}
+
+// returns nullptr when the frame has more than a JPEG (then the pixels
+// are already there) or when the transformation can't be done losslessly
+video_frame *video_frame::jpeg_transform(const int op, const int crop_x, const int crop_y, const int crop_w, const int crop_h)
+{
+	std::unique_lock<std::mutex> lock(m);
+
+	if (data.size() != 1 || data.begin()->first != E_JPEG)
+		return nullptr;
+
+	const frame_data_t jpeg = data.begin()->second;
+
+	lock.unlock();
+
+	uint8_t *out = nullptr;
+	size_t out_len = 0;
+	int out_w = -1, out_h = -1;
+
+	if (!my_jpeg.transform_JPEG_memory(jpeg.first.get(), jpeg.second, op, crop_x, crop_y, crop_w, crop_h, &out, &out_len, &out_w, &out_h))
+		return nullptr;
+
+	return inherit_stages(new video_frame(m_, jpeg_quality, ts, out_w, out_h, std::shared_ptr<uint8_t>(out, free), out_len, E_JPEG, pool));
+}
+
+// 90 and 270 degrees write columns; going through the picture in tiles
+// keeps both the rows read and the columns written in the cache
+static void rotate_rgb_tiled(const uint8_t *const in, const int w, const int h, uint8_t *const out, const bool mirror_x)
+{
+	constexpr int tile = 32;
+
+	for(int ty=0; ty<h; ty += tile) {
+		const int ey = std::min(ty + tile, h);
+
+		for(int tx=0; tx<w; tx += tile) {
+			const int ex = std::min(tx + tile, w);
+
+			for(int y=ty; y<ey; y++) {
+				const uint8_t *const in_line = &in[y * w * 3];
+
+				for(int x=tx; x<ex; x++) {
+					const uint8_t *const pin = &in_line[(mirror_x ? w - 1 - x : x) * 3];
+					uint8_t *const pout = &out[x * h * 3 + y * 3];
+
+					pout[0] = pin[0];
+					pout[1] = pin[1];
+					pout[2] = pin[2];
+				}
+			}
+		}
 	}
 }
 
 video_frame *video_frame::do_rotate(const int angle)
 {
+	// JPEG-only frames (e.g. from an MJPEG camera) stay compressed. The
+	// operations match those of the pixel based code below.
+	if (angle == 90 || angle == 180 || angle == 270) {
+		video_frame *out = jpeg_transform(angle == 90 ? TJXOP_TRANSPOSE : (angle == 180 ? TJXOP_VFLIP : TJXOP_ROT270), 0, 0, -1, -1);
+
+		if (out)
+			return out;
+	}
+
 	auto img = get_data_and_len(E_RGB);
 	const uint8_t *data = std::get<0>(img);
 	const size_t len = std::get<1>(img);
 
-	if (angle == 90) {
-		uint8_t *new_ = (uint8_t *)malloc(len);
+	if (angle == 90 || angle == 270) {
+		auto buffer = allocate(len);
 
-		for(int y=0; y<h; y++) {
-			for(int x=0; x<w; x++) {
-				new_[x * h * 3 + y * 3 + 0] = data[y * w * 3 + x * 3 + 0];
-				new_[x * h * 3 + y * 3 + 1] = data[y * w * 3 + x * 3 + 1];
-				new_[x * h * 3 + y * 3 + 2] = data[y * w * 3 + x * 3 + 2];
-			}
-		}
+		rotate_rgb_tiled(data, w, h, buffer.get(), angle == 270);
 
-		return new video_frame(m_, jpeg_quality, ts, h, w, new_, IMS(h, w, 3), E_RGB);
+		return inherit_stages(new video_frame(m_, jpeg_quality, ts, h, w, buffer, len, E_RGB, pool));
 	}
 	else if (angle == 180) {
-		uint8_t *new_ = (uint8_t *)malloc(len);
+		auto buffer = allocate(len);
+		uint8_t *new_ = buffer.get();
 
 		for(int y=0; y<h; y++)
 			memcpy(&new_[y * w * 3], &data[(h - 1 - y) * w * 3], w * 3);
 
-		return new video_frame(m_, jpeg_quality, ts, w, h, new_, IMS(w, h, 3), E_RGB);
+		return inherit_stages(new video_frame(m_, jpeg_quality, ts, w, h, buffer, len, E_RGB, pool));
 	}
-	else if (angle == 270) {
-		uint8_t *new_ = (uint8_t *)malloc(len);
 
-		for(int y=0; y<h; y++) {
-			for(int x=0; x<w; x++) {
-				int mx = w - 1 - x;
+	return duplicate(E_RGB);
+}
 
-				new_[x * h * 3 + y * 3 + 0] = data[y * w * 3 + mx * 3 + 0];
-				new_[x * h * 3 + y * 3 + 1] = data[y * w * 3 + mx * 3 + 1];
-				new_[x * h * 3 + y * 3 + 2] = data[y * w * 3 + mx * 3 + 2];
-			}
-		}
+video_frame *video_frame::do_crop(const int x, const int y, const int cw, const int ch)
+{
+	video_frame *out = jpeg_transform(TJXOP_NONE, x, y, cw, ch);
+
+	if (out)
+		return out;
+
+	const uint8_t *data = get_data(E_RGB);
 
-		return new video_frame(m_, jpeg_quality, ts, h, w, new_, IMS(h, w, 3), E_RGB);
+	const size_t len = IMS(cw, ch, 3);
+	auto buffer = allocate(len);
+	uint8_t *new_ = buffer.get();
+
+	for(int line=0; line<ch; line++)
+		memcpy(&new_[line * cw * 3], &data[(y + line) * w * 3 + x * 3], cw * 3);
+
+	return inherit_stages(new video_frame(m_, jpeg_quality, ts, cw, ch, buffer, len, E_RGB, pool));
+}
+
+video_frame *video_frame::inherit_stages(video_frame *const out) const
+{
+	for(int i=0; i<FS_N; i++)
+		out->stage_ts[i] = stage_ts[i].load();
+
+	return out;
+}
+
+void video_frame::set_stage_ts(const frame_stage_t stage, const uint64_t stage_ts)
+{
+	this->stage_ts[stage] = stage_ts;
+}
+
+uint64_t video_frame::get_stage_ts(const frame_stage_t stage) const
+{
+	return stage_ts[stage];
+}
+
+void video_frame::report_latency(stats_tracker *const st) const
+{
+	const uint64_t captured = stage_ts[FS_CAPTURED];
+
+	if (captured == 0)
+		return;
+
+	for(int i=FS_CAPTURED + 1; i<FS_N; i++) {
+		const uint64_t cur = stage_ts[i];
+
+		if (cur >= captured)
+			st->track_latency(frame_stage_t(i), cur - captured);
 	}
+}
 
-	return duplicate(E_RGB);
+bool video_frame::has_only(const encoding_t e) const
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	return data.size() == 1 && data.begin()->first == e;
+}
+
+bool video_frame::has_encoding(const encoding_t e) const
+{
+	const std::lock_guard<std::mutex> lock(m);
+
+	return data.find(e) != data.end();
 }
@@ -1,5 +1,8 @@
 // (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <stdint.h>
@@ -7,13 +10,21 @@
 #include <vector>
 
 #include "encoding.h"
+#include "latency_histogram.h"
 
 class controls;
 class filter;
+class frame_pool;
 class instance;
+class jpeg_cache;
 class meta;
 class resize;
 class source;
+class stats_tracker;
+
+// pixel data is reference counted: duplicate() only copies the references;
+// a private copy is made when someone wants to write (get_data_writable)
+typedef std::pair<std::shared_ptr<uint8_t>, size_t> frame_data_t;
 
 class video_frame
 {
@@ -26,33 +37,76 @@ private:
 	uint64_t ts { 0 };
 	int w { -1 }, h { -1 };
 
-	std::map<encoding_t, std::pair<uint8_t *, size_t> > data;
+	// when this frame passed each stage (get_us()), 0 if not (yet)
+	std::atomic_uint64_t stage_ts[FS_N] { };
+
+	std::map<encoding_t, frame_data_t> data;
+	// the encoding of which the data is a capture buffer lent by the
+	// source (zero-copy), see own_data()
+	std::optional<encoding_t> lent;
+
+	// where new pixel buffers come from; may be nullptr (plain malloc)
+	const std::shared_ptr<frame_pool> pool;
+
+	// JPEG encodings are shared with other frames (consumers) via this
+	// cache as long as the pixels are not modified
+	std::shared_ptr<jpeg_cache> jcache;
+	uintptr_t jcache_variant { 0 };
 
-	std::map<encoding_t, std::pair<uint8_t *, size_t> >::iterator gen_encoding(const encoding_t new_e);
+	static std::atomic_uint64_t bytes_copied, bytes_shared;
+
+	std::map<encoding_t, frame_data_t>::iterator gen_encoding(const encoding_t new_e);
+	std::map<encoding_t, frame_data_t>::iterator gen_yuv420(const encoding_t new_e);
+	std::map<encoding_t, frame_data_t>::iterator gen_gray();
+	std::map<encoding_t, frame_data_t>::iterator add_encoding(const encoding_t e, uint8_t *const data, const size_t len);
+	std::map<encoding_t, frame_data_t>::iterator add_encoding(const encoding_t e, const std::shared_ptr<uint8_t> & data, const size_t len);
+	std::shared_ptr<uint8_t> allocate(const size_t len);
+	video_frame *jpeg_transform(const int op, const int crop_x, const int crop_y, const int crop_w, const int crop_h);
 	std::tuple<uint8_t *, size_t> get_data_and_len_internal(const encoding_t e);
+	video_frame *inherit_stages(video_frame *const out) const;
 
-	video_frame(const meta *const m, const int jpeg_quality);
+	video_frame(const meta *const m, const int jpeg_quality, const std::shared_ptr<frame_pool> & pool);
 
 public:
 	video_frame(const meta *const m, const int jpeg_quality, const uint64_t ts, const int w, const int h, uint8_t *const data, const size_t len, const encoding_t e);
+	video_frame(const meta *const m, const int jpeg_quality, const uint64_t ts, const int w, const int h, const std::shared_ptr<uint8_t> & data, const size_t len, const encoding_t e, const std::shared_ptr<frame_pool> & pool, const std::shared_ptr<jpeg_cache> & jcache = { });
 	virtual ~video_frame();
 
 	void set_ts(const uint64_t ts);
 	void set_wh(const int w, const int h);
 	void put_data(const uint8_t *const data, const size_t len, const encoding_t e); // makes a copy
 	void set_encoding(const encoding_t e);
+	void set_jpeg_cache(const std::shared_ptr<jpeg_cache> & jcache);
 
 	int get_w() const;
 	int get_h() const;
 	uint8_t *get_data(const encoding_t e);
+	uint8_t *get_data_writable(const encoding_t e);
 	std::tuple<uint8_t *, size_t> get_data_and_len(const encoding_t e);
 	std::tuple<int, int> get_wh() const;
 	uint64_t get_ts() const;
 	void update_ts();
 	void keep_only_format(const encoding_t e);
+	bool has_only(const encoding_t e) const;
+	// without generating it
+	bool has_encoding(const encoding_t e) const;
+
+	void set_stage_ts(const frame_stage_t stage, const uint64_t stage_ts);
+	uint64_t get_stage_ts(const frame_stage_t stage) const;
+	// adds the latencies (relative to FS_CAPTURED) of the passed stages
+	void report_latency(stats_tracker *const st) const;
 
 	video_frame *duplicate(const std::optional<encoding_t> e);
+	void set_lent(const encoding_t e);
+	// For frames that are kept for a while: copies the data of a capture
+	// buffer lent by the source, which must go back to the driver. No-op
+	// for other frames.
+	void own_data();
 	video_frame *do_resize(resize *const r, const int new_w, const int new_h);
 	video_frame *apply_filtering(instance *const inst, source *const s, video_frame *const prev, const std::vector<filter *> *const filters, controls *const c);
 	video_frame *do_rotate(const int angle);
+	video_frame *do_crop(const int x, const int y, const int cw, const int ch);
+
+	static uint64_t get_bytes_copied() { return bytes_copied; }
+	static uint64_t get_bytes_shared() { return bytes_shared; }
 };
@@ -11,17 +11,6 @@
 #include "filter.h"
 #include "resize.h"
 
-static void to_gray(uint8_t *const in_out, const int n_pixels)
-{
-        for(int i=0, o=0; o<n_pixels;) {
-                int r = in_out[i++];
-                int g = in_out[i++];
-                int b = in_out[i++];
-
-                in_out[o++] = (r + g + b) / 3;
-        }
-}
-
 view_3d::view_3d(configuration_t *const cfg, const std::string & id, const std::string & descr, const int width, const int height, const std::vector<view_src_t> & sources, std::vector<filter *> *const filters, const view_3d_mode_t v3m, const int jpeg_quality) : view_ss(cfg, id, descr, width, height, false, sources, 0.0, filters, jpeg_quality), v3m(v3m)
 {
 }
@@ -94,6 +83,9 @@ video_frame * view_3d::get_frame(const bool handle_failure, const uint64_t after
 	// apply filters
 
 	if (filters) {
+		left_frame = left->get_data_writable(E_RGB);
+		right_frame = right->get_data_writable(E_RGB);
+
 		instance *inst = find_instance_by_interface(cfg, this);
 		apply_filters(inst, this, filters, l_prev_frame, left_frame, left_ts, left_width, left_height);
 		memcpy(l_prev_frame, left_frame, IMS(left_width, left_height, 3));
@@ -186,8 +178,8 @@ video_frame * view_3d::get_frame(const bool handle_failure, const uint64_t after
 		}
 	}
 	else if (v3m == view_3d_redgreen || v3m == view_3d_redblue) {
-		to_gray(left_frame, left_width * left_height);
-		to_gray(right_frame, right_width * right_height);
+		const uint8_t *left_gray = left->get_data(E_GRAY);
+		const uint8_t *right_gray = right->get_data(E_GRAY);
 
 		for(int y=0; y<left_height; y++) {
 			int o = y * new_width * 3;
@@ -196,8 +188,8 @@ video_frame * view_3d::get_frame(const bool handle_failure, const uint64_t after
 				for(int x=0; x<left_width; x++) {
 					int o2 = o + x * 3;
 
-					new_frame[o2 + 0] = left_frame[y * left_width + x];
-					new_frame[o2 + 1] = right_frame[y * right_width + x];
+					new_frame[o2 + 0] = left_gray[y * left_width + x];
+					new_frame[o2 + 1] = right_gray[y * right_width + x];
 					new_frame[o2 + 2] = 0x00;
 				}
 			}
@@ -205,9 +197,9 @@ video_frame * view_3d::get_frame(const bool handle_failure, const uint64_t after
 				for(int x=0; x<left_width; x++) {
 					int o2 = o + x * 3;
 
-					new_frame[o2 + 0] = left_frame[y * left_width + x];
+					new_frame[o2 + 0] = left_gray[y * left_width + x];
 					new_frame[o2 + 1] = 0x00;
-					new_frame[o2 + 2] = right_frame[y * right_width + x];
+					new_frame[o2 + 2] = right_gray[y * right_width + x];
 				}
 			}
 		}
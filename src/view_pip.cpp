@@ -101,7 +101,7 @@ video_frame * view_pip::get_frame(const bool handle_failure, const uint64_t afte
 	int main_width = main_frame->get_w();
 	int main_height = main_frame->get_h();
 
-	uint8_t *work = main_frame->get_data(E_RGB);
+	uint8_t *work = main_frame->get_data_writable(E_RGB);
 
 	for(size_t i=1; i<sources.size(); i++) {
 		video_frame *pip = frames.at(i);
@@ -0,0 +1,153 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#include <algorithm>
+
+#include "worker_pool.h"
+#include "log.h"
+#include "utils.h"
+
+// stripes smaller than this cost more in synchronisation than they gain
+constexpr int min_rows_per_stripe = 16;
+
+static worker_pool *pool = nullptr;
+static int default_stripes = 1;
+
+worker_pool::worker_pool(const int n_threads)
+{
+	for(int i=0; i<n_threads; i++)
+		threads.push_back(new std::thread(&worker_pool::worker, this, i));
+
+	log(LL_INFO, "Worker pool with %d thread(s) started", n_threads);
+}
+
+worker_pool::~worker_pool()
+{
+	{
+		const std::lock_guard<std::mutex> lck(lock);
+		stop = true;
+	}
+
+	cv.notify_all();
+
+	for(auto th : threads) {
+		th->join();
+		delete th;
+	}
+}
+
+bool worker_pool::process_part(job_t *const j)
+{
+	const int nr = j->next++;
+
+	if (nr >= j->n_parts)
+		return false;
+
+	j->f(nr);
+
+	if (++j->done == j->n_parts) {
+		const std::lock_guard<std::mutex> lck(j->lock);
+		j->cv.notify_all();
+	}
+
+	return true;
+}
+
+void worker_pool::worker(const int nr)
+{
+	set_thread_name(myformat("worker-%d", nr));
+
+	std::unique_lock<std::mutex> lck(lock);
+
+	for(;;) {
+		while(!stop && queue.empty())
+			cv.wait(lck);
+
+		if (stop)
+			break;
+
+		auto j = queue.front();
+
+		// all parts of this job have been picked up
+		if (j->next >= j->n_parts) {
+			queue.pop_front();
+			continue;
+		}
+
+		lck.unlock();
+
+		process_part(j.get());
+
+		lck.lock();
+	}
+}
+
+void worker_pool::run(const int n_parts, const std::function<void(int)> & f)
+{
+	if (n_parts <= 1 || threads.empty()) {
+		for(int i=0; i<n_parts; i++)
+			f(i);
+
+		return;
+	}
+
+	auto j = std::make_shared<job_t>();
+	j->f = f;
+	j->n_parts = n_parts;
+
+	{
+		const std::lock_guard<std::mutex> lck(lock);
+		queue.push_back(j);
+	}
+
+	cv.notify_all();
+
+	// help processing; also guarantees progress when all workers
+	// are busy with the job that submitted this one
+	while(process_part(j.get())) {
+	}
+
+	{
+		std::unique_lock<std::mutex> jlck(j->lock);
+
+		while(j->done < n_parts)
+			j->cv.wait(jlck);
+	}
+
+	// no worker may have seen it yet
+	const std::lock_guard<std::mutex> lck(lock);
+
+	auto it = std::find(queue.begin(), queue.end(), j);
+	if (it != queue.end())
+		queue.erase(it);
+}
+
+void init_worker_pool(const int n_threads, const int n_stripes)
+{
+	uninit_worker_pool();
+
+	if (n_threads > 0)
+		pool = new worker_pool(n_threads);
+
+	default_stripes = n_stripes > 0 ? n_stripes : n_threads + 1;
+}
+
+void uninit_worker_pool()
+{
+	delete pool;
+	pool = nullptr;
+
+	default_stripes = 1;
+}
+
+void run_stripes(const int n_rows, const int n_stripes, const std::function<void(int, int)> & f)
+{
+	int n = std::min(n_stripes > 0 ? n_stripes : default_stripes, n_rows / min_rows_per_stripe);
+
+	if (!pool || n <= 1) {
+		f(0, n_rows);
+		return;
+	}
+
+	pool->run(n, [n, n_rows, &f](const int nr) {
+			f(n_rows * nr / n, n_rows * (nr + 1) / n);
+		});
+}
@@ -0,0 +1,58 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads shared by all instances for splitting up work
+// on a single frame (resizing, filters) in parts. The thread that
+// submits the work also processes parts of it; when a part submits work
+// itself (e.g. a filter that resizes), that can't deadlock because of
+// this.
+class worker_pool
+{
+private:
+	typedef struct {
+		std::function<void(int)> f;
+		int n_parts;
+		std::atomic_int next { 0 };
+		std::atomic_int done { 0 };
+		std::mutex lock;
+		std::condition_variable cv;
+	} job_t;
+
+	std::vector<std::thread *> threads;
+
+	std::mutex lock;
+	std::condition_variable cv;
+	std::deque<std::shared_ptr<job_t> > queue;
+	bool stop { false };
+
+	static bool process_part(job_t *const j);
+	void worker(const int nr);
+
+public:
+	worker_pool(const int n_threads);
+	virtual ~worker_pool();
+
+	int get_n_threads() const { return int(threads.size()); }
+
+	// invokes f(0)...f(n_parts - 1) and returns when all have finished
+	void run(const int n_parts, const std::function<void(int)> & f);
+};
+
+// n_threads of 0 disables the pool: everything then runs in the thread
+// that invokes run_stripes. n_stripes of 0 selects one stripe per thread
+// (including the calling thread).
+void init_worker_pool(const int n_threads, const int n_stripes);
+void uninit_worker_pool();
+
+// Splits rows [0...n_rows) in at most n_stripes horizontal stripes and
+// invokes f(y_start, y_end) for each of them, in parallel when there's
+// a pool. n_stripes of 0 selects the global default.
+void run_stripes(const int n_rows, const int n_stripes, const std::function<void(int, int)> & f);
@@ -0,0 +1,148 @@
+// (C) 2017-2023 by folkert van heusden, released under the MIT license
+// The SIMD colour conversions must give exactly the same output as their
+// plain C++ reference versions, also for sizes that are not a multiple of
+// the vector width (the remainder is done by the scalar code). Each
+// instruction set the cpu supports is tested, not only the one that is
+// selected at runtime.
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "encoding.h"
+
+static std::mt19937 rng(1234);
+
+static std::vector<uint8_t> random_bytes(const size_t n)
+{
+	std::uniform_int_distribution<int> dist(0, 255);
+
+	std::vector<uint8_t> out(n);
+
+	for(auto & b : out)
+		b = dist(rng);
+
+	return out;
+}
+
+static bool compare(const char *const name, const int w, const int h, const uint8_t *const simd, const uint8_t *const scalar, const size_t n)
+{
+	if (memcmp(simd, scalar, n) == 0)
+		return true;
+
+	for(size_t i=0; i<n; i++) {
+		if (simd[i] != scalar[i]) {
+			fprintf(stderr, "%s: %dx%d differs at byte %zu: %d (simd) != %d (scalar)\n", name, w, h, i, simd[i], scalar[i]);
+			break;
+		}
+	}
+
+	return false;
+}
+
+// as the public functions do it: the kernel and then the scalar code for
+// what is left
+static void run(const encoding_kernel_t kernel, void (*const scalar)(const uint8_t *const, const size_t, uint8_t *const), const uint8_t *const in, const size_t in_pixel_size, const size_t n_pixels, uint8_t *const out, const size_t out_pixel_size)
+{
+	const size_t done = kernel(in, n_pixels, out);
+
+	scalar(&in[done * in_pixel_size], n_pixels - done, &out[done * out_pixel_size]);
+}
+
+static bool test_kernels(const encoding_kernels_t & k, const int w, const int h)
+{
+	const size_t n_pixels = size_t(w) * h;
+	const std::string prefix = std::string(k.isa) + " ";
+
+	bool ok = true;
+
+	auto yuy2 = random_bytes(n_pixels * 2);
+	std::vector<uint8_t> rgb_simd(n_pixels * 3), rgb_scalar(n_pixels * 3);
+	run(k.yuy2_to_rgb, yuy2_to_rgb_scalar, yuy2.data(), 2, n_pixels, rgb_simd.data(), 3);
+	yuy2_to_rgb_scalar(yuy2.data(), n_pixels, rgb_scalar.data());
+	ok &= compare((prefix + "yuy2_to_rgb").c_str(), w, h, rgb_simd.data(), rgb_scalar.data(), n_pixels * 3);
+
+	auto rgb = random_bytes(n_pixels * 3);
+	std::vector<uint8_t> yuy2_simd(n_pixels * 2), yuy2_scalar(n_pixels * 2);
+	run(k.rgb_to_yuy2, rgb_to_yuy2_scalar, rgb.data(), 3, n_pixels, yuy2_simd.data(), 2);
+	rgb_to_yuy2_scalar(rgb.data(), n_pixels, yuy2_scalar.data());
+	ok &= compare((prefix + "rgb_to_yuy2").c_str(), w, h, yuy2_simd.data(), yuy2_scalar.data(), n_pixels * 2);
+
+	// any number of pixels
+	const size_t n_bgr = n_pixels + (w & 7) + 1;
+	auto bgr = random_bytes(n_bgr * 3);
+	std::vector<uint8_t> bgr_simd(n_bgr * 3), bgr_scalar(n_bgr * 3);
+	run(k.bgr_to_rgb, bgr_to_rgb_scalar, bgr.data(), 3, n_bgr, bgr_simd.data(), 3);
+	bgr_to_rgb_scalar(bgr.data(), n_bgr, bgr_scalar.data());
+	ok &= compare((prefix + "bgr_to_rgb").c_str(), w, h, bgr_simd.data(), bgr_scalar.data(), n_bgr * 3);
+
+	return ok;
+}
+
+int main()
+{
+	std::vector<std::pair<int, int> > sizes { { 2, 1 }, { 6, 3 }, { 14, 2 }, { 16, 16 }, { 30, 7 }, { 34, 5 }, { 62, 9 }, { 640, 480 } };
+
+	std::uniform_int_distribution<int> dist_w(1, 200), dist_h(1, 50);
+
+	for(int i=0; i<50; i++)
+		sizes.push_back({ dist_w(rng) * 2, dist_h(rng) });  // YUYV: pixels in pairs
+
+	bool ok = true;
+
+	const auto kernels = get_encoding_kernels();
+
+	for(auto & k : kernels)
+		printf("testing %s\n", k.isa);
+
+	for(auto & size : sizes) {
+		for(auto & k : kernels)
+			ok &= test_kernels(k, size.first, size.second);
+
+		const int w = size.first, h = size.second;
+		const size_t n_pixels = size_t(w) * h;
+
+		// YUYV -> RGB
+		auto yuy2 = random_bytes(n_pixels * 2);
+
+		uint8_t *rgb_simd = nullptr;
+		yuy2_to_rgb(yuy2.data(), w, h, &rgb_simd);
+
+		std::vector<uint8_t> rgb_scalar(n_pixels * 3);
+		yuy2_to_rgb_scalar(yuy2.data(), n_pixels, rgb_scalar.data());
+
+		ok &= compare("yuy2_to_rgb", w, h, rgb_simd, rgb_scalar.data(), n_pixels * 3);
+
+		free(rgb_simd);
+
+		// RGB -> YUYV
+		auto rgb = random_bytes(n_pixels * 3);
+
+		uint8_t *yuy2_simd = nullptr;
+		rgb_to_yuy2(rgb.data(), w, h, &yuy2_simd);
+
+		std::vector<uint8_t> yuy2_scalar(n_pixels * 2);
+		rgb_to_yuy2_scalar(rgb.data(), n_pixels, yuy2_scalar.data());
+
+		ok &= compare("rgb_to_yuy2", w, h, yuy2_simd, yuy2_scalar.data(), n_pixels * 2);
+
+		free(yuy2_simd);
+
+		// BGR -> RGB, any number of pixels
+		const size_t n_bgr = n_pixels + (w & 7) + 1;
+		auto bgr = random_bytes(n_bgr * 3);
+
+		std::vector<uint8_t> bgr_simd(n_bgr * 3), bgr_scalar(n_bgr * 3);
+		bgr_to_rgb(bgr.data(), n_bgr, bgr_simd.data());
+		bgr_to_rgb_scalar(bgr.data(), n_bgr, bgr_scalar.data());
+
+		ok &= compare("bgr_to_rgb", w, h, bgr_simd.data(), bgr_scalar.data(), n_bgr * 3);
+	}
+
+	printf("%s\n", ok ? "ok" : "FAILED");
+
+	return ok ? 0 : 1;
+}